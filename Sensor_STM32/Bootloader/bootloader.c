@@ -0,0 +1,451 @@
+/**
+  * Sensor node bootloader, first 8KB of internal flash
+  *
+  * Installs an image the application staged in the W25Q64 (MDK-ARM/ota.c),
+  * keeps the previous application in the backup slot and restores it when
+  * the new one does not confirm within OTA_MAX_TRIAL_BOOTS boots. An LZ
+  * compressed image (tools/ota_lz.py) is expanded while it is programmed.
+  * Register level on the 8MHz HSI, no HAL or RTOS.
+  *
+  * Built by the "Bootloader" target of MDK-ARM/Demo.uvprojx: this file and
+  * startup_stm32f103xb.s, no HAL, IROM1 0x08000000 size 0x2000. The "Demo"
+  * target links the application at 0x08002000 (VECT_TAB_OFFSET 0x2000) and
+  * does not start without this image below it.
+  *
+  * A new board takes two images, in this order:
+  *   1. select the "Bootloader" target, Build, then Flash > Download. It is
+  *      written once and not touched by OTA.
+  *   2. select the "Demo" target, Build, then Flash > Download. Keil erases
+  *      only the sectors the image covers, so the bootloader stays.
+  * A full chip erase removes the bootloader, repeat step 1 after one. Later
+  * application updates need only step 2, or OTA.
+  */
+#include "stm32f1xx.h"
+#include "ota_layout.h"
+
+// W25Q64 command set
+#define W25Q64_CMD_WRITE_ENABLE     0x06
+#define W25Q64_CMD_READ_STATUS1     0x05
+#define W25Q64_CMD_READ_DATA        0x03
+#define W25Q64_CMD_PAGE_PROGRAM     0x02
+#define W25Q64_CMD_SECTOR_ERASE     0x20
+#define W25Q64_CMD_BLOCK_ERASE      0xD8
+#define W25Q64_CMD_WAKE_UP          0xAB
+#define W25Q64_PAGE_SIZE            256
+
+#define W25Q64_CS_LOW()     (GPIOA->BSRR = GPIO_BSRR_BR4)
+#define W25Q64_CS_HIGH()    (GPIOA->BSRR = GPIO_BSRR_BS4)
+
+#define BOOT_RAM_END        0x20005000
+#define BOOT_LZ_WINDOW_MASK ((1u << OTA_LZ_WINDOW_BITS) - 1)
+
+// MSB-first bit reader over the compressed staging slot
+typedef struct {
+    uint32_t addr;              // next W25Q64 byte to fetch into boot_page
+    uint32_t end;
+    uint16_t pos;               // next byte in boot_page
+    uint16_t fill;
+    uint32_t bits;              // pending input bits, right aligned
+    uint8_t count;
+    uint8_t overrun;            // read past lz_size, the stream is corrupt
+} Boot_LzInput_t;
+
+static uint32_t boot_page[W25Q64_PAGE_SIZE / 4];
+// Nothing else uses the RAM, so the window is larger than the application could afford
+static uint8_t lz_window[1u << OTA_LZ_WINDOW_BITS];
+
+/**
+  * @brief stay on the reset HSI clock, the application sets up its own
+  */
+void SystemInit(void)
+{
+}
+
+static uint8_t SPI_Transfer(uint8_t byte)
+{
+    while(!(SPI1->SR & SPI_SR_TXE));
+    SPI1->DR = byte;
+    while(!(SPI1->SR & SPI_SR_RXNE));
+    return (uint8_t)SPI1->DR;
+}
+
+static void SPI_Command(uint8_t cmd, uint32_t addr)
+{
+    SPI_Transfer(cmd);
+    SPI_Transfer((uint8_t)(addr >> 16));
+    SPI_Transfer((uint8_t)(addr >> 8));
+    SPI_Transfer((uint8_t)addr);
+}
+
+static void SPIFlash_WaitReady(void)
+{
+    uint8_t status;
+
+    do {
+        W25Q64_CS_LOW();
+        SPI_Transfer(W25Q64_CMD_READ_STATUS1);
+        status = SPI_Transfer(0xFF);
+        W25Q64_CS_HIGH();
+    } while(status & 0x01);
+}
+
+static void SPIFlash_WriteEnable(void)
+{
+    W25Q64_CS_LOW();
+    SPI_Transfer(W25Q64_CMD_WRITE_ENABLE);
+    W25Q64_CS_HIGH();
+}
+
+static void SPIFlash_Read(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+    W25Q64_CS_LOW();
+    SPI_Command(W25Q64_CMD_READ_DATA, addr);
+    while(len--) {
+        *buf++ = SPI_Transfer(0xFF);
+    }
+    W25Q64_CS_HIGH();
+}
+
+static void SPIFlash_Program(uint32_t addr, const uint8_t* buf, uint16_t len)
+{
+    SPIFlash_WriteEnable();
+    W25Q64_CS_LOW();
+    SPI_Command(W25Q64_CMD_PAGE_PROGRAM, addr);
+    while(len--) {
+        SPI_Transfer(*buf++);
+    }
+    W25Q64_CS_HIGH();
+    SPIFlash_WaitReady();
+}
+
+static void SPIFlash_Erase(uint8_t cmd, uint32_t addr)
+{
+    SPIFlash_WriteEnable();
+    W25Q64_CS_LOW();
+    SPI_Command(cmd, addr);
+    W25Q64_CS_HIGH();
+    SPIFlash_WaitReady();
+}
+
+static void Internal_Unlock(void)
+{
+    if(FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+static void Internal_ErasePage(uint32_t addr)
+{
+    FLASH->CR |= FLASH_CR_PER;
+    FLASH->AR = addr;
+    FLASH->CR |= FLASH_CR_STRT;
+    while(FLASH->SR & FLASH_SR_BSY);
+    FLASH->CR &= ~FLASH_CR_PER;
+}
+
+static void Internal_Program(uint32_t addr, const uint8_t* buf, uint32_t len)
+{
+    FLASH->CR |= FLASH_CR_PG;
+    for(uint32_t i = 0; i < len; i += 2) {
+        *(volatile uint16_t*)(addr + i) = (uint16_t)(buf[i] | (buf[i + 1] << 8));
+        while(FLASH->SR & FLASH_SR_BSY);
+    }
+    FLASH->CR &= ~FLASH_CR_PG;
+}
+
+/**
+  * @brief clocks, SPI1 to the W25Q64 (PA4 CS, PA5 SCK, PA6 MISO, PA7 MOSI), CRC unit
+  */
+void Bootloader_Init(void)
+{
+    RCC->APB2ENR |= RCC_APB2ENR_IOPAEN | RCC_APB2ENR_SPI1EN;
+    RCC->AHBENR |= RCC_AHBENR_CRCEN;
+
+    W25Q64_CS_HIGH();
+    // PA4 push-pull out, PA5/PA7 alternate push-pull, PA6 floating input, all 50MHz
+    GPIOA->CRL = (GPIOA->CRL & 0x0000FFFF) | 0xB4B30000;
+
+    // master, software NSS, 8MHz / 4 = 2MHz
+    SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_BR_0 | SPI_CR1_SPE;
+
+    W25Q64_CS_LOW();
+    SPI_Transfer(W25Q64_CMD_WAKE_UP);
+    W25Q64_CS_HIGH();
+    for(volatile uint16_t i = 0; i < 100; i++);
+}
+
+/**
+  * @brief CRC unit over a range rounded up to words, 0xFF padded like ota.c
+  * @param in_spi 1 for a W25Q64 address, 0 for memory mapped internal flash
+  */
+uint32_t Bootloader_CalculateCRC(uint32_t addr, uint32_t size, uint8_t in_spi)
+{
+    uint8_t* bytes = (uint8_t*)boot_page;
+    uint32_t chunk;
+
+    CRC->CR = CRC_CR_RESET;
+    while(size) {
+        chunk = (size > W25Q64_PAGE_SIZE) ? W25Q64_PAGE_SIZE : size;
+        if(in_spi) {
+            SPIFlash_Read(addr, bytes, chunk);
+        } else {
+            for(uint32_t i = 0; i < chunk; i++) bytes[i] = *(volatile uint8_t*)(addr + i);
+        }
+        while(chunk & 3) bytes[chunk++] = 0xFF;
+        for(uint32_t i = 0; i < chunk / 4; i++) {
+            CRC->DR = boot_page[i];
+        }
+        addr += chunk;
+        size = (size > chunk) ? size - chunk : 0;
+    }
+    return CRC->DR;
+}
+
+/**
+  * @brief read the OTA metadata, 0 when the sector holds none
+  */
+uint8_t Bootloader_CheckUpdateFlag(OTA_Meta_t* meta)
+{
+    SPIFlash_Read(OTA_META_ADDR, (uint8_t*)meta, sizeof(OTA_Meta_t));
+    return meta->magic == OTA_META_MAGIC;
+}
+
+void Bootloader_SetUpdateFlag(const OTA_Meta_t* meta)
+{
+    SPIFlash_Erase(W25Q64_CMD_SECTOR_ERASE, OTA_META_ADDR);
+    SPIFlash_Program(OTA_META_ADDR, (const uint8_t*)meta, sizeof(OTA_Meta_t));
+}
+
+/**
+  * @brief copy the running application into the backup slot
+  */
+static uint8_t Bootloader_BackupApp(OTA_Meta_t* meta)
+{
+    SPIFlash_Erase(W25Q64_CMD_BLOCK_ERASE, OTA_BACKUP_ADDR);
+    for(uint32_t offset = 0; offset < OTA_APP_MAX_SIZE; offset += W25Q64_PAGE_SIZE) {
+        SPIFlash_Program(OTA_BACKUP_ADDR + offset, (const uint8_t*)(OTA_APP_ADDR + offset), W25Q64_PAGE_SIZE);
+    }
+    meta->backup_crc = Bootloader_CalculateCRC(OTA_APP_ADDR, OTA_APP_MAX_SIZE, 0);
+    return Bootloader_CalculateCRC(OTA_BACKUP_ADDR, OTA_APP_MAX_SIZE, 1) == meta->backup_crc;
+}
+
+/**
+  * @brief rewrite the application area from a W25Q64 slot
+  */
+static void Bootloader_CopyToInternal(uint32_t spi_addr, uint32_t size)
+{
+    uint32_t offset, chunk;
+
+    Internal_Unlock();
+    for(offset = 0; offset < size; offset += OTA_FLASH_PAGE_SIZE) {
+        Internal_ErasePage(OTA_APP_ADDR + offset);
+    }
+    for(offset = 0; offset < size; offset += chunk) {
+        chunk = (size - offset > W25Q64_PAGE_SIZE) ? W25Q64_PAGE_SIZE : size - offset;
+        SPIFlash_Read(spi_addr + offset, (uint8_t*)boot_page, chunk);
+        // odd tail is padded so the last halfword write is complete
+        if(chunk & 1) ((uint8_t*)boot_page)[chunk] = 0xFF;
+        Internal_Program(OTA_APP_ADDR + offset, (const uint8_t*)boot_page, chunk);
+    }
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+static uint32_t Bootloader_LzBits(Boot_LzInput_t* in, uint8_t count)
+{
+    uint8_t byte;
+
+    while(in->count < count) {
+        if(in->pos == in->fill) {
+            if(in->addr >= in->end) {
+                in->overrun = 1;
+                return 0;
+            }
+            in->fill = (in->end - in->addr > W25Q64_PAGE_SIZE) ? W25Q64_PAGE_SIZE : (uint16_t)(in->end - in->addr);
+            SPIFlash_Read(in->addr, (uint8_t*)boot_page, in->fill);
+            in->addr += in->fill;
+            in->pos = 0;
+        }
+        byte = ((uint8_t*)boot_page)[in->pos++];
+        in->bits = (in->bits << 8) | byte;
+        in->count += 8;
+    }
+    in->count -= count;
+    return (in->bits >> in->count) & ((1u << count) - 1);
+}
+
+/**
+  * @brief expand the compressed staging slot into the application area
+  * @retval 1 when the stream produced exactly meta->size bytes
+  * @note  Same format as tools/ota_lz.py: after the header a 1 bit tags an
+  *        8 bit literal, a 0 bit a window_bits distance and lookahead_bits
+  *        length, both stored minus one. Every second byte completes a
+  *        halfword, which is programmed right away.
+  */
+static uint8_t Bootloader_Expand(const OTA_Meta_t* meta)
+{
+    Boot_LzInput_t in;
+    uint8_t header[OTA_LZ_HEADER_SIZE];
+    uint32_t magic, raw_size, produced = 0;
+    uint32_t distance, length, offset;
+    uint8_t window_bits, length_bits, byte;
+
+    SPIFlash_Read(OTA_STAGING_ADDR, header, sizeof(header));
+    magic = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+    raw_size = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+    window_bits = header[4];
+    length_bits = header[5];
+    if(magic != OTA_LZ_MAGIC || raw_size != meta->size || window_bits < 4 ||
+       window_bits > OTA_LZ_WINDOW_BITS || length_bits < 1 || length_bits > 8) {
+        return 0;
+    }
+
+    in.addr = OTA_STAGING_ADDR + OTA_LZ_HEADER_SIZE;
+    in.end = OTA_STAGING_ADDR + meta->lz_size;
+    in.pos = in.fill = 0;
+    in.bits = 0;
+    in.count = 0;
+    in.overrun = 0;
+    // the packer treats the window as zero filled before the first byte
+    for(offset = 0; offset < sizeof(lz_window); offset++) lz_window[offset] = 0;
+
+    Internal_Unlock();
+    for(offset = 0; offset < meta->size; offset += OTA_FLASH_PAGE_SIZE) {
+        Internal_ErasePage(OTA_APP_ADDR + offset);
+    }
+
+    FLASH->CR |= FLASH_CR_PG;
+    while(produced < meta->size && !in.overrun) {
+        if(Bootloader_LzBits(&in, 1)) {
+            distance = 0;
+            length = 1;
+        } else {
+            distance = Bootloader_LzBits(&in, window_bits) + 1;
+            length = Bootloader_LzBits(&in, length_bits) + 1;
+        }
+        while(length-- && produced < meta->size && !in.overrun) {
+            byte = distance ? lz_window[(produced - distance) & BOOT_LZ_WINDOW_MASK] : (uint8_t)Bootloader_LzBits(&in, 8);
+            lz_window[produced & BOOT_LZ_WINDOW_MASK] = byte;
+            if(produced & 1) {
+                *(volatile uint16_t*)(OTA_APP_ADDR + produced - 1) =
+                    (uint16_t)(lz_window[(produced - 1) & BOOT_LZ_WINDOW_MASK] | (byte << 8));
+                while(FLASH->SR & FLASH_SR_BSY);
+            }
+            produced++;
+        }
+    }
+    // odd tail is padded so the last halfword write is complete
+    if(produced & 1) {
+        *(volatile uint16_t*)(OTA_APP_ADDR + produced - 1) =
+            (uint16_t)(lz_window[(produced - 1) & BOOT_LZ_WINDOW_MASK] | 0xFF00);
+        while(FLASH->SR & FLASH_SR_BSY);
+    }
+    FLASH->CR &= ~FLASH_CR_PG;
+    FLASH->CR |= FLASH_CR_LOCK;
+
+    return produced == meta->size && !in.overrun;
+}
+
+/**
+  * @brief install the staged image, 1 when it verifies in internal flash
+  */
+uint8_t Bootloader_UpdateFirmware(const OTA_Meta_t* meta)
+{
+    if(OTA_META_IS_LZ(meta)) {
+        if(!Bootloader_Expand(meta)) return 0;
+    } else {
+        Bootloader_CopyToInternal(OTA_STAGING_ADDR, meta->size);
+    }
+    return Bootloader_CalculateCRC(OTA_APP_ADDR, meta->size, 0) == meta->crc;
+}
+
+static void Bootloader_Rollback(OTA_Meta_t* meta)
+{
+    Bootloader_CopyToInternal(OTA_BACKUP_ADDR, OTA_APP_MAX_SIZE);
+    meta->state = OTA_STATE_ROLLED_BACK;
+}
+
+/**
+  * @brief start the application if its vector table looks sane
+  */
+void Bootloader_JumpToApp(void)
+{
+    uint32_t sp = *(volatile uint32_t*)OTA_APP_ADDR;
+    uint32_t entry = *(volatile uint32_t*)(OTA_APP_ADDR + 4);
+
+    if(sp <= SRAM_BASE || sp > BOOT_RAM_END) return;
+
+    // hand over SPI1 and GPIOA in their reset state
+    RCC->APB2RSTR |= RCC_APB2RSTR_SPI1RST | RCC_APB2RSTR_IOPARST;
+    RCC->APB2RSTR &= ~(RCC_APB2RSTR_SPI1RST | RCC_APB2RSTR_IOPARST);
+    RCC->APB2ENR &= ~(RCC_APB2ENR_SPI1EN | RCC_APB2ENR_IOPAEN);
+    RCC->AHBENR &= ~RCC_AHBENR_CRCEN;
+
+    SCB->VTOR = OTA_APP_ADDR;
+    __set_MSP(sp);
+    ((void (*)(void))entry)();
+}
+
+/**
+  * @brief advance the OTA state machine, then boot
+  * @note  Every step is recorded before the next one starts, a reset at any
+  *        point resumes from the last recorded state
+  */
+void bootloader_main(void)
+{
+    OTA_Meta_t meta;
+
+    Bootloader_Init();
+
+    if(Bootloader_CheckUpdateFlag(&meta)) {
+        switch(meta.state) {
+        case OTA_STATE_PENDING:
+            // staging must still match what the application verified
+            if(meta.size == 0 || meta.size > OTA_APP_MAX_SIZE ||
+               (OTA_META_IS_LZ(&meta) && meta.lz_size > OTA_BACKUP_ADDR - OTA_STAGING_ADDR) ||
+               (OTA_META_IS_LZ(&meta) ?
+                Bootloader_CalculateCRC(OTA_STAGING_ADDR, meta.lz_size, 1) != meta.lz_crc :
+                Bootloader_CalculateCRC(OTA_STAGING_ADDR, meta.size, 1) != meta.crc) ||
+               !Bootloader_BackupApp(&meta)) {
+                meta.state = OTA_STATE_ROLLED_BACK;
+                Bootloader_SetUpdateFlag(&meta);
+                break;
+            }
+            meta.state = OTA_STATE_INSTALLING;
+            Bootloader_SetUpdateFlag(&meta);
+            /* fall through */
+
+        case OTA_STATE_INSTALLING:
+            if(Bootloader_UpdateFirmware(&meta)) {
+                meta.state = OTA_STATE_TESTING;
+                meta.boot_count = 0;
+            } else {
+                Bootloader_Rollback(&meta);
+            }
+            Bootloader_SetUpdateFlag(&meta);
+            break;
+
+        case OTA_STATE_TESTING:
+            // the application moves to CONFIRMED once it reaches the broker
+            if(++meta.boot_count > OTA_MAX_TRIAL_BOOTS) {
+                Bootloader_Rollback(&meta);
+            }
+            Bootloader_SetUpdateFlag(&meta);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    Bootloader_JumpToApp();
+
+    // no valid application, nothing left to do
+    while(1);
+}
+
+int main(void)
+{
+    bootloader_main();
+    return 0;
+}
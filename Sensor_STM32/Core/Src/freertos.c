@@ -57,8 +57,45 @@
 void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize );
 
 /* Hook prototypes */
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
 void vApplicationMallocFailedHook(void);
 
+/* USER CODE BEGIN 1 */
+/* Functions needed when configGENERATE_RUN_TIME_STATS is on */
+static uint32_t cyccnt_last = 0;
+static uint32_t cyccnt_wraps = 0;
+
+void configureTimerForRunTimeStats(void)
+{
+  /* DWT cycle counter, no peripheral or interrupt needed */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  cyccnt_last = 0;
+  cyccnt_wraps = 0;
+}
+
+unsigned long getRunTimeCounterValue(void)
+{
+  /* Called on every context switch, far more often than the ~59 s CYCCNT
+     wrap at 72 MHz, so a wrap is never missed. Returns core clock / 64. */
+  uint32_t primask = __get_PRIMASK();
+  uint32_t now;
+
+  __disable_irq();
+  now = DWT->CYCCNT;
+  if (now < cyccnt_last)
+  {
+    cyccnt_wraps++;
+  }
+  cyccnt_last = now;
+  __set_PRIMASK(primask);
+
+  return (cyccnt_wraps << 26) | (now >> 6);
+}
+/* USER CODE END 1 */
+
 /* USER CODE BEGIN 5 */
 __weak void vApplicationMallocFailedHook(void)
 {
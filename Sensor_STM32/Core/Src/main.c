@@ -31,6 +31,28 @@ osMutexId sensorDataMutexHandle;
 osMutexId OledMutexHandle;
 osMutexId ESP8266MutexHandle;
 
+// Stack depths in words, every RTOS object lives in .bss so the linker map
+// shows the whole RAM budget (tools/mem_budget.py)
+#define DEFAULT_TASK_STACK      256
+#define SENSOR_TASK_STACK       512
+#define DISPLAY_TASK_STACK      512
+#define MQTT_TASK_STACK         1024
+#define OTA_TASK_STACK          384
+
+static uint32_t DefaultTaskStack[DEFAULT_TASK_STACK];
+static uint32_t SensorTaskStack[SENSOR_TASK_STACK];
+static uint32_t DisplayTaskStack[DISPLAY_TASK_STACK];
+static uint32_t MqttTaskStack[MQTT_TASK_STACK];
+static uint32_t OTA_TaskStack[OTA_TASK_STACK];
+static osStaticThreadDef_t DefaultTaskControlBlock;
+static osStaticThreadDef_t SensorTaskControlBlock;
+static osStaticThreadDef_t DisplayTaskControlBlock;
+static osStaticThreadDef_t MqttTaskControlBlock;
+static osStaticThreadDef_t OTA_TaskControlBlock;
+static osStaticMutexDef_t sensorDataMutexControlBlock;
+static osStaticMutexDef_t OledMutexControlBlock;
+static osStaticMutexDef_t ESP8266MutexControlBlock;
+
 /**
   * @brief  The application entry point.
   * @retval int
@@ -41,6 +63,7 @@ int main(void)
     HAL_Init();
     SystemClock_Config();
     MX_GPIO_Init();
+    MX_DMA_Init();
     MX_ADC1_Init();
     MX_I2C1_Init();
     MX_SPI1_Init();
@@ -48,41 +71,47 @@ int main(void)
     MX_USART2_UART_Init();
     MX_CRC_Init();
     OLED_Init();
+    LowPower_Init();
 
     /* Create the mutex(es) */
     /* definition and creation of sensorDataMutex */
-    osMutexDef(sensorDataMutex);
+    osMutexStaticDef(sensorDataMutex, &sensorDataMutexControlBlock);
     sensorDataMutexHandle = osMutexCreate(osMutex(sensorDataMutex));
 
     /* definition and creation of OledMutex */
-    osMutexDef(OledMutex);
+    osMutexStaticDef(OledMutex, &OledMutexControlBlock);
     OledMutexHandle = osMutexCreate(osMutex(OledMutex));
 
     /* definition and creation of ESP8266Mutex */
-    osMutexDef(ESP8266Mutex);
+    osMutexStaticDef(ESP8266Mutex, &ESP8266MutexControlBlock);
     ESP8266MutexHandle = osMutexCreate(osMutex(ESP8266Mutex));
 
 
     /* Create the thread(s) */
     /* definition and creation of DefaultTask */
-    osThreadDef(DefaultTask, StartDefaultTask, osPriorityBelowNormal, 0, 256);
+    osThreadStaticDef(DefaultTask, StartDefaultTask, osPriorityBelowNormal, 0, DEFAULT_TASK_STACK,
+                      DefaultTaskStack, &DefaultTaskControlBlock);
     DefaultTaskHandle = osThreadCreate(osThread(DefaultTask), NULL);
 
     /* definition and creation of SensorTask */
-    osThreadDef(SensorTask, StartSensorTask, osPriorityHigh, 0, 512);
+    osThreadStaticDef(SensorTask, StartSensorTask, osPriorityHigh, 0, SENSOR_TASK_STACK,
+                      SensorTaskStack, &SensorTaskControlBlock);
     SensorTaskHandle = osThreadCreate(osThread(SensorTask), NULL);
 
     /* definition and creation of DisplayTask */
-    osThreadDef(DisplayTask, StartDisplayTask, osPriorityNormal, 0, 512);
+    osThreadStaticDef(DisplayTask, StartDisplayTask, osPriorityNormal, 0, DISPLAY_TASK_STACK,
+                      DisplayTaskStack, &DisplayTaskControlBlock);
     DisplayTaskHandle = osThreadCreate(osThread(DisplayTask), NULL);
 
     /* definition and creation of MqttTask */
-    osThreadDef(MqttTask, StartMQTTTask, osPriorityNormal, 0, 1024);
+    osThreadStaticDef(MqttTask, StartMQTTTask, osPriorityNormal, 0, MQTT_TASK_STACK,
+                      MqttTaskStack, &MqttTaskControlBlock);
     MqttTaskHandle = osThreadCreate(osThread(MqttTask), NULL);
 
     /* definition and creation of OTA_Task */
-    //osThreadDef(OTA_Task, StartOTATask, osPriorityRealtime, 0, 896);
-    //OTA_TaskHandle = osThreadCreate(osThread(OTA_Task), NULL);
+    osThreadStaticDef(OTA_Task, StartOTATask, osPriorityRealtime, 0, OTA_TASK_STACK,
+                      OTA_TaskStack, &OTA_TaskControlBlock);
+    OTA_TaskHandle = osThreadCreate(osThread(OTA_Task), NULL);
 
     /* Start scheduler */
     osKernelStart();
@@ -1,7 +1,9 @@
 #include "main.h"
 #include "hardware.h"
+#include "cmsis_os.h"
 #include "string.h"
 #include "stdio.h"
+#include "stdlib.h"
 
 UART_HandleTypeDef huart1;
 UART_HandleTypeDef huart2;
@@ -9,11 +11,27 @@ UART_HandleTypeDef huart2;
 // ESP8266 defination
 #define ESP8266_UART            huart2
 #define ESP8266_BUFFER_SIZE     512
+#define ESP8266_LINE_MAX        192     // room always left for the line being received
+#define ESP8266_RX_RING_MASK    (ESP8266_RX_RING_SIZE - 1)
+#define ESP8266_URC_MQTTSUBRECV "+MQTTSUBRECV:"
 
 // global variable
 static char esp8266_buffer[ESP8266_BUFFER_SIZE];
 static WiFi_Status_t wifi_status = WIFI_DISCONNECTED;
 static MQTT_Status_t mqtt_status = MQTT_DISCONNECTED;
+static int8_t wifi_rssi = 0;
+
+// USART2 receive ring, filled from the RXNE interrupt
+static uint8_t esp_rx_ring[ESP8266_RX_RING_SIZE];
+static volatile uint16_t esp_rx_head = 0;
+static volatile uint16_t esp_rx_tail = 0;
+static volatile uint32_t esp_rx_dropped = 0;    // ring full or USART overrun
+
+// esp8266_buffer holds the response lines of the running command followed by
+// the line still being received; URC lines are handled and cut out again
+static uint16_t esp_resp_len = 0;
+static uint16_t esp_line_len = 0;
+static ESP8266_MessageHandler_t esp_msg_handler = NULL;
 
 /**
   * @brief USART1 Initialization Function(for debug)
@@ -45,6 +63,144 @@ void MX_USART2_UART_Init(void)
     huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
     huart2.Init.OverSampling = UART_OVERSAMPLING_16;
     HAL_UART_Init(&huart2);
+
+    // everything the ESP8266 sends goes to the ring, see ESP8266_UART_IRQHandler
+    (void)USART2->SR;
+    (void)USART2->DR;
+    __HAL_UART_ENABLE_IT(&huart2, UART_IT_RXNE);
+}
+
+/**
+  * @brief USART2 interrupt hook, queues received bytes in the ring
+  * @retval 1 when the interrupt was a receive and is handled
+  * @note  Called first thing in USART2_IRQHandler, transmit still goes
+  *        through the HAL
+  */
+uint8_t ESP8266_UART_IRQHandler(void)
+{
+    uint32_t sr = USART2->SR;
+    uint8_t byte;
+    uint16_t next;
+
+    if(!(sr & (USART_SR_RXNE | USART_SR_ORE))) return 0;
+
+    // SR then DR read also clears ORE, the byte behind it is lost
+    byte = (uint8_t)USART2->DR;
+    if(sr & USART_SR_ORE) {
+        esp_rx_dropped++;
+    }
+    next = (esp_rx_head + 1) & ESP8266_RX_RING_MASK;
+    if(next != esp_rx_tail) {
+        esp_rx_ring[esp_rx_head] = byte;
+        esp_rx_head = next;
+    } else {
+        esp_rx_dropped++;
+    }
+    return 1;
+}
+
+/**
+  * @brief take one byte off the receive ring, the OTA download reads the
+  *        +IPD stream this way without the line handling
+  * @retval 0 when the ring is empty
+  */
+uint8_t ESP8266_RxGet(uint8_t* byte)
+{
+    uint16_t tail = esp_rx_tail;
+
+    if(tail == esp_rx_head) return 0;
+    *byte = esp_rx_ring[tail];
+    esp_rx_tail = (tail + 1) & ESP8266_RX_RING_MASK;
+    return 1;
+}
+
+/**
+  * @brief bytes waiting in the receive ring
+  */
+uint16_t ESP8266_RxLevel(void)
+{
+    return (esp_rx_head - esp_rx_tail) & ESP8266_RX_RING_MASK;
+}
+
+/**
+  * @brief received bytes lost since power-up, ring full plus USART overruns
+  */
+uint32_t ESP8266_GetRxDropped(void)
+{
+    return esp_rx_dropped;
+}
+
+/**
+  * @brief hand a +MQTTSUBRECV line to the message handler
+  * @param args line after the URC prefix, e.g. 0,"sensor/ota",42,host,...
+  */
+static void ESP8266_DispatchMessage(char* args)
+{
+    char* topic;
+    char* end;
+    char* data;
+    uint32_t len;
+
+    topic = strchr(args, '"');
+    if(topic == NULL) return;
+    topic++;
+    end = strchr(topic, '"');
+    if(end == NULL || end[1] != ',') return;
+    *end = '\0';
+
+    data = strchr(end + 2, ',');
+    if(data == NULL) return;
+    data++;
+
+    // the payload cannot be longer than what made it into the line
+    len = strtoul(end + 2, NULL, 10);
+    if(len > strlen(data)) len = strlen(data);
+
+    if(esp_msg_handler != NULL) {
+        esp_msg_handler(topic, data, (uint16_t)len);
+    }
+}
+
+/**
+  * @brief drain the receive ring until a response line is complete
+  * @retval the line, NULL once the ring is empty
+  * @note  URCs are dispatched on the way and never reach the caller; the
+  *        line stays in esp8266_buffer while there is room behind it
+  */
+static char* ESP8266_RxLine(void)
+{
+    char* line;
+    uint8_t byte;
+
+    while(ESP8266_RxGet(&byte)) {
+        line = &esp8266_buffer[esp_resp_len];
+        if(byte != '\n') {
+            // kept terminated, WaitFor looks for the prompt in the partial line
+            if(byte != '\r' && esp_resp_len + esp_line_len < ESP8266_BUFFER_SIZE - 3) {
+                line[esp_line_len++] = byte;
+                line[esp_line_len] = '\0';
+            }
+            continue;
+        }
+        if(esp_line_len == 0) continue;
+        esp_line_len = 0;
+
+        if(strncmp(line, ESP8266_URC_MQTTSUBRECV, strlen(ESP8266_URC_MQTTSUBRECV)) == 0) {
+            ESP8266_DispatchMessage(line + strlen(ESP8266_URC_MQTTSUBRECV));
+            line[0] = '\0';
+            continue;
+        }
+
+        // a long listing only loses its tail, the next line still fits
+        if(esp_resp_len + strlen(line) + 2 <= ESP8266_BUFFER_SIZE - ESP8266_LINE_MAX) {
+            esp_resp_len += strlen(line);
+            esp8266_buffer[esp_resp_len++] = '\r';
+            esp8266_buffer[esp_resp_len++] = '\n';
+            esp8266_buffer[esp_resp_len] = '\0';
+        }
+        return line;
+    }
+    return NULL;
 }
 
 /**
@@ -56,9 +212,11 @@ void ESP8266_Reset(void)
     HAL_Delay(500);
     HAL_GPIO_WritePin(ESP8266_RST_GPIO_Port, ESP8266_RST_Pin, GPIO_PIN_SET);
     HAL_Delay(3000);  
-    // clear buffer
-    uint8_t dummy;
-    while(HAL_UART_Receive(&huart2, &dummy, 1, 10) == HAL_OK);
+    // drop the boot messages, sent at 74880 baud they are garbage here
+    esp_rx_tail = esp_rx_head;
+    esp_line_len = 0;
+    esp_resp_len = 0;
+    esp8266_buffer[0] = '\0';
 }
 
 /**
@@ -77,41 +235,35 @@ void ESP8266_SendCommand(char* command)
 ESP8266_Status_t ESP8266_ReceiveResponse(uint32_t timeout)
 {
     uint32_t start_time = HAL_GetTick();
-    uint16_t index = 0;
+    char* line;
 
-    memset(esp8266_buffer, 0, ESP8266_BUFFER_SIZE);
+    ESP8266_ClearBuffer();
 
     while ((HAL_GetTick() - start_time) < timeout)
     {
-        uint8_t byte;
-        if (HAL_UART_Receive(&huart2, &byte, 1, 10) == HAL_OK)
+        while ((line = ESP8266_RxLine()) != NULL)
         {
-            if (index < ESP8266_BUFFER_SIZE - 1)
+            // check OK response
+            if (strstr(line, "OK") != NULL)
             {
-                esp8266_buffer[index++] = byte;
-                esp8266_buffer[index] = '\0';
-
-                // check OK response
-                if (strstr(esp8266_buffer, "OK") != NULL)
-                {
-                    return ESP8266_OK;
-                }
-
-                // check ERROR response
-                if (strstr(esp8266_buffer, "ERROR") != NULL ||
-                                                       strstr(esp8266_buffer, "FAIL") != NULL)
-                {
-                    return ESP8266_ERROR;
-                }
-
-                // WiFi Connect response
-                if (strstr(esp8266_buffer, "WIFI CONNECTED") != NULL ||
-                        strstr(esp8266_buffer, "WIFI GOT IP") != NULL)
-                {
-                    return ESP8266_OK;
-                }
+                return ESP8266_OK;
+            }
+
+            // check ERROR response
+            if (strstr(line, "ERROR") != NULL || strstr(line, "FAIL") != NULL)
+            {
+                return ESP8266_ERROR;
+            }
+
+            // WiFi Connect response
+            if (strstr(line, "WIFI CONNECTED") != NULL ||
+                    strstr(line, "WIFI GOT IP") != NULL)
+            {
+                return ESP8266_OK;
             }
         }
+        // one tick keeps the idle task in plain WFI, the ring takes the bytes
+        osDelay(1);
     }
 
     return ESP8266_TIMEOUT_ERROR;
@@ -122,8 +274,59 @@ ESP8266_Status_t ESP8266_ReceiveResponse(uint32_t timeout)
   */
 ESP8266_Status_t ESP8266_SendCommandWithResponse(char* command, uint32_t timeout)
 {
+    ESP8266_Status_t status;
+
+    // lines queued so far are URCs or late replies, not this command's response
+    ESP8266_Process();
+    TRACE(TRACE_AT_SEND, strlen(command));
     ESP8266_SendCommand(command);
-    return ESP8266_ReceiveResponse(timeout);
+    status = ESP8266_ReceiveResponse(timeout);
+    TRACE(TRACE_AT_RESULT, status);
+    return status;
+}
+
+/**
+  * @brief wait until a specific token arrives, e.g. the ">" send prompt
+  */
+ESP8266_Status_t ESP8266_WaitFor(const char* token, uint32_t timeout)
+{
+    uint32_t start_time = HAL_GetTick();
+    char* line;
+
+    ESP8266_ClearBuffer();
+
+    while ((HAL_GetTick() - start_time) < timeout)
+    {
+        while ((line = ESP8266_RxLine()) != NULL)
+        {
+            if (strstr(line, token) != NULL)
+            {
+                return ESP8266_OK;
+            }
+            if (strstr(line, "ERROR") != NULL)
+            {
+                return ESP8266_ERROR;
+            }
+        }
+        // the prompt comes without a line end, consume it with the match
+        if (esp_line_len > 0 && strstr(&esp8266_buffer[esp_resp_len], token) != NULL)
+        {
+            esp_line_len = 0;
+            esp8266_buffer[esp_resp_len] = '\0';
+            return ESP8266_OK;
+        }
+        osDelay(1);
+    }
+
+    return ESP8266_TIMEOUT_ERROR;
+}
+
+/**
+  * @brief send raw bytes, used after a ">" prompt
+  */
+void ESP8266_SendRaw(const uint8_t* data, uint16_t len)
+{
+    HAL_UART_Transmit(&huart2, (uint8_t*)data, len, 1000);
 }
 
 /**
@@ -194,6 +397,33 @@ ESP8266_Status_t ESP8266_DisconnectWiFi(void)
     return ESP8266_SendCommandWithResponse("AT+CWQAP", 3000);
 }
 
+/**
+  * @brief parse RSSI from +CWJAP:"<ssid>","<bssid>",<channel>,<rssi>,...
+  * @retval RSSI in dBm, 0 if not found
+  */
+static int8_t ESP8266_ParseRSSI(char* response)
+{
+    char* p = strstr(response, "+CWJAP:\"");
+    if (p == NULL) return 0;
+
+    // skip quoted SSID, which may itself contain commas
+    p = strstr(p + 8, "\",");
+    if (p == NULL) return 0;
+    p += 1;
+
+    // skip BSSID and channel fields
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        p = strchr(p, ',');
+        if (p == NULL) return 0;
+        p++;
+    }
+
+    int rssi = atoi(p);
+    if (rssi < -127 || rssi >= 0) return 0;
+    return (int8_t)rssi;
+}
+
 /**
   * @brief check WiFi state
   */
@@ -205,20 +435,32 @@ WiFi_Status_t ESP8266_GetWiFiStatus(void)
                                                strstr(esp8266_buffer, "+CWJAP:") != NULL)
         {
             wifi_status = WIFI_CONNECTED;
+            wifi_rssi = ESP8266_ParseRSSI(esp8266_buffer);
         }
         else
         {
             wifi_status = WIFI_DISCONNECTED;
+            wifi_rssi = 0;
         }
     }
     else
     {
         wifi_status = WIFI_DISCONNECTED;
+        wifi_rssi = 0;
     }
 
     return wifi_status;
 }
 
+/**
+  * @brief get RSSI captured by the last ESP8266_GetWiFiStatus call
+  * @retval RSSI in dBm, 0 if unknown
+  */
+int8_t ESP8266_GetRSSI(void)
+{
+    return wifi_rssi;
+}
+
 /**
   * @brief acquire WiFi infformation
   */
@@ -368,48 +610,22 @@ MQTT_Status_t ESP8266_GetMQTTStatus(void)
 }
 
 /**
-  * @brief check receive MQTT info state
+  * @brief register the callback for +MQTTSUBRECV messages
+  * @note  Called as soon as the line is complete, possibly from inside
+  *        another ESP8266 call, so it must not send AT commands itself
   */
-ESP8266_Status_t ESP8266_ReceiveMQTT(char* topic_buffer, char* message_buffer)
+void ESP8266_SetMessageHandler(ESP8266_MessageHandler_t handler)
 {
-    if (strstr(esp8266_buffer, "+MQTTSUBRECV:") != NULL)
-    {
-        char* msg_start = strstr(esp8266_buffer, "+MQTTSUBRECV:");
-        if (msg_start != NULL)
-        {
-            // Parsing topics and messages
-            char* topic_start = strstr(msg_start, ",\"");
-            if (topic_start != NULL)
-            {
-                topic_start += 2;
-                char* topic_end = strstr(topic_start, "\",\"");
-                if (topic_end != NULL)
-                {
-                    // copy topic
-                    int topic_len = topic_end - topic_start;
-                    if (topic_buffer != NULL)
-                    {
-                        strncpy(topic_buffer, topic_start, topic_len);
-                        topic_buffer[topic_len] = '\0';
-                    }
-
-                    // copy info
-                    char* message_start = topic_end + 3;
-                    char* message_end = strstr(message_start, "\"");
-                    if (message_end != NULL && message_buffer != NULL)
-                    {
-                        int message_len = message_end - message_start;
-                        strncpy(message_buffer, message_start, message_len);
-                        message_buffer[message_len] = '\0';
-                    }
-
-                    return ESP8266_OK;
-                }
-            }
-        }
-    }
+    esp_msg_handler = handler;
+}
 
-    return ESP8266_ERROR;
+/**
+  * @brief handle received URCs while no command is running
+  */
+void ESP8266_Process(void)
+{
+    while (ESP8266_RxLine() != NULL);
+    ESP8266_ClearBuffer();
 }
 
 /**
@@ -422,10 +638,13 @@ char* ESP8266_GetBuffer(void)
 
 /**
   * @brief clear buffer
+  * @note  A partly received line may be the start of a URC and is kept
   */
 void ESP8266_ClearBuffer(void)
 {
-    memset(esp8266_buffer, 0, ESP8266_BUFFER_SIZE);
+    memmove(esp8266_buffer, &esp8266_buffer[esp_resp_len], esp_line_len);
+    esp_resp_len = 0;
+    memset(&esp8266_buffer[esp_line_len], 0, ESP8266_BUFFER_SIZE - esp_line_len);
 }
 
 /**
@@ -16,7 +16,9 @@
 extern ADC_HandleTypeDef hadc1;
 extern CRC_HandleTypeDef hcrc;
 extern I2C_HandleTypeDef hi2c1;
+extern DMA_HandleTypeDef hdma_i2c1_tx;
 extern SPI_HandleTypeDef hspi1;
+extern DMA_HandleTypeDef hdma_spi1_tx;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart2;
 extern IWDG_HandleTypeDef hiwdg;
@@ -24,6 +26,7 @@ extern IWDG_HandleTypeDef hiwdg;
 // Function prototypes
 void SystemClock_Config(void);
 void MX_GPIO_Init(void);
+void MX_DMA_Init(void);
 void MX_ADC1_Init(void);
 void MX_I2C1_Init(void);
 void MX_SPI1_Init(void);
@@ -71,8 +74,9 @@ float DHT11_Read_Temperature(void);
 float DHT11_Read_Humidity(void);
 uint8_t DHT11_Check_Sensor(void);
 
-// OLED display functions
+// OLED display functions, drawing only touches the framebuffer until OLED_Refresh()
 void OLED_Init(void);
+void OLED_Refresh(void);
 void OLED_Clear(void);
 void OLED_Display_On(void);
 void OLED_Display_Off(void);
@@ -82,6 +86,7 @@ void OLED_ShowString(uint8_t x, uint8_t y, uint8_t *chr);
 void OLED_ShowNum(uint8_t x, uint8_t y, uint32_t num, uint8_t len);
 void OLED_ShowFloat(uint8_t x, uint8_t y, float num, uint8_t len, uint8_t size);
 void OLED_Clear_Line(uint8_t line);
+void OLED_Clear_Span(uint8_t line, uint8_t x0, uint8_t x1);
 
 // ESP8266 WiFi and MQTT functions
 typedef enum {
@@ -103,6 +108,11 @@ typedef enum {
     MQTT_CONNECTED
 } MQTT_Status_t;
 
+#define ESP8266_RX_RING_SIZE    512     // USART2 receive ring, power of two
+
+// +MQTTSUBRECV callback, data is not terminated at len
+typedef void (*ESP8266_MessageHandler_t)(const char* topic, const char* data, uint16_t len);
+
 // ESP8266 basic functions
 void ESP8266_Reset(void);
 void ESP8266_SendCommand(char* command);
@@ -111,6 +121,14 @@ ESP8266_Status_t ESP8266_SendCommandWithResponse(char* command, uint32_t timeout
 ESP8266_Status_t ESP8266_Init(void);
 char* ESP8266_GetBuffer(void);
 void ESP8266_ClearBuffer(void);
+ESP8266_Status_t ESP8266_WaitFor(const char* token, uint32_t timeout);
+void ESP8266_SendRaw(const uint8_t* data, uint16_t len);
+uint8_t ESP8266_UART_IRQHandler(void);
+uint8_t ESP8266_RxGet(uint8_t* byte);
+uint16_t ESP8266_RxLevel(void);
+uint32_t ESP8266_GetRxDropped(void);
+void ESP8266_SetMessageHandler(ESP8266_MessageHandler_t handler);
+void ESP8266_Process(void);
 
 // WiFi related functions
 ESP8266_Status_t ESP8266_ConnectWiFi(char* ssid, char* password);
@@ -126,7 +144,7 @@ ESP8266_Status_t ESP8266_SubscribeMQTT(char* topic, uint8_t qos);
 ESP8266_Status_t ESP8266_UnsubscribeMQTT(char* topic);
 ESP8266_Status_t ESP8266_DisconnectMQTT(void);
 MQTT_Status_t ESP8266_GetMQTTStatus(void);
-ESP8266_Status_t ESP8266_ReceiveMQTT(char* topic_buffer, char* message_buffer);
+int8_t ESP8266_GetRSSI(void);
 
 // Application layer function
 ESP8266_Status_t ESP8266_SendSensorData(float temperature, float humidity, 
@@ -142,12 +160,162 @@ ESP8266_Status_t ESP8266_SendSensorData(float temperature, float humidity,
 #define TASK_ID_MQTT      2
 #define TASK_ID_DEFAULT   3
 #define MAX_TASKS         4
+#define WDT_LATE_BUCKETS  8     // <10/<50/<100/<500/<1000/<2000/<5000/>=5000 ms late
 
 // watchdog defination
 HAL_StatusTypeDef Watchdog_Init(uint32_t timeout_ms);
 void Watchdog_Feed(void);
+void Watchdog_Task_Register(uint8_t task_id, uint32_t period_ms, uint32_t deadline_ms);
 void Watchdog_Task_Heartbeat(uint8_t task_id);
 uint8_t Watchdog_Check_All_Tasks(void);
 void Watchdog_Get_Status(char* buffer, uint16_t size);
+uint8_t Watchdog_Take_Warnings(void);
+void Watchdog_Format(char* buffer, uint16_t size);
+
+// ===================  Link quality definitions  ===================
+#define LINK_RTT_BUCKETS  8     // <50/<100/<200/<500/<1000/<2000/<5000/>=5000 ms
+
+typedef enum {
+    LINK_QUALITY_UNKNOWN = 0,
+    LINK_QUALITY_GOOD,
+    LINK_QUALITY_FAIR,
+    LINK_QUALITY_POOR
+} LinkQuality_Level_t;
+
+void LinkQuality_RecordRssi(int8_t rssi);
+void LinkQuality_RecordRtt(uint32_t rtt_ms);
+void LinkQuality_RecordFailure(void);
+uint32_t LinkQuality_GetRttMedian(void);
+LinkQuality_Level_t LinkQuality_GetLevel(void);
+uint32_t LinkQuality_PaceInterval(uint32_t base_interval);
+void LinkQuality_Format(char* buffer, uint16_t size);
+
+// ===================  RTOS statistics definitions  ===================
+#define RTOS_STATS_MAX_TASKS    12      // 6 tasks today (5 + idle), static since the heap is 512 B
+#define RTOS_STATS_PERIOD       30000   // ms between samples
+
+void RtosStats_Update(void);
+void RtosStats_Format(char* buffer, uint16_t size);
+void RtosStats_Dump(void);
+
+// ===================  Low power definitions  ===================
+// Reasons to stay out of STOP mode, see LowPower_AllowStop()
+#define LP_STOP_ALARM           0x01    // alarm path must not wait for the HSE/PLL restart
+#define LP_STOP_LINK            0x02    // USART2 is not clocked in STOP, pushed MQTT messages would be lost
+
+typedef struct {
+    uint32_t window_ms;
+    uint32_t sleep_ms;          // SLEEP mode, core stopped, clocks running
+    uint32_t stop_ms;           // STOP mode, HSE/PLL off
+    uint32_t stop_entries;
+    uint32_t wake_max_us;       // worst STOP exit after the RTC alarm
+    uint8_t cpu_percent;
+} LowPower_Stats_t;
+
+void LowPower_Init(void);
+void LowPower_AllowStop(uint8_t source, uint8_t allow);
+void LowPower_GetStats(LowPower_Stats_t* stats);
+
+// ===================  W25Q64 SPI flash definitions  ===================
+#define W25Q64_PAGE_SIZE        256
+#define W25Q64_SECTOR_SIZE      4096
+#define W25Q64_BLOCK_SIZE       65536
+
+uint8_t W25Q64_Init(void);
+uint32_t W25Q64_ReadJEDECID(void);
+uint16_t W25Q64_ReadID(void);
+uint8_t W25Q64_ReadStatusReg(void);
+void W25Q64_WriteStatusReg(uint8_t status);
+void W25Q64_WriteEnable(void);
+void W25Q64_WriteDisable(void);
+uint8_t W25Q64_IsBusy(void);
+HAL_StatusTypeDef W25Q64_WaitForReady(uint32_t timeout);
+void W25Q64_ReadData(uint32_t addr, uint8_t* buf, uint32_t len);
+HAL_StatusTypeDef W25Q64_PageProgram(uint32_t addr, const uint8_t* buf, uint16_t len);
+HAL_StatusTypeDef W25Q64_PageProgram_DMA(uint32_t addr, const uint8_t* buf, uint16_t len);
+void W25Q64_SectorErase(uint32_t addr);
+void W25Q64_BlockErase(uint32_t addr);
+void W25Q64_ChipErase(void);
+void W25Q64_PowerDown(void);
+void W25Q64_WakeUp(void);
+
+// ===================  OTA update definitions  ===================
+#define OTA_IDLE_TIMEOUT        5000    // ms without data before a download is abandoned
+
+typedef struct {
+    char host[40];
+    uint16_t port;
+    char path[48];
+    uint32_t size;
+    uint32_t crc;               // STM32 CRC unit, see tools/ota_pack.py
+    uint32_t patch_size;        // 0 for a full image, else a delta patch of this size
+    uint8_t dry_run;            // download and verify only, nothing is installed
+} OTA_Request_t;
+
+typedef enum {
+    OTA_RESULT_OK = 0,
+    OTA_RESULT_BAD_REQUEST,
+    OTA_RESULT_FLASH_ERROR,
+    OTA_RESULT_CONNECT_ERROR,
+    OTA_RESULT_HTTP_ERROR,
+    OTA_RESULT_TIMEOUT,
+    OTA_RESULT_OVERRUN,
+    OTA_RESULT_CRC_ERROR,
+    OTA_RESULT_PATCH_ERROR,
+    OTA_RESULT_BASE_MISMATCH,   // patch was made against another image
+    OTA_RESULT_CURRENT,         // image already installed
+    OTA_RESULT_REJECTED         // image was installed before and rolled back
+} OTA_Result_t;
+
+typedef struct {
+    uint32_t bytes;             // body bytes over the link, all of them staged
+    uint32_t image_bytes;       // image (or patch) bytes the body stands for
+    uint16_t pages;             // W25Q64 page programs
+    uint8_t compressed;
+    uint32_t elapsed_ms;
+    uint32_t flash_wait_us;     // time the stream stalled on the SPI flash
+    uint16_t ring_peak;         // highest USART2 ring fill
+    uint32_t apply_ms;          // delta patch reconstruction time
+} OTA_Stats_t;
+
+uint8_t OTA_ParseRequest(const char* text, OTA_Request_t* req);
+OTA_Result_t OTA_Download(const OTA_Request_t* req, OTA_Stats_t* stats);
+OTA_Result_t OTA_ApplyPatch(uint32_t patch_addr, uint32_t patch_size, uint32_t image_size, uint8_t* work);
+
+void OTA_ConfirmBoot(void);
+void OTA_Submit(const OTA_Request_t* req);
+const char* OTA_ResultString(OTA_Result_t result);
+
+// ===================  Event trace definitions  ===================
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE            0       // 1 records TRACE() points, costs the 1 KB ring
+#endif
+#define TRACE_DUMP_PERIOD       60000   // ms between USART1 dumps
+
+// Event IDs, keep in sync with tools/trace_decode.py
+typedef enum {
+    TRACE_SENSOR_READ_START = 1,
+    TRACE_SENSOR_READ_END,
+    TRACE_MUTEX_WAIT,           // arg = TRACE_MUTEX_*
+    TRACE_MUTEX_TAKEN,          // arg = TRACE_MUTEX_*
+    TRACE_AT_SEND,              // arg = command length
+    TRACE_AT_RESULT,            // arg = ESP8266_Status_t
+    TRACE_PUBLISH_DONE,         // arg = 1 on OK
+    TRACE_DISPLAY_FLUSH_START,
+    TRACE_DISPLAY_FLUSH_END     // arg = bytes sent
+} Trace_Event_t;
+
+#define TRACE_MUTEX_SENSOR      0
+#define TRACE_MUTEX_ESP8266     1
+#define TRACE_MUTEX_OLED        2
+
+#if TRACE_ENABLE
+void Trace_Record(uint8_t id, uint16_t arg);
+void Trace_Dump(void);
+#define TRACE(id, arg)          Trace_Record((uint8_t)(id), (uint16_t)(arg))
+#else
+#define TRACE(id, arg)          ((void)0)
+#define Trace_Dump()            ((void)0)
+#endif
 
 #endif /* HARDWARE_H */
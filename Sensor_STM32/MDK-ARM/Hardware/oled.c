@@ -1,14 +1,24 @@
 #include "main.h"
 #include "hardware.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 #include <math.h>
+#include <string.h>
 
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_tx;
 
 // OLED defination
 #define OLED_ADDRESS    0x78    // OLED I2C address (0x3C << 1) 0x78 write mode 0x79 read mode
 #define OLED_CMD        0x00    // Command
 #define OLED_DATA       0x40    // Data
 
+// Framebuffer geometry, one byte holds 8 vertical pixels like the SSD1306 GDDRAM
+#define OLED_PAGES      8
+#define OLED_WIDTH      128
+#define OLED_DMA_TIMEOUT 50     // ms, a full 128 byte page takes ~3ms at 400kHz
+
 // 6x8 font array (extended character set)
 static const uint8_t F6x8[][6] = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00},   // space (0)
@@ -80,6 +90,34 @@ static const uint8_t F6x8[][6] = {
     {0x00, 0x62, 0x64, 0x08, 0x13, 0x23},   // % (66)
 };
 
+// 1KB framebuffer, draw calls only touch RAM until OLED_Refresh()
+static uint8_t oled_fb[OLED_PAGES][OLED_WIDTH];
+// Dirty column span per page, lo > hi means the page is clean
+static uint8_t oled_dirty_lo[OLED_PAGES];
+static uint8_t oled_dirty_hi[OLED_PAGES];
+// Given from the I2C callbacks when a DMA page transfer ends. A semaphore
+// rather than a task notification, the display task uses its signals itself
+static SemaphoreHandle_t oled_dma_done = NULL;
+static StaticSemaphore_t oled_dma_done_buf;
+
+/**
+  * @brief DMA controller clock and interrupt enable
+  * @param None
+  * @retval None
+  */
+void MX_DMA_Init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    // DMA1_Channel3 (SPI1_TX) interrupt init, W25Q64 page programs
+    HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 7, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+
+    // DMA1_Channel6 (I2C1_TX) interrupt init
+    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 8, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+}
+
 /**
   * @brief I2C1 Initialization Function
   * @param None
@@ -142,17 +180,110 @@ void MX_GPIO_Init(void)
     HAL_GPIO_Init(ESP8266_RST_GPIO_Port, &GPIO_InitStruct);
 }
 /**
-  * @brief Write a byte to OLED
-  * @param dat Data
-  * @param cmd 0 - command; 1 - data
+  * @brief Write a command byte to OLED
+  * @param cmd Command
   * @retval None
   */
-static void OLED_WR_Byte(uint8_t dat, uint8_t cmd)
+static void OLED_WR_Cmd(uint8_t cmd)
+{
+    HAL_I2C_Mem_Write(&hi2c1, OLED_ADDRESS, OLED_CMD, I2C_MEMADD_SIZE_8BIT, &cmd, 1, 100);
+}
+
+/**
+  * @brief Write a byte to the framebuffer and widen the page dirty span
+  * @param x Column (0-127)
+  * @param page Page (0-7)
+  * @param dat Pixel column data
+  * @retval None
+  */
+static void OLED_FB_Write(uint8_t x, uint8_t page, uint8_t dat)
+{
+    if (x >= OLED_WIDTH || page >= OLED_PAGES) return;
+    if (oled_fb[page][x] == dat) return;     // unchanged pixels cost no I2C traffic
+
+    oled_fb[page][x] = dat;
+    if (oled_dirty_lo[page] > oled_dirty_hi[page])
+    {
+        oled_dirty_lo[page] = x;
+        oled_dirty_hi[page] = x;
+    }
+    else if (x < oled_dirty_lo[page])
+    {
+        oled_dirty_lo[page] = x;
+    }
+    else if (x > oled_dirty_hi[page])
+    {
+        oled_dirty_hi[page] = x;
+    }
+}
+
+/**
+  * @brief Mark a page span dirty
+  */
+static void OLED_Mark_Dirty(uint8_t page, uint8_t lo, uint8_t hi)
+{
+    if (oled_dirty_lo[page] > oled_dirty_hi[page])
+    {
+        oled_dirty_lo[page] = lo;
+        oled_dirty_hi[page] = hi;
+        return;
+    }
+    if (lo < oled_dirty_lo[page]) oled_dirty_lo[page] = lo;
+    if (hi > oled_dirty_hi[page]) oled_dirty_hi[page] = hi;
+}
+
+/**
+  * @brief Stream display data, by DMA once the scheduler runs, blocking before that
+  * @param data Pixel data
+  * @param len Byte count
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef OLED_WR_Data(uint8_t *data, uint16_t len)
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ||
+            hi2c1.hdmatx == NULL || oled_dma_done == NULL)
+    {
+        return HAL_I2C_Mem_Write(&hi2c1, OLED_ADDRESS, OLED_DATA, I2C_MEMADD_SIZE_8BIT, data, len, 100);
+    }
+
+    // drop a completion left over from a previously timed out transfer
+    xSemaphoreTake(oled_dma_done, 0);
+
+    if (HAL_I2C_Mem_Write_DMA(&hi2c1, OLED_ADDRESS, OLED_DATA, I2C_MEMADD_SIZE_8BIT, data, len) != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+    if (xSemaphoreTake(oled_dma_done, pdMS_TO_TICKS(OLED_DMA_TIMEOUT)) != pdTRUE)
+    {
+        // bus stuck, reinitialise I2C so the next flush can retry
+        HAL_I2C_DeInit(&hi2c1);
+        MX_I2C1_Init();
+        return HAL_TIMEOUT;
+    }
+    return (hi2c1.ErrorCode == HAL_I2C_ERROR_NONE) ? HAL_OK : HAL_ERROR;
+}
+
+/**
+  * @brief Wake the task waiting on a DMA page transfer
+  */
+static void OLED_Flush_Done_FromISR(I2C_HandleTypeDef *hi2c)
+{
+    BaseType_t woken = pdFALSE;
+
+    if (hi2c->Instance != I2C1 || oled_dma_done == NULL) return;
+
+    xSemaphoreGiveFromISR(oled_dma_done, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    OLED_Flush_Done_FromISR(hi2c);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
 {
-    uint8_t data[2];
-    data[0] = cmd ? OLED_DATA : OLED_CMD;
-    data[1] = dat;
-    HAL_I2C_Master_Transmit(&hi2c1, OLED_ADDRESS, data, 2, 100);
+    OLED_Flush_Done_FromISR(hi2c);
 }
 
 /**
@@ -163,9 +294,45 @@ static void OLED_WR_Byte(uint8_t dat, uint8_t cmd)
   */
 void OLED_Set_Pos(uint8_t x, uint8_t y)
 {
-    OLED_WR_Byte(0xb0 + y, 0);
-    OLED_WR_Byte(((x & 0xf0) >> 4) | 0x10, 0);
-    OLED_WR_Byte((x & 0x0f), 0);
+    uint8_t cmd[3];
+    cmd[0] = 0xb0 + y;
+    cmd[1] = ((x & 0xf0) >> 4) | 0x10;
+    cmd[2] = (x & 0x0f);
+    HAL_I2C_Mem_Write(&hi2c1, OLED_ADDRESS, OLED_CMD, I2C_MEMADD_SIZE_8BIT, cmd, 3, 100);
+}
+
+/**
+  * @brief Send dirty framebuffer regions to the display, one transfer per page
+  * @param None
+  * @retval None
+  */
+void OLED_Refresh(void)
+{
+    uint16_t sent = 0;
+
+    TRACE(TRACE_DISPLAY_FLUSH_START, 0);
+    for (uint8_t page = 0; page < OLED_PAGES; page++)
+    {
+        uint8_t lo = oled_dirty_lo[page];
+        uint8_t hi = oled_dirty_hi[page];
+
+        if (lo > hi) continue;
+
+        oled_dirty_lo[page] = 0xFF;
+        oled_dirty_hi[page] = 0;
+
+        OLED_Set_Pos(lo, page);
+        if (OLED_WR_Data(&oled_fb[page][lo], hi - lo + 1) != HAL_OK)
+        {
+            // keep the span so the next refresh retries it
+            OLED_Mark_Dirty(page, lo, hi);
+        }
+        else
+        {
+            sent += hi - lo + 1;
+        }
+    }
+    TRACE(TRACE_DISPLAY_FLUSH_END, sent);
 }
 
 /**
@@ -176,13 +343,10 @@ void OLED_Set_Pos(uint8_t x, uint8_t y)
 void OLED_Clear(void)
 {
     uint8_t i, n;
-    for (i = 0; i < 8; i++)
+    for (i = 0; i < OLED_PAGES; i++)
     {
-        OLED_WR_Byte(0xb0 + i, 0);
-        OLED_WR_Byte(0x00, 0);
-        OLED_WR_Byte(0x10, 0);
-        for (n = 0; n < 128; n++)
-            OLED_WR_Byte(0, 1);
+        for (n = 0; n < OLED_WIDTH; n++)
+            OLED_FB_Write(n, i, 0);
     }
 }
 
@@ -208,9 +372,8 @@ void OLED_ShowChar(uint8_t x, uint8_t y, uint8_t chr)
     else if (chr == '%') c = 66;                                 // Percent sign
     else c = 0; // Unsupported characters are shown as space
 
-    OLED_Set_Pos(x, y);
     for (i = 0; i < 6; i++)
-        OLED_WR_Byte(F6x8[c][i], 1);
+        OLED_FB_Write(x + i, y, F6x8[c][i]);
 }
 
 /**
@@ -293,9 +456,9 @@ void OLED_ShowFloat(uint8_t x, uint8_t y, float num, uint8_t len, uint8_t size)
   */
 void OLED_Display_On(void)
 {
-    OLED_WR_Byte(0X8D, 0);
-    OLED_WR_Byte(0X14, 0);
-    OLED_WR_Byte(0XAF, 0);
+    OLED_WR_Cmd(0X8D);
+    OLED_WR_Cmd(0X14);
+    OLED_WR_Cmd(0XAF);
 }
 
 /**
@@ -305,9 +468,9 @@ void OLED_Display_On(void)
   */
 void OLED_Display_Off(void)
 {
-    OLED_WR_Byte(0X8D, 0);
-    OLED_WR_Byte(0X10, 0);
-    OLED_WR_Byte(0XAE, 0);
+    OLED_WR_Cmd(0X8D);
+    OLED_WR_Cmd(0X10);
+    OLED_WR_Cmd(0XAE);
 }
 
 /**
@@ -319,9 +482,24 @@ void OLED_Clear_Line(uint8_t line)
 {
     if(line > 7) return;  // Prevent out-of-bounds
 
-    OLED_Set_Pos(0, line);
-    for(uint8_t i = 0; i < 128; i++) {
-        OLED_WR_Byte(0x00, 1);  // Clear all pixels in the line
+    for(uint8_t i = 0; i < OLED_WIDTH; i++) {
+        OLED_FB_Write(i, line, 0x00);  // Clear all pixels in the line
+    }
+}
+
+/**
+  * @brief Clear a column span of one line, only changed pixels are marked dirty
+  * @param line Line number (0-7)
+  * @param x0 First column
+  * @param x1 Last column, inclusive
+  * @retval None
+  */
+void OLED_Clear_Span(uint8_t line, uint8_t x0, uint8_t x1)
+{
+    if(line > 7) return;
+
+    for(uint8_t i = x0; i <= x1 && i < OLED_WIDTH; i++) {
+        OLED_FB_Write(i, line, 0x00);
     }
 }
 
@@ -332,36 +510,44 @@ void OLED_Clear_Line(uint8_t line)
   */
 void OLED_Init(void)
 {
+    static const uint8_t init_cmds[] = {
+        0xAE,       // Display off
+        0x20, 0x10, // Set memory addressing mode: page addressing mode
+        0xb0,       // Set page start address
+        0xc8,       // Set COM output scan direction
+        0x00,       // Set low column address
+        0x10,       // Set high column address
+        0x40,       // Set start line address
+        0x81, 0xFF, // Set contrast control
+        0xa1,       // Set segment re-map
+        0xa6,       // Set normal display
+        0xa8, 0x3F, // Set multiplex ratio: 1/64 duty
+        0xa4,       // Enable entire display
+        0xd3, 0x00, // Set display offset: no offset
+        0xd5, 0xf0, // Set display clock divide ratio/oscillator frequency
+        0xd9, 0x22, // Set pre-charge period
+        0xda, 0x12, // Set COM pins hardware configuration
+        0xdb, 0x20, // Set VCOMH
+        0x8d, 0x14, // Set DC-DC enable
+        0xaf        // Display on
+    };
+
+    if (oled_dma_done == NULL)
+    {
+        oled_dma_done = xSemaphoreCreateBinaryStatic(&oled_dma_done_buf);
+    }
+
     HAL_Delay(200);
 
-    OLED_WR_Byte(0xAE, 0); // Display off
-    OLED_WR_Byte(0x20, 0); // Set memory addressing mode
-    OLED_WR_Byte(0x10, 0); // Page addressing mode
-    OLED_WR_Byte(0xb0, 0); // Set page start address
-    OLED_WR_Byte(0xc8, 0); // Set COM output scan direction
-    OLED_WR_Byte(0x00, 0); // Set low column address
-    OLED_WR_Byte(0x10, 0); // Set high column address
-    OLED_WR_Byte(0x40, 0); // Set start line address
-    OLED_WR_Byte(0x81, 0); // Set contrast control
-    OLED_WR_Byte(0xFF, 0); // Contrast value
-    OLED_WR_Byte(0xa1, 0); // Set segment re-map
-    OLED_WR_Byte(0xa6, 0); // Set normal display
-    OLED_WR_Byte(0xa8, 0); // Set multiplex ratio
-    OLED_WR_Byte(0x3F, 0); // 1/64 duty
-    OLED_WR_Byte(0xa4, 0); // Enable entire display
-    OLED_WR_Byte(0xd3, 0); // Set display offset
-    OLED_WR_Byte(0x00, 0); // No offset
-    OLED_WR_Byte(0xd5, 0); // Set display clock divide ratio/oscillator frequency
-    OLED_WR_Byte(0xf0, 0); // Divide ratio
-    OLED_WR_Byte(0xd9, 0); // Set pre-charge period
-    OLED_WR_Byte(0x22, 0);
-    OLED_WR_Byte(0xda, 0); // Set COM pins hardware configuration
-    OLED_WR_Byte(0x12, 0);
-    OLED_WR_Byte(0xdb, 0); // Set VCOMH
-    OLED_WR_Byte(0x20, 0);
-    OLED_WR_Byte(0x8d, 0); // Set DC-DC enable
-    OLED_WR_Byte(0x14, 0);
-    OLED_WR_Byte(0xaf, 0); // Display on
-
-    OLED_Clear();
+    HAL_I2C_Mem_Write(&hi2c1, OLED_ADDRESS, OLED_CMD, I2C_MEMADD_SIZE_8BIT,
+                      (uint8_t*)init_cmds, sizeof(init_cmds), 100);
+
+    // GDDRAM content is unknown after power up, push the whole framebuffer
+    memset(oled_fb, 0, sizeof(oled_fb));
+    for (uint8_t page = 0; page < OLED_PAGES; page++)
+    {
+        oled_dirty_lo[page] = 0;
+        oled_dirty_hi[page] = OLED_WIDTH - 1;
+    }
+    OLED_Refresh();
 }
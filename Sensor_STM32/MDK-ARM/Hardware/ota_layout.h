@@ -0,0 +1,55 @@
+#ifndef OTA_LAYOUT_H
+#define OTA_LAYOUT_H
+
+#include <stdint.h>
+
+// Shared by the application (ota.c) and the bootloader (Bootloader/bootloader.c)
+
+// Internal flash, 64KB: 8KB bootloader followed by the application
+#define OTA_BOOT_ADDR           0x08000000
+#define OTA_APP_ADDR            0x08002000
+#define OTA_APP_MAX_SIZE        0xE000
+#define OTA_FLASH_PAGE_SIZE     1024
+
+// W25Q64 layout, one 64KB erase block per slot
+#define OTA_STAGING_ADDR        0x000000    // downloaded image
+#define OTA_BACKUP_ADDR         0x010000    // previous application, for rollback
+#define OTA_SCRATCH_ADDR        0x020000    // downloaded delta patch
+#define OTA_META_ADDR           0x030000    // 4KB sector holding OTA_Meta_t
+
+#define OTA_META_MAGIC          0x3141544F  // "OTA1"
+#define OTA_MAX_TRIAL_BOOTS     3           // unconfirmed boots before rollback
+
+// LZ compressed images (tools/ota_lz.py) are staged as received and expanded
+// by the bootloader at install, where the whole RAM is free for the window:
+//   "HSZ1", u8 window_bits, u8 lookahead_bits, u16 reserved, u32 raw_size
+#define OTA_LZ_MAGIC            0x315A5348  // "HSZ1"
+#define OTA_LZ_HEADER_SIZE      12
+#define OTA_LZ_WINDOW_BITS      12          // largest window the bootloader expands, 4KB
+
+// Update state machine, advanced by the application and the bootloader
+typedef enum {
+    OTA_STATE_NONE = 0,
+    OTA_STATE_PENDING,          // staging verified, bootloader should install it
+    OTA_STATE_INSTALLING,       // backup taken, internal flash being rewritten
+    OTA_STATE_TESTING,          // installed, waiting for OTA_ConfirmBoot()
+    OTA_STATE_CONFIRMED,        // running image reached the broker
+    OTA_STATE_ROLLED_BACK       // new image never confirmed, backup restored
+} OTA_State_t;
+
+// Word sized fields: erased flash reads 0xFFFFFFFF, the magic tells it apart
+typedef struct {
+    uint32_t magic;
+    uint32_t state;             // OTA_State_t
+    uint32_t size;              // image bytes in the staging slot
+    uint32_t crc;               // STM32 CRC unit over size rounded up to words, 0xFF padded
+    uint32_t boot_count;        // boots spent in OTA_STATE_TESTING
+    uint32_t backup_crc;        // CRC of the OTA_APP_MAX_SIZE backup
+    uint32_t lz_size;           // compressed bytes in the staging slot, 0 for a raw image
+    uint32_t lz_crc;            // CRC of those bytes, same padding
+} OTA_Meta_t;
+
+// Metadata written before lz_size existed leaves it erased
+#define OTA_META_IS_LZ(meta)    ((meta)->lz_size != 0 && (meta)->lz_size != 0xFFFFFFFF)
+
+#endif /* OTA_LAYOUT_H */
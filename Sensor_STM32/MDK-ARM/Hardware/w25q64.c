@@ -0,0 +1,257 @@
+#include "main.h"
+#include "hardware.h"
+#include "cmsis_os.h"
+
+DMA_HandleTypeDef hdma_spi1_tx;
+
+// W25Q64 command set
+#define W25Q64_CMD_WRITE_ENABLE     0x06
+#define W25Q64_CMD_WRITE_DISABLE    0x04
+#define W25Q64_CMD_READ_STATUS1     0x05
+#define W25Q64_CMD_WRITE_STATUS     0x01
+#define W25Q64_CMD_READ_DATA        0x03
+#define W25Q64_CMD_PAGE_PROGRAM     0x02
+#define W25Q64_CMD_SECTOR_ERASE     0x20
+#define W25Q64_CMD_BLOCK_ERASE      0xD8
+#define W25Q64_CMD_CHIP_ERASE       0xC7
+#define W25Q64_CMD_POWER_DOWN       0xB9
+#define W25Q64_CMD_WAKE_UP          0xAB
+#define W25Q64_CMD_MANUFACTURER_ID  0x90
+#define W25Q64_CMD_JEDEC_ID         0x9F
+
+#define W25Q64_STATUS_BUSY          0x01
+#define W25Q64_JEDEC_ID             0xEF4017
+
+#define W25Q64_CS_LOW()     HAL_GPIO_WritePin(W25Q64_CS_GPIO_Port, W25Q64_CS_Pin, GPIO_PIN_RESET)
+#define W25Q64_CS_HIGH()    HAL_GPIO_WritePin(W25Q64_CS_GPIO_Port, W25Q64_CS_Pin, GPIO_PIN_SET)
+
+// Set while a DMA page program is still clocking data out, CS goes high in the callback
+static volatile uint8_t w25q64_dma_busy = 0;
+
+static void W25Q64_SendAddress(uint8_t cmd, uint32_t addr)
+{
+    uint8_t header[4];
+
+    header[0] = cmd;
+    header[1] = (uint8_t)(addr >> 16);
+    header[2] = (uint8_t)(addr >> 8);
+    header[3] = (uint8_t)addr;
+    HAL_SPI_Transmit(&hspi1, header, sizeof(header), 10);
+}
+
+static void W25Q64_SendByte(uint8_t cmd)
+{
+    W25Q64_CS_LOW();
+    HAL_SPI_Transmit(&hspi1, &cmd, 1, 10);
+    W25Q64_CS_HIGH();
+}
+
+/**
+  * @brief wake the flash and check its JEDEC ID
+  * @retval 1 if a W25Q64 answers
+  */
+uint8_t W25Q64_Init(void)
+{
+    W25Q64_CS_HIGH();
+    W25Q64_WakeUp();
+    return W25Q64_ReadJEDECID() == W25Q64_JEDEC_ID;
+}
+
+uint32_t W25Q64_ReadJEDECID(void)
+{
+    uint8_t cmd = W25Q64_CMD_JEDEC_ID;
+    uint8_t id[3] = {0};
+
+    W25Q64_CS_LOW();
+    HAL_SPI_Transmit(&hspi1, &cmd, 1, 10);
+    HAL_SPI_Receive(&hspi1, id, sizeof(id), 10);
+    W25Q64_CS_HIGH();
+
+    return ((uint32_t)id[0] << 16) | ((uint32_t)id[1] << 8) | id[2];
+}
+
+uint16_t W25Q64_ReadID(void)
+{
+    uint8_t id[2] = {0};
+
+    W25Q64_CS_LOW();
+    W25Q64_SendAddress(W25Q64_CMD_MANUFACTURER_ID, 0);
+    HAL_SPI_Receive(&hspi1, id, sizeof(id), 10);
+    W25Q64_CS_HIGH();
+
+    return ((uint16_t)id[0] << 8) | id[1];
+}
+
+uint8_t W25Q64_ReadStatusReg(void)
+{
+    uint8_t cmd = W25Q64_CMD_READ_STATUS1;
+    uint8_t status = 0;
+
+    W25Q64_CS_LOW();
+    HAL_SPI_Transmit(&hspi1, &cmd, 1, 10);
+    HAL_SPI_Receive(&hspi1, &status, 1, 10);
+    W25Q64_CS_HIGH();
+
+    return status;
+}
+
+void W25Q64_WriteStatusReg(uint8_t status)
+{
+    uint8_t cmd[2] = {W25Q64_CMD_WRITE_STATUS, status};
+
+    W25Q64_WriteEnable();
+    W25Q64_CS_LOW();
+    HAL_SPI_Transmit(&hspi1, cmd, sizeof(cmd), 10);
+    W25Q64_CS_HIGH();
+}
+
+void W25Q64_WriteEnable(void)
+{
+    W25Q64_SendByte(W25Q64_CMD_WRITE_ENABLE);
+}
+
+void W25Q64_WriteDisable(void)
+{
+    W25Q64_SendByte(W25Q64_CMD_WRITE_DISABLE);
+}
+
+/**
+  * @brief 1 while a DMA transfer or an internal program/erase is in progress
+  */
+uint8_t W25Q64_IsBusy(void)
+{
+    if(w25q64_dma_busy) return 1;
+    return (W25Q64_ReadStatusReg() & W25Q64_STATUS_BUSY) != 0;
+}
+
+/**
+  * @brief wait for the previous program/erase to finish
+  * @note  Page programs finish in under 1ms and are polled; erases take tens
+  *        of ms, so once the scheduler runs the wait sleeps between polls
+  */
+HAL_StatusTypeDef W25Q64_WaitForReady(uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+
+    while(w25q64_dma_busy) {
+        if(HAL_GetTick() - start >= timeout) return HAL_TIMEOUT;
+    }
+    while(W25Q64_ReadStatusReg() & W25Q64_STATUS_BUSY) {
+        if(HAL_GetTick() - start >= timeout) return HAL_TIMEOUT;
+        if(HAL_GetTick() - start > 2 && osKernelRunning()) {
+            osDelay(1);
+        }
+    }
+    return HAL_OK;
+}
+
+void W25Q64_ReadData(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+    W25Q64_CS_LOW();
+    W25Q64_SendAddress(W25Q64_CMD_READ_DATA, addr);
+    while(len) {
+        uint16_t chunk = (len > 0xFFFF) ? 0xFFFF : (uint16_t)len;
+        HAL_SPI_Receive(&hspi1, buf, chunk, 100);
+        buf += chunk;
+        len -= chunk;
+    }
+    W25Q64_CS_HIGH();
+}
+
+/**
+  * @brief program up to one page, blocking until the data is clocked out
+  * @note  Does not wait for the internal program cycle, call WaitForReady()
+  */
+HAL_StatusTypeDef W25Q64_PageProgram(uint32_t addr, const uint8_t* buf, uint16_t len)
+{
+    HAL_StatusTypeDef status;
+
+    if(len == 0 || len > W25Q64_PAGE_SIZE) return HAL_ERROR;
+
+    W25Q64_WriteEnable();
+    W25Q64_CS_LOW();
+    W25Q64_SendAddress(W25Q64_CMD_PAGE_PROGRAM, addr);
+    status = HAL_SPI_Transmit(&hspi1, (uint8_t*)buf, len, 10);
+    W25Q64_CS_HIGH();
+    return status;
+}
+
+/**
+  * @brief program up to one page, the data phase runs on DMA1 Channel3
+  * @note  Returns as soon as the transfer is started, buf must stay untouched
+  *        until WaitForReady(). CS is released from the DMA complete callback.
+  */
+HAL_StatusTypeDef W25Q64_PageProgram_DMA(uint32_t addr, const uint8_t* buf, uint16_t len)
+{
+    if(len == 0 || len > W25Q64_PAGE_SIZE) return HAL_ERROR;
+
+    W25Q64_WriteEnable();
+    W25Q64_CS_LOW();
+    W25Q64_SendAddress(W25Q64_CMD_PAGE_PROGRAM, addr);
+    w25q64_dma_busy = 1;
+    if(HAL_SPI_Transmit_DMA(&hspi1, (uint8_t*)buf, len) != HAL_OK) {
+        w25q64_dma_busy = 0;
+        W25Q64_CS_HIGH();
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+  * @brief SPI TX DMA complete, latches the page program
+  */
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    if(hspi->Instance == SPI1) {
+        W25Q64_CS_HIGH();
+        w25q64_dma_busy = 0;
+    }
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    if(hspi->Instance == SPI1) {
+        W25Q64_CS_HIGH();
+        w25q64_dma_busy = 0;
+    }
+}
+
+/**
+  * @brief start a 4KB sector erase, ~45ms typical
+  */
+void W25Q64_SectorErase(uint32_t addr)
+{
+    W25Q64_WriteEnable();
+    W25Q64_CS_LOW();
+    W25Q64_SendAddress(W25Q64_CMD_SECTOR_ERASE, addr);
+    W25Q64_CS_HIGH();
+}
+
+/**
+  * @brief start a 64KB block erase, ~150ms typical
+  */
+void W25Q64_BlockErase(uint32_t addr)
+{
+    W25Q64_WriteEnable();
+    W25Q64_CS_LOW();
+    W25Q64_SendAddress(W25Q64_CMD_BLOCK_ERASE, addr);
+    W25Q64_CS_HIGH();
+}
+
+void W25Q64_ChipErase(void)
+{
+    W25Q64_WriteEnable();
+    W25Q64_SendByte(W25Q64_CMD_CHIP_ERASE);
+}
+
+void W25Q64_PowerDown(void)
+{
+    W25Q64_SendByte(W25Q64_CMD_POWER_DOWN);
+}
+
+void W25Q64_WakeUp(void)
+{
+    W25Q64_SendByte(W25Q64_CMD_WAKE_UP);
+    // tRES1, 3us
+    for(volatile uint16_t i = 0; i < 100; i++);
+}
@@ -0,0 +1,222 @@
+#include "hardware.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+// RTT window and histogram configuration
+#define LINK_RTT_WINDOW         32      // rolling window of publish-to-OK samples
+#define LINK_FAIL_WINDOW        8       // rolling window of publish outcomes
+
+// Link quality thresholds
+#define LINK_RSSI_GOOD          (-65)   // dBm
+#define LINK_RSSI_POOR          (-80)   // dBm
+#define LINK_RTT_GOOD_MS        300
+#define LINK_RTT_POOR_MS        1500
+
+// Pacing limits
+#define LINK_INTERVAL_MIN_MS    5000
+#define LINK_INTERVAL_MAX_MS    60000
+
+// Histogram bucket upper edges (ms), last bucket is open-ended
+static const uint16_t rtt_bucket_edges[LINK_RTT_BUCKETS - 1] = {
+    50, 100, 200, 500, 1000, 2000, 5000
+};
+
+typedef struct {
+    uint16_t rtt_samples[LINK_RTT_WINDOW];
+    uint8_t rtt_head;
+    uint8_t rtt_count;
+    uint8_t rtt_hist[LINK_RTT_BUCKETS];
+    uint16_t rtt_max;
+    uint8_t outcomes;           // bit set = failed publish, newest in bit 0
+    uint8_t outcome_count;
+    uint8_t consecutive_fail;
+    int8_t rssi;                // 0 = not measured yet
+    uint32_t total_ok;
+    uint32_t total_fail;
+    uint32_t last_interval;
+} LinkQuality_t;
+
+// Only touched by the MQTT task while it holds ESP8266MutexHandle
+static LinkQuality_t link;
+
+/**
+  * @brief map an RTT to its histogram bucket
+  */
+static uint8_t LinkQuality_Bucket(uint16_t rtt_ms)
+{
+    uint8_t i;
+    for(i = 0; i < LINK_RTT_BUCKETS - 1; i++) {
+        if(rtt_ms < rtt_bucket_edges[i]) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+  * @brief push a publish outcome into the failure window
+  */
+static void LinkQuality_PushOutcome(uint8_t failed)
+{
+    link.outcomes = (uint8_t)((link.outcomes << 1) | (failed ? 1 : 0));
+    if(link.outcome_count < LINK_FAIL_WINDOW) {
+        link.outcome_count++;
+    }
+}
+
+/**
+  * @brief count failed publishes in the rolling window
+  */
+static uint8_t LinkQuality_RecentFailures(void)
+{
+    uint8_t bits = link.outcomes;
+    uint8_t count = 0;
+    while(bits) {
+        count += bits & 1;
+        bits >>= 1;
+    }
+    return count;
+}
+
+/**
+  * @brief record latest RSSI reported by AT+CWJAP?
+  */
+void LinkQuality_RecordRssi(int8_t rssi)
+{
+    link.rssi = rssi;
+}
+
+/**
+  * @brief record a publish-to-OK round trip time
+  */
+void LinkQuality_RecordRtt(uint32_t rtt_ms)
+{
+    uint16_t rtt = (rtt_ms > 0xFFFF) ? 0xFFFF : (uint16_t)rtt_ms;
+
+    // evict the oldest sample from the histogram once the window is full
+    if(link.rtt_count == LINK_RTT_WINDOW) {
+        link.rtt_hist[LinkQuality_Bucket(link.rtt_samples[link.rtt_head])]--;
+    } else {
+        link.rtt_count++;
+    }
+    link.rtt_samples[link.rtt_head] = rtt;
+    link.rtt_head = (link.rtt_head + 1) % LINK_RTT_WINDOW;
+    link.rtt_hist[LinkQuality_Bucket(rtt)]++;
+
+    if(rtt > link.rtt_max) {
+        link.rtt_max = rtt;
+    }
+    link.total_ok++;
+    link.consecutive_fail = 0;
+    LinkQuality_PushOutcome(0);
+}
+
+/**
+  * @brief record a publish that failed or timed out
+  */
+void LinkQuality_RecordFailure(void)
+{
+    link.total_fail++;
+    if(link.consecutive_fail < 0xFF) {
+        link.consecutive_fail++;
+    }
+    LinkQuality_PushOutcome(1);
+}
+
+/**
+  * @brief median RTT of the rolling window, taken from the histogram
+  * @retval upper edge of the median bucket in ms, 0 if no samples
+  */
+uint32_t LinkQuality_GetRttMedian(void)
+{
+    uint8_t seen = 0;
+
+    if(link.rtt_count == 0) return 0;
+
+    for(uint8_t i = 0; i < LINK_RTT_BUCKETS; i++) {
+        seen += link.rtt_hist[i];
+        if(seen * 2 >= link.rtt_count) {
+            return (i < LINK_RTT_BUCKETS - 1) ? rtt_bucket_edges[i] : link.rtt_max;
+        }
+    }
+    return link.rtt_max;
+}
+
+/**
+  * @brief classify the link from RSSI, median RTT and recent failures
+  */
+LinkQuality_Level_t LinkQuality_GetLevel(void)
+{
+    uint32_t rtt_p50 = LinkQuality_GetRttMedian();
+    uint8_t failures = LinkQuality_RecentFailures();
+
+    if(link.rtt_count == 0 && link.rssi == 0 && link.outcome_count == 0) {
+        return LINK_QUALITY_UNKNOWN;
+    }
+    if(failures >= 2 || link.consecutive_fail > 0 ||
+            (link.rssi != 0 && link.rssi < LINK_RSSI_POOR) ||
+            rtt_p50 >= LINK_RTT_POOR_MS) {
+        return LINK_QUALITY_POOR;
+    }
+    if((link.rssi == 0 || link.rssi >= LINK_RSSI_GOOD) &&
+            rtt_p50 < LINK_RTT_GOOD_MS && failures == 0) {
+        return LINK_QUALITY_GOOD;
+    }
+    return LINK_QUALITY_FAIR;
+}
+
+/**
+  * @brief stretch or shrink the publish interval according to link quality
+  * @param base_interval nominal interval in ms
+  * @retval paced interval in ms
+  */
+uint32_t LinkQuality_PaceInterval(uint32_t base_interval)
+{
+    uint32_t interval;
+
+    switch(LinkQuality_GetLevel())
+    {
+    case LINK_QUALITY_GOOD:
+        interval = base_interval * 3 / 4;
+        break;
+    case LINK_QUALITY_POOR:
+        // back off further for every consecutive failure
+        interval = base_interval * 2;
+        for(uint8_t i = 1; i < link.consecutive_fail && interval < LINK_INTERVAL_MAX_MS; i++) {
+            interval *= 2;
+        }
+        break;
+    case LINK_QUALITY_FAIR:
+    case LINK_QUALITY_UNKNOWN:
+    default:
+        interval = base_interval;
+        break;
+    }
+
+    if(interval < LINK_INTERVAL_MIN_MS) interval = LINK_INTERVAL_MIN_MS;
+    if(interval > LINK_INTERVAL_MAX_MS) interval = LINK_INTERVAL_MAX_MS;
+
+    link.last_interval = interval;
+    return interval;
+}
+
+/**
+  * @brief format link statistics as an MQTT payload
+  */
+void LinkQuality_Format(char* buffer, uint16_t size)
+{
+    static const char* level_names[] = {"UNKNOWN", "GOOD", "FAIR", "POOR"};
+
+    if(!buffer) return;
+    snprintf(buffer, size,
+             "RSSI:%d_Level:%s_RTTp50:%lu_RTTmax:%u_Hist:%u/%u/%u/%u/%u/%u/%u/%u_OK:%lu_Fail:%lu_Interval:%lu",
+             link.rssi,
+             level_names[LinkQuality_GetLevel()],
+             (unsigned long)LinkQuality_GetRttMedian(),
+             link.rtt_max,
+             link.rtt_hist[0], link.rtt_hist[1], link.rtt_hist[2], link.rtt_hist[3],
+             link.rtt_hist[4], link.rtt_hist[5], link.rtt_hist[6], link.rtt_hist[7],
+             (unsigned long)link.total_ok, (unsigned long)link.total_fail,
+             (unsigned long)link.last_interval);
+}
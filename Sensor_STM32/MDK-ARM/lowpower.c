@@ -0,0 +1,307 @@
+#include "hardware.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// RTC runs from LSI (~40 kHz) divided by 4, roughly 100us per count
+#define LP_RTC_PRESCALER        4
+#define LP_CAL_COUNTS           500     // ~50ms calibration window against the core clock
+
+// Idle shorter than this keeps the tick running and just waits for the next interrupt
+#define LP_SUPPRESS_MIN_MS      5
+// STOP restarts HSE and PLL, not worth it for short idles
+#define LP_STOP_MIN_MS          20
+// Bound a single sleep so LSI drift never skews the tick by more than a few ms
+#define LP_MAX_SLEEP_MS         5000
+// Wake this many counts before the next task is due to absorb the HSE/PLL restart
+#define LP_STOP_EXIT_COUNTS     30
+
+typedef struct {
+    uint32_t window_start;      // RTC count of the last LowPower_GetStats()
+    uint32_t sleep_counts;
+    uint32_t stop_counts;
+    uint32_t stop_entries;
+    uint32_t wake_late_max;     // counts between the alarm and the restored clock
+} LowPower_Acc_t;
+
+static uint32_t rtc_hz = 40000 / LP_RTC_PRESCALER;
+static uint32_t count_residue = 0;      // sub-millisecond counts carried to the next step
+static volatile uint8_t stop_veto = 0;    // LP_STOP_xxx sources holding STOP off
+static uint8_t lp_ready = 0;
+static LowPower_Acc_t acc;
+
+static void LowPower_RTC_WaitWrite(void)
+{
+    while(!(RTC->CRL & RTC_CRL_RTOFF));
+}
+
+/**
+  * @brief resynchronise the RTC shadow registers after the APB1 clock stopped
+  */
+static void LowPower_RTC_Sync(void)
+{
+    RTC->CRL &= ~RTC_CRL_RSF;
+    while(!(RTC->CRL & RTC_CRL_RSF));
+}
+
+static uint32_t LowPower_RTC_Counter(void)
+{
+    uint16_t high = RTC->CNTH;
+    uint16_t low = RTC->CNTL;
+
+    // carry between the two halves, read again
+    if(high != RTC->CNTH) {
+        high = RTC->CNTH;
+        low = RTC->CNTL;
+    }
+    return ((uint32_t)high << 16) | low;
+}
+
+static void LowPower_RTC_SetAlarm(uint32_t count)
+{
+    LowPower_RTC_WaitWrite();
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->ALRH = (uint16_t)(count >> 16);
+    RTC->ALRL = (uint16_t)(count & 0xFFFF);
+    RTC->CRL &= ~(RTC_CRL_CNF | RTC_CRL_ALRF);
+    LowPower_RTC_WaitWrite();
+}
+
+static uint32_t LowPower_MsToCounts(uint32_t ms)
+{
+    return (uint32_t)(((uint64_t)ms * rtc_hz) / 1000);
+}
+
+static uint32_t LowPower_CountsToMs(uint32_t counts)
+{
+    return (uint32_t)(((uint64_t)counts * 1000) / rtc_hz);
+}
+
+/**
+  * @brief bring HSE and the PLL back after STOP, STOP always resumes on HSI
+  * @note  Register level on purpose: HAL timeouts need the tick we just suspended
+  */
+static void LowPower_RestoreClock(void)
+{
+    RCC->CR |= RCC_CR_HSEON;
+    while(!(RCC->CR & RCC_CR_HSERDY));
+    RCC->CR |= RCC_CR_PLLON;
+    while(!(RCC->CR & RCC_CR_PLLRDY));
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+    while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+}
+
+/**
+  * @brief measure the real LSI-driven RTC rate against the core clock
+  * @note  LSI is only specified to 30-60 kHz, tick compensation needs the actual rate
+  */
+static void LowPower_Calibrate(void)
+{
+    uint32_t start_count, start_cycles, cycles;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // align to a count edge
+    start_count = LowPower_RTC_Counter();
+    while(LowPower_RTC_Counter() == start_count);
+    start_count = LowPower_RTC_Counter();
+    start_cycles = DWT->CYCCNT;
+
+    while(LowPower_RTC_Counter() - start_count < LP_CAL_COUNTS);
+    cycles = DWT->CYCCNT - start_cycles;
+
+    if(cycles) {
+        rtc_hz = (uint32_t)(((uint64_t)LP_CAL_COUNTS * SystemCoreClock) / cycles);
+    }
+}
+
+/**
+  * @brief start the RTC as the low power time base and arm its alarm wake-up
+  * @note  Call after SystemClock_Config and before the scheduler starts
+  */
+void LowPower_Init(void)
+{
+    __HAL_RCC_PWR_CLK_ENABLE();
+    __HAL_RCC_BKP_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+
+    RCC->CSR |= RCC_CSR_LSION;
+    while(!(RCC->CSR & RCC_CSR_LSIRDY));
+
+    // RTC clock source can only be changed after a backup domain reset
+    if((RCC->BDCR & RCC_BDCR_RTCSEL) != RCC_BDCR_RTCSEL_LSI) {
+        RCC->BDCR |= RCC_BDCR_BDRST;
+        RCC->BDCR &= ~RCC_BDCR_BDRST;
+        RCC->BDCR |= RCC_BDCR_RTCSEL_LSI;
+    }
+    RCC->BDCR |= RCC_BDCR_RTCEN;
+
+    LowPower_RTC_Sync();
+    LowPower_RTC_WaitWrite();
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->PRLH = 0;
+    RTC->PRLL = LP_RTC_PRESCALER - 1;
+    RTC->CNTH = 0;
+    RTC->CNTL = 0;
+    RTC->CRL &= ~RTC_CRL_CNF;
+    LowPower_RTC_WaitWrite();
+
+    LowPower_Calibrate();
+
+    // RTC alarm reaches the NVIC through EXTI line 17, which also wakes STOP
+    LowPower_RTC_WaitWrite();
+    RTC->CRH |= RTC_CRH_ALRIE;
+    LowPower_RTC_WaitWrite();
+    EXTI->IMR |= EXTI_IMR_MR17;
+    EXTI->RTSR |= EXTI_RTSR_TR17;
+    HAL_NVIC_SetPriority(RTC_Alarm_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(RTC_Alarm_IRQn);
+
+    acc.window_start = LowPower_RTC_Counter();
+    lp_ready = 1;
+}
+
+/**
+  * @brief RTC alarm interrupt, only here to wake the core
+  */
+void LowPower_Alarm_IRQHandler(void)
+{
+    LowPower_RTC_WaitWrite();
+    RTC->CRL &= ~RTC_CRL_ALRF;
+    EXTI->PR = EXTI_PR_PR17;
+}
+
+/**
+  * @brief permit or forbid STOP mode for one source, SLEEP is always allowed
+  * @note  The sensor task forbids STOP while an alarm is active so the alarm
+  *        path never pays the HSE/PLL restart, the MQTT task while the broker
+  *        can push messages over USART2
+  */
+void LowPower_AllowStop(uint8_t source, uint8_t allow)
+{
+    taskENTER_CRITICAL();
+    if(allow) {
+        stop_veto &= ~source;
+    } else {
+        stop_veto |= source;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief tickless idle, replaces the port's SysTick based implementation
+  *        (configUSE_TICKLESS_IDLE 2). SysTick and the HAL TIM1 tick are
+  *        stopped and both are compensated from the RTC afterwards.
+  */
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime)
+{
+    uint32_t start, end, target, elapsed, ms;
+    uint8_t use_stop;
+
+    if(!lp_ready) return;
+
+    if(xExpectedIdleTime < LP_SUPPRESS_MIN_MS) {
+        // short idle: keep the tick, sleep until the next interrupt
+        start = LowPower_RTC_Counter();
+        __DSB();
+        __WFI();
+        __ISB();
+        acc.sleep_counts += LowPower_RTC_Counter() - start;
+        return;
+    }
+    if(xExpectedIdleTime > LP_MAX_SLEEP_MS) {
+        xExpectedIdleTime = LP_MAX_SLEEP_MS;
+    }
+
+    __disable_irq();
+    if(eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        __enable_irq();
+        return;
+    }
+
+    // I2C DMA to the OLED would stall in STOP
+    use_stop = !stop_veto &&
+               xExpectedIdleTime >= LP_STOP_MIN_MS &&
+               HAL_I2C_GetState(&hi2c1) == HAL_I2C_STATE_READY;
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    HAL_SuspendTick();
+
+    start = LowPower_RTC_Counter();
+    target = start + LowPower_MsToCounts(xExpectedIdleTime) - (use_stop ? LP_STOP_EXIT_COUNTS : 0);
+    LowPower_RTC_SetAlarm(target);
+
+    if(use_stop) {
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+        LowPower_RestoreClock();
+        LowPower_RTC_Sync();
+    } else {
+        __DSB();
+        __WFI();
+        __ISB();
+    }
+
+    end = LowPower_RTC_Counter();
+    elapsed = end - start;
+
+    // step the kernel and HAL ticks by whole milliseconds, carry the rest;
+    // the last tick is left to SysTick so the due task unblocks on time
+    ms = LowPower_CountsToMs(elapsed + count_residue);
+    if(ms >= xExpectedIdleTime) {
+        ms = xExpectedIdleTime - 1;
+        count_residue = 0;
+    } else {
+        count_residue = elapsed + count_residue - LowPower_MsToCounts(ms);
+    }
+    if(ms) {
+        vTaskStepTick(ms);
+        uwTick += ms;
+    }
+
+    if(use_stop) {
+        acc.stop_counts += elapsed;
+        acc.stop_entries++;
+        // woken by the alarm: how long until the clocks were back
+        if((int32_t)(end - target) > 0 && end - target > acc.wake_late_max) {
+            acc.wake_late_max = end - target;
+        }
+    } else {
+        acc.sleep_counts += elapsed;
+    }
+
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    HAL_ResumeTick();
+    __enable_irq();
+}
+
+/**
+  * @brief idle accounting since the previous call
+  */
+void LowPower_GetStats(LowPower_Stats_t* stats)
+{
+    uint32_t now, window, idle;
+    LowPower_Acc_t copy;
+
+    if(!stats) return;
+
+    taskENTER_CRITICAL();
+    now = lp_ready ? LowPower_RTC_Counter() : 0;
+    copy = acc;
+    acc.sleep_counts = 0;
+    acc.stop_counts = 0;
+    acc.stop_entries = 0;
+    acc.window_start = now;
+    taskEXIT_CRITICAL();
+
+    window = now - copy.window_start;
+    stats->window_ms = LowPower_CountsToMs(window);
+    stats->sleep_ms = LowPower_CountsToMs(copy.sleep_counts);
+    stats->stop_ms = LowPower_CountsToMs(copy.stop_counts);
+    stats->stop_entries = copy.stop_entries;
+    stats->wake_max_us = (uint32_t)(((uint64_t)copy.wake_late_max * 1000000) / rtc_hz);
+    idle = copy.sleep_counts + copy.stop_counts;
+    stats->cpu_percent = (window && idle < window) ?
+        (uint8_t)(100 - ((uint64_t)idle * 100) / window) : 0;
+}
@@ -0,0 +1,447 @@
+#include "hardware.h"
+#include "ota_layout.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OTA_LINE_SIZE       80      // longest HTTP header line kept, the rest is cut
+
+typedef enum {
+    OTA_IPD_SEARCH = 0,         // outside a +IPD frame: echo, SEND OK, CLOSED...
+    OTA_IPD_LENGTH,             // "+IPD," seen, reading the decimal length
+    OTA_IPD_DATA                // payload bytes belonging to the TCP stream
+} OTA_IpdState_t;
+
+typedef struct {
+    OTA_IpdState_t ipd_state;
+    uint8_t ipd_match;          // characters of "+IPD," matched so far
+    uint16_t ipd_left;          // payload bytes left in the current frame
+
+    uint8_t in_body;
+    uint8_t status_ok;
+    uint8_t line_len;
+    char line[OTA_LINE_SIZE];
+    uint32_t content_length;
+    uint32_t body;              // body bytes received
+    uint8_t header[OTA_LZ_HEADER_SIZE];    // first body bytes, tell an LZ stream from a raw image
+
+    uint8_t page_index;         // page buffer being filled
+    uint16_t page_fill;
+    uint32_t written;           // body bytes staged
+    uint32_t flash_addr;
+    uint32_t crc;
+    OTA_Stats_t* stats;
+} OTA_Stream_t;
+
+// Two pages: one is filled from the ring while DMA programs the other
+static uint32_t ota_page[2][W25Q64_PAGE_SIZE / 4];
+
+/**
+  * @brief pad a page buffer to whole words with 0xFF, returns the word count
+  */
+static uint32_t OTA_PadWords(uint8_t* page, uint16_t len)
+{
+    while(len & 3) {
+        page[len++] = 0xFF;
+    }
+    return len / 4;
+}
+
+/**
+  * @brief CRC of a W25Q64 range, same padding as the download
+  */
+static uint32_t OTA_CrcFlash(uint32_t addr, uint32_t size)
+{
+    uint32_t crc = 0;
+    uint16_t chunk;
+
+    __HAL_CRC_DR_RESET(&hcrc);
+    while(size) {
+        chunk = (size > W25Q64_PAGE_SIZE) ? W25Q64_PAGE_SIZE : (uint16_t)size;
+        W25Q64_ReadData(addr, (uint8_t*)ota_page[0], chunk);
+        crc = HAL_CRC_Accumulate(&hcrc, ota_page[0], OTA_PadWords((uint8_t*)ota_page[0], chunk));
+        addr += chunk;
+        size -= chunk;
+    }
+    return crc;
+}
+
+static uint8_t OTA_ReadMeta(OTA_Meta_t* meta)
+{
+    W25Q64_ReadData(OTA_META_ADDR, (uint8_t*)meta, sizeof(OTA_Meta_t));
+    return meta->magic == OTA_META_MAGIC;
+}
+
+static HAL_StatusTypeDef OTA_WriteMeta(const OTA_Meta_t* meta)
+{
+    W25Q64_SectorErase(OTA_META_ADDR);
+    if(W25Q64_WaitForReady(500) != HAL_OK) return HAL_TIMEOUT;
+    if(W25Q64_PageProgram(OTA_META_ADDR, (const uint8_t*)meta, sizeof(OTA_Meta_t)) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    return W25Q64_WaitForReady(10);
+}
+
+/**
+  * @brief hand a full (or the last) page to the flash and switch buffers
+  * @note  Only waits for the program issued one page earlier, which had a
+  *        whole page of UART time (~22ms at 115200) to finish its ~1ms cycle
+  */
+static OTA_Result_t OTA_FlushPage(OTA_Stream_t* s)
+{
+    uint8_t* page = (uint8_t*)ota_page[s->page_index];
+    uint32_t words = OTA_PadWords(page, s->page_fill);
+    uint32_t start;
+
+    s->crc = HAL_CRC_Accumulate(&hcrc, ota_page[s->page_index], words);
+
+    start = DWT->CYCCNT;
+    if(W25Q64_WaitForReady(10) != HAL_OK) return OTA_RESULT_FLASH_ERROR;
+    s->stats->flash_wait_us += (DWT->CYCCNT - start) / (SystemCoreClock / 1000000);
+
+    if(W25Q64_PageProgram_DMA(s->flash_addr, page, (uint16_t)(words * 4)) != HAL_OK) {
+        return OTA_RESULT_FLASH_ERROR;
+    }
+    s->flash_addr += W25Q64_PAGE_SIZE;
+    s->stats->pages++;
+    s->page_index ^= 1;
+    s->page_fill = 0;
+    return OTA_RESULT_OK;
+}
+
+/**
+  * @brief one body byte into the current page, compressed bodies are staged as is
+  */
+static OTA_Result_t OTA_PutByte(OTA_Stream_t* s, uint8_t byte)
+{
+    ((uint8_t*)ota_page[s->page_index])[s->page_fill++] = byte;
+    s->written++;
+    if(s->page_fill == W25Q64_PAGE_SIZE || s->written == s->content_length) {
+        return OTA_FlushPage(s);
+    }
+    return OTA_RESULT_OK;
+}
+
+static uint8_t OTA_IsCompressed(const uint8_t* header)
+{
+    uint32_t magic;
+
+    memcpy(&magic, header, sizeof(magic));
+    return magic == OTA_LZ_MAGIC;
+}
+
+/**
+  * @brief check a compressed body's header against the request
+  * @note  Only the bootloader expands the stream, so what it relies on is
+  *        checked before the staging slot is marked
+  */
+static uint8_t OTA_LzHeaderValid(const uint8_t* header, uint32_t image_size)
+{
+    uint32_t raw_size;
+
+    memcpy(&raw_size, &header[8], sizeof(raw_size));
+    return header[4] >= 4 && header[4] <= OTA_LZ_WINDOW_BITS &&
+           header[5] >= 1 && header[5] <= 8 && raw_size == image_size;
+}
+
+/**
+  * @brief one byte of the TCP stream: HTTP response header, then the body
+  */
+static OTA_Result_t OTA_HttpByte(OTA_Stream_t* s, uint8_t byte)
+{
+    if(s->in_body) {
+        if(s->body >= s->content_length) return OTA_RESULT_OK;
+        if(s->body < OTA_LZ_HEADER_SIZE) s->header[s->body] = byte;
+        s->body++;
+        return OTA_PutByte(s, byte);
+    }
+
+    if(byte == '\n') {
+        s->line[s->line_len] = '\0';
+        if(s->line_len == 0) {
+            // blank line, header done
+            if(!s->status_ok || s->content_length < OTA_LZ_HEADER_SIZE || s->content_length > W25Q64_BLOCK_SIZE) {
+                return OTA_RESULT_HTTP_ERROR;
+            }
+            s->in_body = 1;
+        } else if(strncmp(s->line, "HTTP/", 5) == 0) {
+            s->status_ok = (strstr(s->line, " 200") != NULL);
+        } else if(strncmp(s->line, "Content-Length:", 15) == 0) {
+            s->content_length = strtoul(s->line + 15, NULL, 10);
+        }
+        s->line_len = 0;
+    } else if(byte != '\r' && s->line_len < OTA_LINE_SIZE - 1) {
+        s->line[s->line_len++] = (char)byte;
+    }
+    return OTA_RESULT_OK;
+}
+
+/**
+  * @brief one byte from USART2: strip the ESP8266 "+IPD,<len>:" framing
+  */
+static OTA_Result_t OTA_StreamByte(OTA_Stream_t* s, uint8_t byte)
+{
+    static const char ipd[] = "+IPD,";
+
+    switch(s->ipd_state) {
+    case OTA_IPD_SEARCH:
+        if(byte == (uint8_t)ipd[s->ipd_match]) {
+            if(++s->ipd_match == sizeof(ipd) - 1) {
+                s->ipd_state = OTA_IPD_LENGTH;
+                s->ipd_left = 0;
+                s->ipd_match = 0;
+            }
+        } else {
+            s->ipd_match = (byte == '+') ? 1 : 0;
+        }
+        break;
+
+    case OTA_IPD_LENGTH:
+        if(byte >= '0' && byte <= '9') {
+            s->ipd_left = s->ipd_left * 10 + (byte - '0');
+        } else if(byte == ':' && s->ipd_left) {
+            s->ipd_state = OTA_IPD_DATA;
+        } else {
+            s->ipd_state = OTA_IPD_SEARCH;
+        }
+        break;
+
+    case OTA_IPD_DATA:
+        if(--s->ipd_left == 0) {
+            s->ipd_state = OTA_IPD_SEARCH;
+        }
+        return OTA_HttpByte(s, byte);
+    }
+    return OTA_RESULT_OK;
+}
+
+/**
+  * @brief parse a "host,port,path,size,crc[,patch_size[,dry_run]]" update request
+  * @note  crc in hex; with patch_size the path names a delta patch and
+  *        size/crc describe the image it rebuilds. dry_run 1 downloads and
+  *        verifies without installing, tools/ota_bench.py uses it
+  */
+uint8_t OTA_ParseRequest(const char* text, OTA_Request_t* req)
+{
+    unsigned int port, dry_run = 0;
+    unsigned long size, crc, patch_size = 0;
+    int fields;
+
+    if(!text || !req) return 0;
+
+    memset(req, 0, sizeof(OTA_Request_t));
+    fields = sscanf(text, "%39[^,],%u,%47[^,],%lu,%lx,%lu,%u", req->host, &port, req->path, &size, &crc, &patch_size, &dry_run);
+    if(fields < 5 || dry_run > 1) {
+        return 0;
+    }
+    if(port == 0 || port > 0xFFFF || size == 0 || size > OTA_APP_MAX_SIZE || req->path[0] != '/') {
+        return 0;
+    }
+    if(patch_size > W25Q64_BLOCK_SIZE) {
+        return 0;
+    }
+    req->port = (uint16_t)port;
+    req->size = size;
+    req->crc = crc;
+    req->patch_size = patch_size;
+    req->dry_run = (uint8_t)dry_run;
+    return 1;
+}
+
+/**
+  * @brief download an image over HTTP into the W25Q64 staging slot and mark it
+  *        for the bootloader
+  * @note  Caller holds the ESP8266 mutex. The staging block is erased before
+  *        connecting and pages are programmed by DMA behind the UART stream,
+  *        so the transfer runs at link speed. The task must not block longer
+  *        than the ring lasts (~44ms at 115200 for 512 bytes).
+  *        A delta patch is streamed into the scratch slot the same way and
+  *        only then expanded into staging, off the link. A full image may be
+  *        LZ compressed (tools/ota_lz.py): it is staged as received, so fewer
+  *        pages are programmed, and the bootloader expands it at install.
+  */
+OTA_Result_t OTA_Download(const OTA_Request_t* req, OTA_Stats_t* stats)
+{
+    OTA_Stream_t stream;
+    OTA_Meta_t meta;
+    char request[128];
+    char command[24];
+    uint32_t start, last_rx;
+    uint32_t dest = req->patch_size ? OTA_SCRATCH_ADDR : OTA_STAGING_ADDR;
+    uint32_t length = req->patch_size ? req->patch_size : req->size;
+    uint16_t level;
+    uint32_t dropped;
+    int len;
+    OTA_Result_t result = OTA_RESULT_OK;
+    uint8_t byte;
+
+    memset(stats, 0, sizeof(OTA_Stats_t));
+    memset(&stream, 0, sizeof(stream));
+
+    if(req->size == 0 || req->size > OTA_APP_MAX_SIZE || length > W25Q64_BLOCK_SIZE) return OTA_RESULT_BAD_REQUEST;
+    if(!W25Q64_Init()) return OTA_RESULT_FLASH_ERROR;
+
+    // a dry run may fetch the running image again, the meta block is left alone
+    if(!req->dry_run && OTA_ReadMeta(&meta) && meta.crc == req->crc) {
+        // the same image is already installed, e.g. a retained request after the update
+        if(meta.state == OTA_STATE_TESTING || meta.state == OTA_STATE_CONFIRMED) {
+            return OTA_RESULT_CURRENT;
+        }
+        // the bootloader already gave up on this image, a retained request would
+        // otherwise install and roll it back again on every reconnect
+        if(meta.state == OTA_STATE_ROLLED_BACK) {
+            return OTA_RESULT_REJECTED;
+        }
+    }
+
+    // erase up front, a 64KB block erase would stall the stream for ~150ms
+    W25Q64_BlockErase(OTA_STAGING_ADDR);
+    if(W25Q64_WaitForReady(2000) != HAL_OK) return OTA_RESULT_FLASH_ERROR;
+    if(req->patch_size) {
+        W25Q64_BlockErase(OTA_SCRATCH_ADDR);
+        if(W25Q64_WaitForReady(2000) != HAL_OK) return OTA_RESULT_FLASH_ERROR;
+    }
+
+    snprintf(request, sizeof(request), "AT+CIPSTART=\"TCP\",\"%s\",%u", req->host, req->port);
+    if(ESP8266_SendCommandWithResponse(request, 10000) != ESP8266_OK) {
+        return OTA_RESULT_CONNECT_ERROR;
+    }
+
+    len = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: %s\r\n\r\n", req->path, req->host);
+    snprintf(command, sizeof(command), "AT+CIPSEND=%d", len);
+    if(ESP8266_SendCommandWithResponse(command, 2000) != ESP8266_OK ||
+       ESP8266_WaitFor(">", 2000) != ESP8266_OK) {
+        ESP8266_SendCommandWithResponse("AT+CIPCLOSE", 2000);
+        return OTA_RESULT_CONNECT_ERROR;
+    }
+
+    __HAL_CRC_DR_RESET(&hcrc);
+    stream.flash_addr = dest;
+    stream.stats = stats;
+    dropped = ESP8266_GetRxDropped();
+    ESP8266_SendRaw((uint8_t*)request, (uint16_t)len);
+
+    start = HAL_GetTick();
+    last_rx = start;
+    while(!(stream.in_body && stream.body == stream.content_length)) {
+        level = ESP8266_RxLevel();
+        if(level > stats->ring_peak) stats->ring_peak = level;
+
+        if(ESP8266_GetRxDropped() != dropped) {
+            result = OTA_RESULT_OVERRUN;
+            break;
+        }
+        if(!ESP8266_RxGet(&byte)) {
+            if(HAL_GetTick() - last_rx >= OTA_IDLE_TIMEOUT) {
+                result = OTA_RESULT_TIMEOUT;
+                break;
+            }
+            // one tick keeps the idle task in plain WFI, STOP would drop USART2
+            osDelay(1);
+            continue;
+        }
+        last_rx = HAL_GetTick();
+
+        result = OTA_StreamByte(&stream, byte);
+        if(result != OTA_RESULT_OK) break;
+    }
+
+    stats->bytes = stream.body;
+    stats->compressed = OTA_IsCompressed(stream.header);
+    stats->image_bytes = stats->compressed ? req->size : stream.written;
+    stats->elapsed_ms = HAL_GetTick() - start;
+    ESP8266_SendCommandWithResponse("AT+CIPCLOSE", 2000);
+
+    if(W25Q64_WaitForReady(10) != HAL_OK && result == OTA_RESULT_OK) {
+        result = OTA_RESULT_FLASH_ERROR;
+    }
+    if(result != OTA_RESULT_OK) return result;
+    if(stats->compressed) {
+        // a patch is applied here, it has to arrive raw
+        if(req->patch_size || !OTA_LzHeaderValid(stream.header, req->size)) return OTA_RESULT_BAD_REQUEST;
+    } else if(stream.written != length) {
+        return OTA_RESULT_HTTP_ERROR;
+    }
+
+    if(req->patch_size) {
+        start = HAL_GetTick();
+        result = OTA_ApplyPatch(OTA_SCRATCH_ADDR, req->patch_size, req->size, (uint8_t*)ota_page);
+        stats->apply_ms = HAL_GetTick() - start;
+        if(result != OTA_RESULT_OK) return result;
+    } else if(!stats->compressed && stream.crc != req->crc) {
+        // stream CRC proves the transfer
+        return OTA_RESULT_CRC_ERROR;
+    }
+
+    // read-back CRC proves what the bootloader will install, a compressed
+    // image is checked against req->crc again once it is expanded
+    if(stats->compressed) {
+        if(OTA_CrcFlash(OTA_STAGING_ADDR, stream.written) != stream.crc) return OTA_RESULT_CRC_ERROR;
+    } else if(OTA_CrcFlash(OTA_STAGING_ADDR, req->size) != req->crc) {
+        return OTA_RESULT_CRC_ERROR;
+    }
+    if(req->dry_run) return OTA_RESULT_OK;
+
+    meta.magic = OTA_META_MAGIC;
+    meta.state = OTA_STATE_PENDING;
+    meta.size = req->size;
+    meta.crc = req->crc;
+    meta.boot_count = 0;
+    meta.backup_crc = 0;
+    meta.lz_size = stats->compressed ? stream.written : 0;
+    meta.lz_crc = stats->compressed ? stream.crc : 0;
+    if(OTA_WriteMeta(&meta) != HAL_OK) return OTA_RESULT_FLASH_ERROR;
+
+    return OTA_RESULT_OK;
+}
+
+/**
+  * @brief mark a freshly installed image as good
+  * @note  Called once the broker is reached; an image that never gets here is
+  *        rolled back by the bootloader after OTA_MAX_TRIAL_BOOTS resets
+  */
+void OTA_ConfirmBoot(void)
+{
+    OTA_Meta_t meta;
+
+    if(!W25Q64_Init() || !OTA_ReadMeta(&meta)) return;
+    if(meta.state != OTA_STATE_TESTING) return;
+
+    meta.state = OTA_STATE_CONFIRMED;
+    OTA_WriteMeta(&meta);
+}
+
+const char* OTA_ResultString(OTA_Result_t result)
+{
+    switch(result)
+    {
+    case OTA_RESULT_OK:
+        return "OK";
+    case OTA_RESULT_BAD_REQUEST:
+        return "BAD_REQUEST";
+    case OTA_RESULT_FLASH_ERROR:
+        return "FLASH_ERROR";
+    case OTA_RESULT_CONNECT_ERROR:
+        return "CONNECT_ERROR";
+    case OTA_RESULT_HTTP_ERROR:
+        return "HTTP_ERROR";
+    case OTA_RESULT_TIMEOUT:
+        return "TIMEOUT";
+    case OTA_RESULT_OVERRUN:
+        return "OVERRUN";
+    case OTA_RESULT_CRC_ERROR:
+        return "CRC_ERROR";
+    case OTA_RESULT_PATCH_ERROR:
+        return "PATCH_ERROR";
+    case OTA_RESULT_BASE_MISMATCH:
+        return "BASE_MISMATCH";
+    case OTA_RESULT_CURRENT:
+        return "CURRENT";
+    case OTA_RESULT_REJECTED:
+        return "REJECTED";
+    default:
+        return "UNKNOWN";
+    }
+}
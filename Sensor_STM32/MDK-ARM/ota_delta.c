@@ -0,0 +1,139 @@
+#include "hardware.h"
+#include "ota_layout.h"
+#include "main.h"
+#include <string.h>
+
+/*
+ * Delta patch, built by tools/ota_delta.py:
+ *   "DLT1", u32 old_size, u32 old_crc, u32 new_size    (little endian)
+ *   then ops until new_size bytes are produced, each starting with a
+ *   varint control = len << 1 | type:
+ *     type 0  ADD   len literal bytes follow
+ *     type 1  COPY  zigzag varint seek relative to the end of the previous
+ *                   copy, then len bytes are taken from the running image
+ * old_crc is the CRC unit value over the base image, a patch is only
+ * applied to the image it was made from.
+ */
+#define DELTA_MAGIC         0x31544C44  // "DLT1"
+#define DELTA_HEADER_SIZE   16
+
+typedef struct {
+    uint32_t addr;              // next W25Q64 address to fetch
+    uint32_t end;
+    uint8_t* buf;
+    uint16_t len;
+    uint16_t pos;
+} Delta_Reader_t;
+
+typedef struct {
+    uint32_t addr;              // next staging page
+    uint8_t* page;
+    uint16_t fill;
+    uint32_t written;
+} Delta_Writer_t;
+
+static int16_t Delta_GetByte(Delta_Reader_t* r)
+{
+    if(r->pos == r->len) {
+        if(r->addr >= r->end) return -1;
+        r->len = (r->end - r->addr > W25Q64_PAGE_SIZE) ? W25Q64_PAGE_SIZE : (uint16_t)(r->end - r->addr);
+        W25Q64_ReadData(r->addr, r->buf, r->len);
+        r->addr += r->len;
+        r->pos = 0;
+    }
+    return r->buf[r->pos++];
+}
+
+static uint8_t Delta_GetVarint(Delta_Reader_t* r, uint32_t* value)
+{
+    int16_t byte;
+    uint8_t shift = 0;
+
+    *value = 0;
+    do {
+        byte = Delta_GetByte(r);
+        if(byte < 0 || shift > 28) return 0;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    return 1;
+}
+
+static HAL_StatusTypeDef Delta_Flush(Delta_Writer_t* w)
+{
+    if(w->fill == 0) return HAL_OK;
+    if(W25Q64_PageProgram(w->addr, w->page, w->fill) != HAL_OK) return HAL_ERROR;
+    w->addr += W25Q64_PAGE_SIZE;
+    w->fill = 0;
+    // the reader shares the bus, finish the program before the next fetch
+    return W25Q64_WaitForReady(10);
+}
+
+static HAL_StatusTypeDef Delta_Put(Delta_Writer_t* w, uint8_t byte)
+{
+    w->page[w->fill++] = byte;
+    w->written++;
+    return (w->fill == W25Q64_PAGE_SIZE) ? Delta_Flush(w) : HAL_OK;
+}
+
+/**
+  * @brief rebuild the new image in the staging slot from a patch in the W25Q64
+  *        and the application currently running from internal flash
+  * @param work 2 * W25Q64_PAGE_SIZE bytes, patch read buffer and output page
+  * @note  Both sides stream: the patch is read a page at a time and the output
+  *        is programmed a page at a time, nothing image sized is held in RAM
+  */
+OTA_Result_t OTA_ApplyPatch(uint32_t patch_addr, uint32_t patch_size, uint32_t image_size, uint8_t* work)
+{
+    Delta_Reader_t reader;
+    Delta_Writer_t writer;
+    const uint8_t* old_image = (const uint8_t*)OTA_APP_ADDR;
+    uint32_t header[DELTA_HEADER_SIZE / 4];
+    uint32_t old_size, old_pos = 0;
+    uint32_t control, len, seek;
+
+    if(patch_size <= DELTA_HEADER_SIZE) return OTA_RESULT_PATCH_ERROR;
+
+    W25Q64_ReadData(patch_addr, (uint8_t*)header, DELTA_HEADER_SIZE);
+    old_size = header[1];
+    if(header[0] != DELTA_MAGIC || header[3] != image_size || old_size == 0 || old_size > OTA_APP_MAX_SIZE) {
+        return OTA_RESULT_PATCH_ERROR;
+    }
+    // the patch only makes sense against the image it was diffed from
+    if(HAL_CRC_Calculate(&hcrc, (uint32_t*)OTA_APP_ADDR, (old_size + 3) / 4) != header[2]) {
+        return OTA_RESULT_BASE_MISMATCH;
+    }
+
+    memset(&reader, 0, sizeof(reader));
+    reader.addr = patch_addr + DELTA_HEADER_SIZE;
+    reader.end = patch_addr + patch_size;
+    reader.buf = work;
+    memset(&writer, 0, sizeof(writer));
+    writer.addr = OTA_STAGING_ADDR;
+    writer.page = work + W25Q64_PAGE_SIZE;
+
+    while(writer.written < image_size) {
+        if(!Delta_GetVarint(&reader, &control)) return OTA_RESULT_PATCH_ERROR;
+        len = control >> 1;
+        if(len == 0 || len > image_size - writer.written) return OTA_RESULT_PATCH_ERROR;
+
+        if(control & 1) {
+            if(!Delta_GetVarint(&reader, &seek)) return OTA_RESULT_PATCH_ERROR;
+            // zigzag decode
+            old_pos += (seek & 1) ? ~(seek >> 1) : (seek >> 1);
+            if(old_pos > old_size || len > old_size - old_pos) return OTA_RESULT_PATCH_ERROR;
+            for(uint32_t i = 0; i < len; i++) {
+                if(Delta_Put(&writer, old_image[old_pos + i]) != HAL_OK) return OTA_RESULT_FLASH_ERROR;
+            }
+            old_pos += len;
+        } else {
+            for(uint32_t i = 0; i < len; i++) {
+                int16_t byte = Delta_GetByte(&reader);
+                if(byte < 0) return OTA_RESULT_PATCH_ERROR;
+                if(Delta_Put(&writer, (uint8_t)byte) != HAL_OK) return OTA_RESULT_FLASH_ERROR;
+            }
+        }
+    }
+
+    return (Delta_Flush(&writer) == HAL_OK) ? OTA_RESULT_OK : OTA_RESULT_FLASH_ERROR;
+}
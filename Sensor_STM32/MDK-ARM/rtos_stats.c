@@ -0,0 +1,168 @@
+#include "hardware.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+#include <stdio.h>
+
+extern UART_HandleTypeDef huart1;
+
+typedef struct {
+    const char* name;
+    uint8_t cpu_percent;        // share of the last sampling interval
+    uint16_t stack_free;        // stack high-water mark, words never used
+} RtosStats_Task_t;
+
+typedef struct {
+    RtosStats_Task_t tasks[RTOS_STATS_MAX_TASKS];
+    uint8_t task_count;         // tasks listed, 0 when they did not fit
+    uint8_t task_total;         // tasks in the kernel
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t interval_ms;
+    LowPower_Stats_t power;     // tickless idle accounting over the same window
+} RtosStats_Snapshot_t;
+
+// Raw kernel state, only used by the sampling task
+static TaskStatus_t task_status[RTOS_STATS_MAX_TASKS];
+static uint32_t prev_task_runtime[RTOS_STATS_MAX_TASKS + 1];   // indexed by xTaskNumber
+static uint32_t prev_total_runtime = 0;
+static uint32_t prev_sample_tick = 0;
+
+// Latest published view, copied in and out under a critical section
+static RtosStats_Snapshot_t snapshot;
+
+/**
+  * @brief sample run-time counters, stack high-water marks and heap usage
+  * @note  CPU % is computed over the time since the previous call. The run-time
+  *        counter is DWT->CYCCNT, which stops in STOP mode (lowpower.c), so the
+  *        per-task shares are of the time the core was clocked, not of the
+  *        wall-clock window; the stop_ms figure next to them gives the rest.
+  * @note  uxTaskGetSystemState() fills nothing when the array is too small, the
+  *        task count is kept so the truncation shows up in the output
+  */
+void RtosStats_Update(void)
+{
+    RtosStats_Snapshot_t next;
+    uint32_t total_runtime = 0;
+    uint32_t now = HAL_GetTick();
+    UBaseType_t count;
+
+    count = uxTaskGetSystemState(task_status, RTOS_STATS_MAX_TASKS, &total_runtime);
+    if(count == 0) {
+        // too many tasks for the array, no runtime total either
+        total_runtime = prev_total_runtime;
+    }
+
+    uint32_t interval = total_runtime - prev_total_runtime;
+    if(interval == 0) interval = 1;
+
+    memset(&next, 0, sizeof(next));
+    for(UBaseType_t i = 0; i < count; i++) {
+        TaskStatus_t* ts = &task_status[i];
+        uint32_t number = ts->xTaskNumber;
+        uint32_t delta = ts->ulRunTimeCounter;
+
+        if(number <= RTOS_STATS_MAX_TASKS) {
+            delta = ts->ulRunTimeCounter - prev_task_runtime[number];
+            prev_task_runtime[number] = ts->ulRunTimeCounter;
+        }
+
+        next.tasks[i].name = ts->pcTaskName;
+        next.tasks[i].cpu_percent = (uint8_t)(((uint64_t)delta * 100) / interval);
+        next.tasks[i].stack_free = ts->usStackHighWaterMark;
+    }
+    next.task_count = (uint8_t)count;
+    next.task_total = (uint8_t)uxTaskGetNumberOfTasks();
+    next.heap_free = xPortGetFreeHeapSize();
+    next.heap_min_free = xPortGetMinimumEverFreeHeapSize();
+    if(next.heap_free == 0 && next.heap_min_free == 0) {
+        // heap_4 sets up its pool on the first allocation, none means untouched
+        next.heap_free = configTOTAL_HEAP_SIZE;
+        next.heap_min_free = configTOTAL_HEAP_SIZE;
+    }
+    next.interval_ms = now - prev_sample_tick;
+    LowPower_GetStats(&next.power);
+
+    prev_total_runtime = total_runtime;
+    prev_sample_tick = now;
+
+    taskENTER_CRITICAL();
+    snapshot = next;
+    taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief format the latest sample as an MQTT payload
+  * @note  Tasks are listed as name:cpu%:stack_free_words, separated by '/'
+  */
+void RtosStats_Format(char* buffer, uint16_t size)
+{
+    RtosStats_Snapshot_t copy;
+    int len;
+
+    if(!buffer || size == 0) return;
+
+    taskENTER_CRITICAL();
+    copy = snapshot;
+    taskEXIT_CRITICAL();
+
+    len = snprintf(buffer, size, "Heap:%lu_HeapMin:%lu_Window:%lu_CPU:%u_Sleep:%lu_Stop:%lu_WakeMax:%lu_TaskCount:%u_Tasks:",
+                   (unsigned long)copy.heap_free,
+                   (unsigned long)copy.heap_min_free,
+                   (unsigned long)copy.interval_ms,
+                   copy.power.cpu_percent,
+                   (unsigned long)copy.power.sleep_ms,
+                   (unsigned long)copy.power.stop_ms,
+                   (unsigned long)copy.power.wake_max_us,
+                   copy.task_total);
+
+    for(uint8_t i = 0; i < copy.task_count && len > 0 && len < size; i++) {
+        len += snprintf(buffer + len, size - len, "%s%s:%u:%u",
+                        i ? "/" : "",
+                        copy.tasks[i].name,
+                        copy.tasks[i].cpu_percent,
+                        copy.tasks[i].stack_free);
+    }
+}
+
+/**
+  * @brief dump the latest sample to USART1, one task per line
+  */
+void RtosStats_Dump(void)
+{
+    RtosStats_Snapshot_t copy;
+    char line[64];
+    int len;
+
+    taskENTER_CRITICAL();
+    copy = snapshot;
+    taskEXIT_CRITICAL();
+
+    len = snprintf(line, sizeof(line), "\r\n[RTOS] heap free %lu min %lu window %lums\r\n",
+                   (unsigned long)copy.heap_free,
+                   (unsigned long)copy.heap_min_free,
+                   (unsigned long)copy.interval_ms);
+    HAL_UART_Transmit(&huart1, (uint8_t*)line, len, 100);
+
+    len = snprintf(line, sizeof(line), "[RTOS] cpu %u%% sleep %lums stop %lums (%lu) wake max %luus\r\n",
+                   copy.power.cpu_percent,
+                   (unsigned long)copy.power.sleep_ms,
+                   (unsigned long)copy.power.stop_ms,
+                   (unsigned long)copy.power.stop_entries,
+                   (unsigned long)copy.power.wake_max_us);
+    HAL_UART_Transmit(&huart1, (uint8_t*)line, len, 100);
+
+    if(copy.task_count == 0 && copy.task_total > 0) {
+        len = snprintf(line, sizeof(line), "[RTOS] %u tasks, over RTOS_STATS_MAX_TASKS %u\r\n",
+                       copy.task_total, RTOS_STATS_MAX_TASKS);
+        HAL_UART_Transmit(&huart1, (uint8_t*)line, len, 100);
+    }
+    for(uint8_t i = 0; i < copy.task_count; i++) {
+        len = snprintf(line, sizeof(line), "[RTOS] %-16s cpu %3u%% stack free %u words\r\n",
+                       copy.tasks[i].name,
+                       copy.tasks[i].cpu_percent,
+                       copy.tasks[i].stack_free);
+        HAL_UART_Transmit(&huart1, (uint8_t*)line, len, 100);
+    }
+}
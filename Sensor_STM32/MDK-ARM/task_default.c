@@ -7,6 +7,8 @@ void StartDefaultTask(void const * argument)
 {
     uint32_t last_feed = 0;
     uint32_t feed_count = 0;
+    uint32_t last_stats = 0;
+    uint32_t last_trace = 0;
 		// Wait for system to be stable
     osDelay(10000);
 		// init watchdig and configure 25s timeout
@@ -14,6 +16,7 @@ void StartDefaultTask(void const * argument)
         while(1) osDelay(1000);
     }
 		
+    Watchdog_Task_Register(TASK_ID_DEFAULT, 2000, 10000);
     Watchdog_Feed();
     last_feed = HAL_GetTick();
     feed_count = 1;
@@ -32,6 +35,17 @@ void StartDefaultTask(void const * argument)
                 last_feed = now;
             }
         }
+        // sample CPU, stack and heap usage and dump it on the debug port
+        if(now - last_stats >= RTOS_STATS_PERIOD) {
+            RtosStats_Update();
+            RtosStats_Dump();
+            last_stats = now;
+        }
+        // binary event trace, decoded on the host by tools/trace_decode.py
+        if(now - last_trace >= TRACE_DUMP_PERIOD) {
+            Trace_Dump();
+            last_trace = now;
+        }
         osDelay(2000);
     }
 }
@@ -1,6 +1,7 @@
 #include "main.h"
 #include "tasks.h"
 #include "hardware.h"
+#include <stdio.h>
 
 // External global variable declarations - added new sensor variables
 extern float g_temperature;
@@ -21,6 +22,86 @@ extern uint16_t g_light_lux;
 
 uint8_t startflag;
 
+// Alarm detection-to-pixel latency
+static uint32_t alarm_latency_last = 0;
+static uint32_t alarm_latency_max = 0;
+static uint32_t alarm_latency_count = 0;
+
+#define DISPLAY_LABEL_LEN   8       // label column ends at x=47
+#define DISPLAY_VALUE_X     50
+#define DISPLAY_VALUE_LEN   12      // "Disconnected", value column ends at x=121
+
+/**
+* @brief Draw a label and a fixed-width value so the whole row is overwritten in place
+*        Padding and the cleared gaps cover all 128 columns, so text left by the
+*        start, alarm or power save screens never shows through
+* @param row OLED page (0-7)
+* @param label Label at column 0, space padded to DISPLAY_LABEL_LEN
+* @param value Value at DISPLAY_VALUE_X, space padded to DISPLAY_VALUE_LEN
+* @retval None
+*/
+static void Display_Row(uint8_t row, const char* label, const char* value)
+{
+    char padded[DISPLAY_VALUE_LEN + 1];
+
+    snprintf(padded, sizeof(padded), "%-8s", label);
+    OLED_ShowString(0, row, (uint8_t*)padded);
+    OLED_Clear_Span(row, DISPLAY_LABEL_LEN * 6, DISPLAY_VALUE_X - 1);
+    snprintf(padded, sizeof(padded), "%-12s", value);
+    OLED_ShowString(DISPLAY_VALUE_X, row, (uint8_t*)padded);
+    OLED_Clear_Span(row, DISPLAY_VALUE_X + DISPLAY_VALUE_LEN * 6, 127);
+}
+
+/**
+* @brief Compose the alarm screen, flush it and record detection-to-pixel latency
+* @param smoke_alarm MQ-2 alarm state
+* @param air_alarm MQ-135 alarm state
+* @retval None
+*/
+static void Display_Alarm(uint8_t smoke_alarm, uint8_t air_alarm)
+{
+    uint32_t detect_tick;
+
+    OLED_Display_On();
+    OLED_Clear();
+    if(smoke_alarm)
+    {
+        OLED_ShowString(35, 2, (uint8_t*)"SMOKE ALARM!");
+    }
+    if(air_alarm)
+    {
+        OLED_ShowString(40, 3, (uint8_t*)"AIR ALARM!");
+    }
+    OLED_Refresh();
+
+    // pixels are on the panel once the flush returns
+    detect_tick = g_alarm_detect_tick;
+    if(detect_tick != 0)
+    {
+        g_alarm_detect_tick = 0;
+        alarm_latency_last = HAL_GetTick() - detect_tick;
+        if(alarm_latency_last > alarm_latency_max)
+        {
+            alarm_latency_max = alarm_latency_last;
+        }
+        alarm_latency_count++;
+    }
+}
+
+/**
+* @brief Get alarm detection-to-pixel latency statistics
+* @param last_ms Latency of the most recent alarm
+* @param max_ms Worst latency since boot
+* @param count Number of alarms measured
+* @retval None
+*/
+void Display_GetAlarmLatency(uint32_t* last_ms, uint32_t* max_ms, uint32_t* count)
+{
+    if(last_ms) *last_ms = alarm_latency_last;
+    if(max_ms) *max_ms = alarm_latency_max;
+    if(count) *count = alarm_latency_count;
+}
+
 /**
 * @brief Function implementing the DisplayTask thread.
 * @param argument: Not used
@@ -35,10 +116,13 @@ void StartDisplayTask(void const * argument)
         OLED_Clear();
         OLED_ShowString(15, 5, (uint8_t*)"System Starting...");
         OLED_ShowString(0, 1, (uint8_t*)"Please Wait...");
+        OLED_Refresh();
         osMutexRelease(OledMutexHandle);
     }
 		// Display warm-up time
     osDelay(5000);
+    // refresh every 8s, alarms only make it earlier
+    Watchdog_Task_Register(TASK_ID_DISPLAY, 8000, 20000);
 
     for(;;)
     {
@@ -47,6 +131,7 @@ void StartDisplayTask(void const * argument)
         uint16_t air_ppm, light_lux;
         uint8_t wifi_status, mqtt_status, power_save;
         uint8_t smoke_alarm, air_alarm;
+        uint8_t display_off;
         char* state_string;
 				
 				// Watchdog Heartbeat Report
@@ -74,103 +159,86 @@ void StartDisplayTask(void const * argument)
             continue;
         }
 
+        display_off = 0;
+        TRACE(TRACE_MUTEX_WAIT, TRACE_MUTEX_OLED);
         if(osMutexWait(OledMutexHandle, 1000) == osOK)
         {
+            TRACE(TRACE_MUTEX_TAKEN, TRACE_MUTEX_OLED);
+						// alarm mode, checked first so a stale power save flag never hides it
+            if(smoke_alarm || air_alarm)
+            {
+                Display_Alarm(smoke_alarm, air_alarm);
+            }
 						// power save mode
-            if(power_save)
+            else if(power_save)
             {
                 OLED_Clear();
                 OLED_ShowString(20, 4, (uint8_t*)"Power Save Mode");
-                osDelay(2000);
-                OLED_Display_Off();
-            }
-						// alarm mode
-            else if(smoke_alarm || air_alarm)
-            {
-								OLED_Display_On();	
-								OLED_Clear();
-                if(smoke_alarm)
-                {
-                    OLED_ShowString(35, 2, (uint8_t*)"SMOKE ALARM!");
-                }
-                if(air_alarm)
-                {
-                    OLED_ShowString(40, 3, (uint8_t*)"AIR ALARM!");
-                }
+                OLED_Refresh();
+                display_off = 1;
             }
 						// normal mode
             else
             {
+                char value[16];
+
                 OLED_Display_On();
-                OLED_Clear_Line(0);
 								// Row 0 show temperature
-                OLED_ShowString(0, 0, (uint8_t*)"Temp:");
                 if(dht11_ok)
                 {
-                    OLED_ShowFloat(50, 0, temp, 2, 1);
-                    OLED_ShowChar(80, 0, 'C');
+                    snprintf(value, sizeof(value), "%4.1f C", temp);
+                    Display_Row(0, "Temp:", value);
                 }
                 else
                 {
-                    OLED_ShowString(50, 0, (uint8_t*)"-.-");
+                    Display_Row(0, "Temp:", "-.-");
                 }
 								// Row 1 show humidity
-                OLED_Clear_Line(1);
-                OLED_ShowString(0, 1, (uint8_t*)"Humi:");
                 if(dht11_ok)
                 {
-                    OLED_ShowFloat(50, 1, humi, 2, 1);
-                    OLED_ShowChar(80, 1, '%');
+                    snprintf(value, sizeof(value), "%4.1f %%", humi);
+                    Display_Row(1, "Humi:", value);
                 }
                 else
                 {
-                    OLED_ShowString(50, 1, (uint8_t*)"-.-%");
+                    Display_Row(1, "Humi:", "-.-%");
                 }
 								// Row 2 show smoke ppm
-                OLED_Clear_Line(2);
-                OLED_ShowString(0, 2, (uint8_t*)"Smoke:");
-                OLED_ShowNum(50, 2, (uint32_t)smoke_ppm, 4);
-                OLED_ShowString(80, 2, (uint8_t*)"ppm");
+                snprintf(value, sizeof(value), "%04lu ppm", (unsigned long)smoke_ppm);
+                Display_Row(2, "Smoke:", value);
 								// Row 3 show air ppm
-                OLED_Clear_Line(3);
-                OLED_ShowString(0, 3, (uint8_t*)"Air:");
-                OLED_ShowNum(50, 3, air_ppm, 4);
-                OLED_ShowString(80, 3, (uint8_t*)"ppm");
+                snprintf(value, sizeof(value), "%04u ppm", air_ppm);
+                Display_Row(3, "Air:", value);
 								// Row 4 show light lux
-                OLED_Clear_Line(4);
-                OLED_ShowString(0, 4, (uint8_t*)"Light:");
-                OLED_ShowNum(50, 4, light_lux, 4);
-                OLED_ShowString(80, 4, (uint8_t*)"lux");
+                snprintf(value, sizeof(value), "%04u lux", light_lux);
+                Display_Row(4, "Light:", value);
 								// Row 5 show WIFI state
-                OLED_Clear_Line(5);
-                OLED_ShowString(0, 5, (uint8_t*)"WiFi:");
-                if(wifi_status)
-                {
-                    OLED_ShowString(50, 5, (uint8_t*)"Connected");
-                } 
-								else
-                {
-                    OLED_ShowString(50, 5, (uint8_t*)"Disconnected");
-                }
+                Display_Row(5, "WiFi:", wifi_status ? "Connected" : "Disconnected");
 								// Row 6 show MQTT state
-                OLED_Clear_Line(6);
-                OLED_ShowString(0, 6, (uint8_t*)"MQTT:");
-                if(mqtt_status)
-                {
-                    OLED_ShowString(50, 6, (uint8_t*)"Connected");
-                }
-                else
-                {
-                    OLED_ShowString(50, 6, (uint8_t*)"Disconnected");
-                }
+                Display_Row(6, "MQTT:", mqtt_status ? "Connected" : "Disconnected");
 								// Row 7 show Network state
                 state_string = Network_GetStateString();
-                OLED_Clear_Line(7);
-                OLED_ShowString(0, 7, (uint8_t*)"STATE:");
-                OLED_ShowString(50, 7, (uint8_t*)state_string);
+                Display_Row(7, "STATE:", state_string);
             }
+            // only the pixels that changed since the last cycle go over I2C
+            OLED_Refresh();
             osMutexRelease(OledMutexHandle);
         }
-        osDelay(8000);
+
+        // Power save: keep the message up for 2s without holding the OLED mutex
+        if(display_off)
+        {
+            if(osSignalWait(DISPLAY_SIGNAL_ALARM, 2000).status == osEventSignal)
+            {
+                continue;
+            }
+            if(osMutexWait(OledMutexHandle, 1000) == osOK)
+            {
+                OLED_Display_Off();
+                osMutexRelease(OledMutexHandle);
+            }
+        }
+        // Sleep until the next refresh or until the sensor task raises an alarm edge
+        osSignalWait(DISPLAY_SIGNAL_ALARM, 8000);
     }
 }
@@ -2,6 +2,7 @@
 #include "tasks.h"
 #include "hardware.h"
 #include <stdio.h>
+#include <string.h>
 
 // WiFi configuration
 #define WIFI_SSID       "HXH"
@@ -18,6 +19,14 @@
 #define MQTT_TOPIC_DATA     "sensor/data"
 #define MQTT_TOPIC_STATUS   "sensor/status"
 #define MQTT_TOPIC_CONTROL  "sensor/control"
+#define MQTT_TOPIC_LINK     "sensor/link"
+#define MQTT_TOPIC_RTOS     "sensor/rtos"
+#define MQTT_TOPIC_WDT      "sensor/wdt"
+#define MQTT_TOPIC_OTA      "sensor/ota"
+
+// Link monitoring intervals
+#define LINK_CHECK_INTERVAL     20000   // AT+CWJAP? poll, also samples RSSI
+#define LINK_REPORT_INTERVAL    60000   // link statistics publish
 
 // Network state Define
 typedef enum {
@@ -31,10 +40,15 @@ typedef enum {
 
 static simple_state_t current_state = STATE_INIT;
 static uint32_t last_data_send = 0;
+static uint32_t last_link_report = 0;
 static uint32_t error_time = 0;
 
+static void Network_OnMessage(const char* topic, const char* data, uint16_t len);
+
 void StartMQTTTask(void const * argument)
 {
+    // Subscribed messages are dispatched from the ESP8266 receive ring
+    ESP8266_SetMessageHandler(Network_OnMessage);
     //Wait for system to be stable
     osDelay(7000);
 
@@ -44,8 +58,10 @@ void StartMQTTTask(void const * argument)
         // Watchdog Heartbeat Report
         Watchdog_Task_Heartbeat(TASK_ID_MQTT);
 
+        TRACE(TRACE_MUTEX_WAIT, TRACE_MUTEX_ESP8266);
         if(osMutexWait(ESP8266MutexHandle, 100) == osOK)
         {
+            TRACE(TRACE_MUTEX_TAKEN, TRACE_MUTEX_ESP8266);
             // Excute FSM
             switch(current_state)
             {
@@ -94,6 +110,9 @@ void StartMQTTTask(void const * argument)
                     g_mqtt_connected = 1;
                     // Subscribe Topic and send status notification
                     ESP8266_SubscribeMQTT(MQTT_TOPIC_CONTROL, 0);
+                    ESP8266_SubscribeMQTT(MQTT_TOPIC_OTA, 0);
+                    // Reaching the broker is what proves a freshly installed image
+                    OTA_ConfirmBoot();
                     Network_SendStatusInfo();
                     last_data_send = now;
                 }
@@ -111,8 +130,8 @@ void StartMQTTTask(void const * argument)
                 g_wifi_connected = 1;
                 g_mqtt_connected = 1;
 
-                // Send Interval Set, actually normal mode:10-12s, power save mode:20-22s
-                uint32_t send_interval = g_power_save_mode ? 18500 : 8500;
+                // Send Interval Set, normal mode:10s, power save mode:20s, paced by link quality
+                uint32_t send_interval = LinkQuality_PaceInterval(g_power_save_mode ? 20000 : 10000);
                 if(now - last_data_send >= send_interval)
                 {
                     // send data to server
@@ -122,11 +141,31 @@ void StartMQTTTask(void const * argument)
                     last_data_send = now;
                 }
 
+                // Publish link statistics every minute
+                if(now - last_link_report >= LINK_REPORT_INTERVAL)
+                {
+                    Network_SendLinkInfo();
+                    Network_SendRtosInfo();
+                    Watchdog_Take_Warnings();
+                    Network_SendWatchdogInfo();
+                    last_link_report = now;
+                }
+                // Early watchdog warnings go out immediately
+                else if(Watchdog_Take_Warnings())
+                {
+                    Network_SendWatchdogInfo();
+                }
+
+                // Messages queued in the receive ring since the last command
+                ESP8266_Process();
+
                 static uint32_t last_check = 0;
-                // Check WifI State every minute
-                if(now - last_check >= 60000)
+                // Check WifI State and sample RSSI
+                if(now - last_check >= LINK_CHECK_INTERVAL)
                 {
-                    if(ESP8266_GetWiFiStatus() != WIFI_CONNECTED)
+                    WiFi_Status_t wifi = ESP8266_GetWiFiStatus();
+                    LinkQuality_RecordRssi(ESP8266_GetRSSI());
+                    if(wifi != WIFI_CONNECTED)
                     {
                         current_state = STATE_WIFI_CONNECT;
                         error_time = now;
@@ -154,33 +193,46 @@ void StartMQTTTask(void const * argument)
                 break;
             }
             }
+            // USART2 stops with the clocks, STOP would drop pushed messages
+            LowPower_AllowStop(LP_STOP_LINK, current_state != STATE_RUNNING);
             osMutexRelease(ESP8266MutexHandle);
         }
         // osDelay
+        uint32_t delay_time;
         switch(current_state)
         {
         case STATE_INIT:
         case STATE_ESP_INIT:
-            osDelay(2000);
+            delay_time = 2000;
             break;
 
         case STATE_WIFI_CONNECT:
         case STATE_MQTT_CONNECT:
-            osDelay(3000);
+            delay_time = 3000;
             break;
 
         case STATE_RUNNING:
-            osDelay(5000);
+        {
+            // Wake up in time for the next paced publish, at most every 5s
+            uint32_t elapsed = HAL_GetTick() - last_data_send;
+            uint32_t interval = LinkQuality_PaceInterval(g_power_save_mode ? 20000 : 10000);
+            delay_time = (elapsed < interval) ? (interval - elapsed) : 0;
+            if(delay_time < 500) delay_time = 500;
+            if(delay_time > 5000) delay_time = 5000;
             break;
+        }
 
         case STATE_ERROR:
-            osDelay(10000);
+            delay_time = 10000;
             break;
 
         default:
-            osDelay(2000);
+            delay_time = 2000;
             break;
         }
+        // connect sequences block on AT timeouts, so keep the old 30s deadline
+        Watchdog_Task_Register(TASK_ID_MQTT, delay_time, 30000);
+        osDelay(delay_time);
     }
 }
 
@@ -195,8 +247,10 @@ void Network_SendSensorData(void)
     uint8_t smoke_alarm, air_alarm, device_alarm;
 
     // extract sensor data
+    TRACE(TRACE_MUTEX_WAIT, TRACE_MUTEX_SENSOR);
     if(osMutexWait(sensorDataMutexHandle, 300) == osOK)
     {
+        TRACE(TRACE_MUTEX_TAKEN, TRACE_MUTEX_SENSOR);
         temp = g_temperature;
         humi = g_humidity;
         smoke_ppm = g_smoke_ppm;
@@ -208,19 +262,78 @@ void Network_SendSensorData(void)
         device_alarm = smoke_alarm || air_alarm;
         osMutexRelease(sensorDataMutexHandle);
 
-        // Send data to server
-        ESP8266_SendSensorData(temp, humi, smoke_ppm, air_ppm, light_lux, device_alarm);
+        // Send data to server, publish-to-OK latency feeds link quality
+        uint32_t start = HAL_GetTick();
+        if(ESP8266_SendSensorData(temp, humi, smoke_ppm, air_ppm, light_lux, device_alarm) == ESP8266_OK)
+        {
+            LinkQuality_RecordRtt(HAL_GetTick() - start);
+            TRACE(TRACE_PUBLISH_DONE, 1);
+        }
+        else
+        {
+            LinkQuality_RecordFailure();
+            TRACE(TRACE_PUBLISH_DONE, 0);
+        }
     }
 }
 
+/**
+  * @brief Send RTOS CPU, stack and heap statistics
+  */
+void Network_SendRtosInfo(void)
+{
+    char rtos_msg[260];
+    RtosStats_Format(rtos_msg, sizeof(rtos_msg));
+    ESP8266_PublishMQTT(MQTT_TOPIC_RTOS, rtos_msg, 0, 0);
+}
+
+/**
+  * @brief Send per-task heartbeat lateness statistics
+  */
+void Network_SendWatchdogInfo(void)
+{
+    char wdt_msg[160];
+    Watchdog_Format(wdt_msg, sizeof(wdt_msg));
+    ESP8266_PublishMQTT(MQTT_TOPIC_WDT, wdt_msg, 0, 0);
+}
+
+/**
+  * @brief Subscribed message, called from inside the ESP8266 receive path
+  * @note  Must not send AT commands, OTA_Submit only hands the request over.
+  *        Payload: host,port,path,size,crc as printed by tools/ota_pack.py
+  */
+static void Network_OnMessage(const char* topic, const char* data, uint16_t len)
+{
+    OTA_Request_t req;
+
+    (void)len;
+    if(strcmp(topic, MQTT_TOPIC_OTA) == 0 && OTA_ParseRequest(data, &req))
+    {
+        OTA_Submit(&req);
+    }
+}
+
+/**
+  * @brief Send link quality statistics
+  */
+void Network_SendLinkInfo(void)
+{
+    char link_msg[200];
+    LinkQuality_Format(link_msg, sizeof(link_msg));
+    ESP8266_PublishMQTT(MQTT_TOPIC_LINK, link_msg, 0, 0);
+}
+
 /**
   * @brief Send status data
   */
 void Network_SendStatusInfo(void)
 {
-    char status_msg[100];
+    char status_msg[160];
+    uint32_t alarm_last, alarm_max, alarm_count;
     unsigned long uptime = HAL_GetTick() / 1000;
-    sprintf(status_msg, "AT+MQTTPUB=0,\"sensor/status\",\"Status:online_Device:%s_Updatetime:%lu\",0,0", MQTT_CLIENT_ID, uptime);
+    Display_GetAlarmLatency(&alarm_last, &alarm_max, &alarm_count);
+    sprintf(status_msg, "AT+MQTTPUB=0,\"sensor/status\",\"Status:online_Device:%s_AlarmLat:%lu_AlarmLatMax:%lu_Alarms:%lu_Updatetime:%lu\",0,0",
+            MQTT_CLIENT_ID, (unsigned long)alarm_last, (unsigned long)alarm_max, (unsigned long)alarm_count, uptime);
     ESP8266_SendCommandWithResponse(status_msg, 5000);
 }
 
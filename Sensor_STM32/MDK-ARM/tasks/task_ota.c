@@ -1,5 +1,24 @@
 #include "main.h"
 #include "tasks.h"
+#include "hardware.h"
+#include <stdio.h>
+
+#define MQTT_TOPIC_OTA_STATUS   "sensor/ota/status"
+
+static OTA_Request_t ota_request;
+static volatile uint8_t ota_busy = 0;
+
+/**
+  * @brief hand an update request to the OTA task, ignored while one runs
+  */
+void OTA_Submit(const OTA_Request_t* req)
+{
+    if(ota_busy || OTA_TaskHandle == NULL) return;
+
+    ota_request = *req;
+    ota_busy = 1;
+    osSignalSet(OTA_TaskHandle, OTA_SIGNAL_REQUEST);
+}
 
 /* USER CODE BEGIN Header_StartOTATask */
 /**
@@ -11,10 +30,49 @@
 void StartOTATask(void const * argument)
 {
     /* USER CODE BEGIN StartOTATask */
+    OTA_Stats_t stats;
+    OTA_Result_t result;
+    char ota_msg[160];
+
     /* Infinite loop */
     for(;;)
     {
-        osDelay(1);
+        osSignalWait(OTA_SIGNAL_REQUEST, osWaitForever);
+
+        // The MQTT task finishes its current AT exchange first
+        TRACE(TRACE_MUTEX_WAIT, TRACE_MUTEX_ESP8266);
+        if(osMutexWait(ESP8266MutexHandle, 10000) != osOK)
+        {
+            ota_busy = 0;
+            continue;
+        }
+        TRACE(TRACE_MUTEX_TAKEN, TRACE_MUTEX_ESP8266);
+
+        result = OTA_Download(&ota_request, &stats);
+
+        // Rate counts image bytes, Bytes is what crossed the link and was staged
+        snprintf(ota_msg, sizeof(ota_msg), "Result:%s_Mode:%s_Lz:%u_Bytes:%lu_Out:%lu_Time:%lu_Rate:%lu_Pages:%u_FlashWait:%lu_RingPeak:%u_Apply:%lu",
+                 OTA_ResultString(result),
+                 ota_request.dry_run ? "DRY" : (ota_request.patch_size ? "DELTA" : "FULL"),
+                 stats.compressed,
+                 (unsigned long)stats.bytes,
+                 (unsigned long)stats.image_bytes,
+                 (unsigned long)stats.elapsed_ms,
+                 (unsigned long)(stats.elapsed_ms ? (uint64_t)stats.image_bytes * 1000 / stats.elapsed_ms : 0),
+                 stats.pages,
+                 (unsigned long)stats.flash_wait_us,
+                 stats.ring_peak,
+                 (unsigned long)stats.apply_ms);
+        ESP8266_PublishMQTT(MQTT_TOPIC_OTA_STATUS, ota_msg, 0, 0);
+        osMutexRelease(ESP8266MutexHandle);
+
+        // Staging is verified and marked, the bootloader installs it
+        if(result == OTA_RESULT_OK && !ota_request.dry_run)
+        {
+            osDelay(200);
+            NVIC_SystemReset();
+        }
+        ota_busy = 0;
     }
     /* USER CODE END StartOTATask */
 }
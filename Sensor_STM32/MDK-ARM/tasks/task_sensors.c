@@ -31,6 +31,9 @@ uint32_t g_light_adc = 0;
 uint8_t g_light_level = 0;
 uint16_t g_light_lux = 0;
 
+// Tick of the latest alarm edge, cleared by the display task once drawn
+volatile uint32_t g_alarm_detect_tick = 0;
+
 // Global Error counters
 uint8_t g_dht11_error_count = 0;
 uint8_t g_mq2_error_count = 0;
@@ -39,8 +42,11 @@ uint8_t g_ldr_error_count = 0;
 
 void StartSensorTask(void const * argument)
 {
+    uint8_t last_alarm_bits = 0;
+
     // Sensor warm-up time
     osDelay(3000);
+    Watchdog_Task_Register(TASK_ID_SENSOR, 5000, 15000);
     for(;;)
     {
         // Temporary variables
@@ -54,6 +60,7 @@ void StartSensorTask(void const * argument)
 				
 				// Watchdog Heartbeat Report
         Watchdog_Task_Heartbeat(TASK_ID_SENSOR);
+        TRACE(TRACE_SENSOR_READ_START, 0);
         // Read DHT11 temperature and humidity data
         if(DHT11_Read_Data(&temp_temperature, &temp_humidity))
         {
@@ -150,9 +157,13 @@ void StartSensorTask(void const * argument)
             temp_light_lux = 0;
         }
 
+        TRACE(TRACE_SENSOR_READ_END, 0);
+
         // update all global variables
+        TRACE(TRACE_MUTEX_WAIT, TRACE_MUTEX_SENSOR);
         if(osMutexWait(sensorDataMutexHandle, 500) == osOK)
         {
+            TRACE(TRACE_MUTEX_TAKEN, TRACE_MUTEX_SENSOR);
             g_temperature = temp_temperature;
             g_humidity = temp_humidity;
             g_smoke_voltage = temp_smoke_voltage;
@@ -169,13 +180,29 @@ void StartSensorTask(void const * argument)
             g_light_level = temp_light_level;
             g_light_lux = temp_light_lux;
             osMutexRelease(sensorDataMutexHandle);
+
+            // Wake the display task on any alarm change instead of waiting for its refresh period
+            uint8_t alarm_bits = (temp_smoke_alarm ? 0x01 : 0) | (temp_air_quality_alarm ? 0x02 : 0);
+            if(alarm_bits != last_alarm_bits)
+            {
+                if(alarm_bits & ~last_alarm_bits)
+                {
+                    uint32_t tick = HAL_GetTick();
+                    g_alarm_detect_tick = tick ? tick : 1;
+                }
+                last_alarm_bits = alarm_bits;
+                osSignalSet(DisplayTaskHandle, DISPLAY_SIGNAL_ALARM);
+            }
         }
 
         // power-saving mode judgment
         uint8_t is_night = (g_light_lux < 100);
         uint8_t has_alarm = g_smoke_alarm || g_air_quality_alarm;
         g_power_save_mode = (is_night && !has_alarm) ? 1 : 0;  
+        // no STOP mode while alarmed, the alarm path must not wait for HSE/PLL restart
+        LowPower_AllowStop(LP_STOP_ALARM, !has_alarm);
         uint32_t delay_time = g_power_save_mode ? 10000 : 5000;  //Interval: normal mode 5s , power save mode 10s
+        Watchdog_Task_Register(TASK_ID_SENSOR, delay_time, delay_time + 10000);
         osDelay(delay_time);
     }
 }
@@ -31,6 +31,14 @@ void StartOTATask(void const * argument);
 
 extern uint8_t g_power_save_mode;
 
+// Display task signal raised by the sensor task on alarm edges
+#define DISPLAY_SIGNAL_ALARM    0x01
+extern volatile uint32_t g_alarm_detect_tick;
+void Display_GetAlarmLatency(uint32_t* last_ms, uint32_t* max_ms, uint32_t* count);
+
+// OTA task signal raised by OTA_Submit()
+#define OTA_SIGNAL_REQUEST      0x01
+
 extern uint8_t g_wifi_connected;
 extern uint8_t g_mqtt_connected;
 
@@ -69,6 +77,9 @@ typedef enum {
 void Network_HandleOperation(uint32_t current_time);
 void Network_SendSensorData(void);
 void Network_SendStatusInfo(void);
+void Network_SendLinkInfo(void);
+void Network_SendRtosInfo(void);
+void Network_SendWatchdogInfo(void);
 char* Network_GetStateString(void);
 void Network_SendAlarm(char* alarm_type, char* message);
 void Network_CheckSensorFaults(void);
@@ -0,0 +1,112 @@
+#include "hardware.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+#if TRACE_ENABLE
+
+// Ring size must be a power of two
+#define TRACE_RING_SIZE     128
+#define TRACE_RING_MASK     (TRACE_RING_SIZE - 1)
+
+typedef struct {
+    uint32_t cycles;            // DWT->CYCCNT at the event
+    uint8_t id;                 // Trace_Event_t
+    uint8_t task;               // FreeRTOS task number, TRACE_TASK_ISR/NONE outside a task
+    uint16_t arg;
+} Trace_Entry_t;
+
+#define TRACE_TASK_NONE     0       // before the scheduler starts
+#define TRACE_TASK_ISR      0xFF
+
+// 1KB ring, written from any task context with interrupts masked for a few cycles
+static Trace_Entry_t trace_ring[TRACE_RING_SIZE];
+static volatile uint32_t trace_seq = 0;        // total events ever recorded
+static volatile uint8_t trace_paused = 0;
+
+/**
+  * @brief record one event into the ring
+  * @note  Costs a handful of loads/stores with IRQs masked; the cycle counter
+  *        is enabled by configureTimerForRunTimeStats() at scheduler start
+  */
+void Trace_Record(uint8_t id, uint16_t arg)
+{
+    uint32_t primask;
+    Trace_Entry_t* entry;
+    uint8_t task;
+
+    // the same mutex can be waited on by several tasks, the decoder pairs on (task, arg)
+    if(__get_IPSR() != 0) {
+        task = TRACE_TASK_ISR;
+    } else {
+        TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+        task = handle ? (uint8_t)uxTaskGetTaskNumber(handle) : TRACE_TASK_NONE;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if(!trace_paused) {
+        entry = &trace_ring[trace_seq & TRACE_RING_MASK];
+        entry->cycles = DWT->CYCCNT;
+        entry->id = id;
+        entry->task = task;
+        entry->arg = arg;
+        trace_seq++;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief dump the ring as one binary frame on USART1
+  * @note  Frame: "TRCE", u32 seq, u32 core clock, u16 count, u16 reserved,
+  *        count * 8 byte entries oldest first (u32 cycles, u8 id, u8 task,
+  *        u16 arg), u8 sum of all preceding bytes.
+  *        Recording is paused while the frame is sent, decode with
+  *        tools/trace_decode.py
+  */
+void Trace_Dump(void)
+{
+    uint8_t header[16];
+    uint32_t seq, first, clock;
+    uint16_t count;
+    uint8_t sum = 0;
+    uint32_t primask;
+
+    trace_paused = 1;
+
+    seq = trace_seq;
+    count = (seq < TRACE_RING_SIZE) ? (uint16_t)seq : TRACE_RING_SIZE;
+    first = seq - count;
+    clock = SystemCoreClock;
+
+    memcpy(&header[0], "TRCE", 4);
+    memcpy(&header[4], &seq, 4);
+    memcpy(&header[8], &clock, 4);
+    memcpy(&header[12], &count, 2);
+    header[14] = 0;
+    header[15] = 0;
+
+    for(uint8_t i = 0; i < sizeof(header); i++) {
+        sum += header[i];
+    }
+    HAL_UART_Transmit(&huart1, header, sizeof(header), 100);
+
+    for(uint16_t i = 0; i < count; i++) {
+        uint8_t* raw = (uint8_t*)&trace_ring[(first + i) & TRACE_RING_MASK];
+        for(uint8_t j = 0; j < sizeof(Trace_Entry_t); j++) {
+            sum += raw[j];
+        }
+        HAL_UART_Transmit(&huart1, raw, sizeof(Trace_Entry_t), 100);
+    }
+    HAL_UART_Transmit(&huart1, &sum, 1, 100);
+
+    // start the next window empty so dumps never overlap, masked against ISR events
+    primask = __get_PRIMASK();
+    __disable_irq();
+    trace_seq = 0;
+    trace_paused = 0;
+    __set_PRIMASK(primask);
+}
+
+#endif /* TRACE_ENABLE */
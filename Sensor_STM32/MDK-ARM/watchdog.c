@@ -1,15 +1,26 @@
 #include "hardware.h"
 #include "main.h"
+#include "cmsis_os.h"
 #include <string.h>
 #include <stdio.h>
 
 extern UART_HandleTypeDef huart1;
 static IWDG_HandleTypeDef hiwdg;
 
+// Deadline used until a task registers its own
+#define WDT_DEFAULT_DEADLINE    30000
+
 typedef struct {
     uint32_t last_heartbeat;
     uint8_t is_alive;
     const char* name;
+    uint32_t period;            // expected heartbeat interval, 0 = not registered
+    uint32_t deadline;          // silence after which the task counts as dead
+    uint32_t beats;
+    uint8_t warned;             // early warning raised for the current silence
+    uint16_t warn_count;
+    uint16_t late_hist[WDT_LATE_BUCKETS];
+    uint32_t late_max;
 } TaskMonitor_t;
 
 static TaskMonitor_t tasks[MAX_TASKS] = {
@@ -19,8 +30,16 @@ static TaskMonitor_t tasks[MAX_TASKS] = {
     {0, 0, "Default"}
 };
 
+// Lateness bucket upper edges (ms), last bucket is open-ended
+static const uint16_t late_bucket_edges[WDT_LATE_BUCKETS - 1] = {
+    10, 50, 100, 500, 1000, 2000, 5000
+};
+
 static uint32_t system_start_time = 0;
 static uint8_t watchdog_enabled = 0;
+static uint32_t watchdog_timeout = 0;
+static uint8_t warn_log_mask = 0;       // warnings not yet printed on USART1
+static uint8_t warn_report_mask = 0;    // warnings not yet published over MQTT
 
 /**
  * @brief init watchdog
@@ -46,6 +65,7 @@ HAL_StatusTypeDef Watchdog_Init(uint32_t timeout_ms)
     }
 
     system_start_time = HAL_GetTick();
+    watchdog_timeout = timeout_ms;
     watchdog_enabled = 1;
 
     return HAL_OK;
@@ -59,11 +79,98 @@ void Watchdog_Feed(void)
     }
 }
 
+/**
+ * @brief register the expected heartbeat period and deadline of a task
+ * @note  Tasks with a variable loop time re-register before each sleep
+ */
+void Watchdog_Task_Register(uint8_t task_id, uint32_t period_ms, uint32_t deadline_ms)
+{
+    if(task_id < MAX_TASKS) {
+        tasks[task_id].period = period_ms;
+        tasks[task_id].deadline = deadline_ms;
+    }
+}
+
+/**
+ * @brief raise an early warning once per silence episode
+ */
+static void Watchdog_Raise_Warning(uint8_t task_id)
+{
+    taskENTER_CRITICAL();
+    if(!tasks[task_id].warned) {
+        tasks[task_id].warned = 1;
+        tasks[task_id].warn_count++;
+        warn_log_mask |= (1 << task_id);
+        warn_report_mask |= (1 << task_id);
+    }
+    taskEXIT_CRITICAL();
+}
+
+static uint8_t Watchdog_Late_Bucket(uint32_t late_ms)
+{
+    uint8_t i;
+    for(i = 0; i < WDT_LATE_BUCKETS - 1; i++) {
+        if(late_ms < late_bucket_edges[i]) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief lateness percentile from the histogram
+ * @retval upper edge of the bucket holding the percentile in ms
+ */
+static uint32_t Watchdog_Late_Percentile(TaskMonitor_t* task, uint8_t percent)
+{
+    uint32_t total = 0, seen = 0;
+
+    for(uint8_t i = 0; i < WDT_LATE_BUCKETS; i++) {
+        total += task->late_hist[i];
+    }
+    if(total == 0) return 0;
+
+    for(uint8_t i = 0; i < WDT_LATE_BUCKETS; i++) {
+        seen += task->late_hist[i];
+        if(seen * 100 >= total * percent) {
+            return (i < WDT_LATE_BUCKETS - 1) ? late_bucket_edges[i] : task->late_max;
+        }
+    }
+    return task->late_max;
+}
+
 void Watchdog_Task_Heartbeat(uint8_t task_id)
 {
     if(task_id < MAX_TASKS) {
-        tasks[task_id].last_heartbeat = HAL_GetTick();
-        tasks[task_id].is_alive = 1;
+        TaskMonitor_t* task = &tasks[task_id];
+        uint32_t now = HAL_GetTick();
+        uint32_t interval = now - task->last_heartbeat;
+
+        // lateness against the registered period, the first beat has no reference
+        if(task->period && task->beats) {
+            uint32_t late = (interval > task->period) ? (interval - task->period) : 0;
+            uint8_t bucket = Watchdog_Late_Bucket(late);
+
+            if(task->late_hist[bucket] == 0xFFFF) {
+                // halve the whole histogram so it keeps tracking recent behaviour
+                for(uint8_t i = 0; i < WDT_LATE_BUCKETS; i++) {
+                    task->late_hist[i] >>= 1;
+                }
+            }
+            task->late_hist[bucket]++;
+            if(late > task->late_max) {
+                task->late_max = late;
+            }
+            // came back, but only just before the deadline
+            if(interval >= task->deadline * 3 / 4) {
+                Watchdog_Raise_Warning(task_id);
+            }
+        }
+
+        task->beats++;
+        task->last_heartbeat = now;
+        task->is_alive = 1;
+        task->warned = 0;
     }
 }
 
@@ -82,16 +189,85 @@ uint8_t Watchdog_Check_All_Tasks(void)
 
     for(uint8_t i = 0; i < MAX_TASKS; i++) {
         uint32_t silence_time = current_time - tasks[i].last_heartbeat;
+        uint32_t deadline = tasks[i].deadline ? tasks[i].deadline : WDT_DEFAULT_DEADLINE;
 
-        if(silence_time > 30000) {
+        if(silence_time > deadline) {
+            // feeding stops here, the IWDG resets us watchdog_timeout ms later
             tasks[i].is_alive = 0;
             all_healthy = 0;
         }
+        else if(silence_time >= deadline * 3 / 4) {
+            Watchdog_Raise_Warning(i);
+        }
+    }
+
+    // print early warnings now, the MQTT task may be the one that is stuck
+    if(warn_log_mask) {
+        char line[96];
+        uint8_t mask;
+        int len;
+
+        taskENTER_CRITICAL();
+        mask = warn_log_mask;
+        warn_log_mask = 0;
+        taskEXIT_CRITICAL();
+
+        for(uint8_t i = 0; i < MAX_TASKS; i++) {
+            if(mask & (1 << i)) {
+                len = snprintf(line, sizeof(line),
+                               "[WDT] %s late: silent %lums, deadline %lums, IWDG %lums\r\n",
+                               tasks[i].name,
+                               (unsigned long)(current_time - tasks[i].last_heartbeat),
+                               (unsigned long)(tasks[i].deadline ? tasks[i].deadline : WDT_DEFAULT_DEADLINE),
+                               (unsigned long)watchdog_timeout);
+                HAL_UART_Transmit(&huart1, (uint8_t*)line, len, 100);
+            }
+        }
     }
 
     return all_healthy;
 }
 
+/**
+ * @brief fetch and clear the early warnings not yet published
+ * @retval bit mask of task ids
+ */
+uint8_t Watchdog_Take_Warnings(void)
+{
+    uint8_t mask;
+
+    taskENTER_CRITICAL();
+    mask = warn_report_mask;
+    warn_report_mask = 0;
+    taskEXIT_CRITICAL();
+
+    return mask;
+}
+
+/**
+ * @brief format per-task lateness statistics as an MQTT payload
+ * @note  Tasks are listed as name:p50:p99:max:warnings (ms), separated by '/'
+ */
+void Watchdog_Format(char* buffer, uint16_t size)
+{
+    int len;
+
+    if(!buffer || size == 0) return;
+
+    len = snprintf(buffer, size, "Uptime:%lu_Tasks:",
+                   (unsigned long)((HAL_GetTick() - system_start_time) / 1000));
+
+    for(uint8_t i = 0; i < MAX_TASKS && len > 0 && len < size; i++) {
+        len += snprintf(buffer + len, size - len, "%s%s:%lu:%lu:%lu:%u",
+                        i ? "/" : "",
+                        tasks[i].name,
+                        (unsigned long)Watchdog_Late_Percentile(&tasks[i], 50),
+                        (unsigned long)Watchdog_Late_Percentile(&tasks[i], 99),
+                        (unsigned long)tasks[i].late_max,
+                        tasks[i].warn_count);
+    }
+}
+
 void Watchdog_Get_Status(char* buffer, uint16_t size)
 {
     if(!buffer) return;
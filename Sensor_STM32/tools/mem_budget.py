@@ -0,0 +1,126 @@
+import re
+import sys
+
+# RAM budget report for the sensor node, built from the Keil linker map.
+#
+# usage: python mem_budget.py Demo/Demo.map [min_free_bytes]
+#
+# Runs as the "After Build" user command of Demo.uvprojx. Exits with 1 when
+# less than min_free_bytes (default 1024) of the 20 KB RAM is left unused.
+
+DEFAULT_MIN_FREE = 1024
+
+REGION = re.compile(r'Execution Region (RW_IRAM\d+) .*Size: (0x[0-9a-fA-F]+), Max: (0x[0-9a-fA-F]+)')
+SECTION = re.compile(r'^\s+0x2[0-9a-fA-F]+\s+(?:0x[0-9a-fA-F]+|-)\s+(0x[0-9a-fA-F]+)\s+(Data|Zero|PAD)\s*(?:RW\s+\d+\s+(\S+)\s+(\S+))?')
+SYMBOL = re.compile(r'^\s+(\w+)\s+0x2[0-9a-fA-F]+\s+Data\s+(\d+)\s+(\S+)\((\S+)\)')
+
+# Symbol name rules, checked first (subsystem, regex)
+SYMBOL_RULES = [
+    ('task stacks',      r'Stack$|^xIdleStack$'),
+    ('RTOS objects',     r'ControlBlock$|TCBBuffer$|^oled_dma_done_buf$'),
+    ('RTOS heap',        r'^ucHeap$'),
+    ('OLED framebuffer', r'^oled_fb$|^oled_dirty_'),
+    ('UART buffers',     r'^esp8266_buffer$|^esp_rx_ring$|^huart\d$'),
+    ('ring buffers',     r'^trace_ring$|^link$|^task_status$|^snapshot$'),
+    ('OTA buffers',      r'^ota_page$|^lz$'),
+]
+
+# Object file rules for everything not named above (subsystem, regex)
+OBJECT_RULES = [
+    ('main stack (MSP)', r'^startup_'),
+    ('RTOS kernel',      r'^(tasks|queue|list|port|timers|event_groups|cmsis_os|heap_\d|freertos)\.o$'),
+    ('ring buffers',     r'^(trace|link_quality|rtos_stats)\.o$'),
+    ('application',      r'^(main|task_\w+|watchdog|ota|ota_delta|ota_lz)\.o$'),
+    ('drivers',          r'^(adc|dht11|delay|esp8266|oled|spi|led|w25q64)\.o$'),
+    ('HAL / CMSIS',      r'^(stm32f1xx_\w+|system_stm32f1xx)\.o$'),
+]
+
+
+def classify(rules, name):
+    for subsystem, pattern in rules:
+        if re.search(pattern, name):
+            return subsystem
+    return None
+
+
+def parse_map(path):
+    region_size = region_max = 0
+    object_bytes = {}
+    padding = 0
+    symbols = []
+    in_region = False
+
+    with open(path, 'r', errors='replace') as f:
+        for line in f:
+            m = REGION.search(line)
+            if m:
+                in_region = True
+                region_size += int(m.group(2), 16)
+                region_max += int(m.group(3), 16)
+                continue
+            if 'Execution Region' in line or line.startswith('Image component sizes'):
+                in_region = False
+            if in_region:
+                m = SECTION.match(line)
+                if m:
+                    size = int(m.group(1), 16)
+                    if m.group(2) == 'PAD':
+                        padding += size
+                    else:
+                        obj = m.group(4)
+                        object_bytes[obj] = object_bytes.get(obj, 0) + size
+                continue
+            m = SYMBOL.match(line)
+            if m:
+                symbols.append((m.group(1), int(m.group(2)), m.group(3)))
+    return region_size, region_max, object_bytes, padding, symbols
+
+
+def build_budget(object_bytes, padding, symbols):
+    budget = {}
+    details = {}
+    remaining = dict(object_bytes)
+
+    for name, size, obj in symbols:
+        subsystem = classify(SYMBOL_RULES, name)
+        if subsystem is None or obj not in remaining:
+            continue
+        budget[subsystem] = budget.get(subsystem, 0) + size
+        details.setdefault(subsystem, []).append((size, name))
+        remaining[obj] -= size
+
+    for obj, size in remaining.items():
+        if size <= 0:
+            continue
+        subsystem = classify(OBJECT_RULES, obj) or 'other'
+        budget[subsystem] = budget.get(subsystem, 0) + size
+        details.setdefault(subsystem, []).append((size, obj))
+
+    if padding:
+        budget['padding'] = padding
+    return budget, details
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('usage: %s <Demo.map> [min_free_bytes]' % sys.argv[0])
+        sys.exit(2)
+    min_free = int(sys.argv[2]) if len(sys.argv) > 2 else DEFAULT_MIN_FREE
+
+    region_size, region_max, object_bytes, padding, symbols = parse_map(sys.argv[1])
+    if region_max == 0:
+        print('no RW_IRAM execution region found in %s' % sys.argv[1])
+        sys.exit(2)
+
+    budget, details = build_budget(object_bytes, padding, symbols)
+    print('RAM budget (%d of %d bytes)' % (region_size, region_max))
+    for subsystem, size in sorted(budget.items(), key=lambda item: -item[1]):
+        print('  %-18s %6d  %5.1f%%' % (subsystem, size, size * 100.0 / region_max))
+        for item_size, item in sorted(details.get(subsystem, []), reverse=True)[:4]:
+            print('      %-24s %6d' % (item, item_size))
+
+    free = region_max - region_size
+    print('  %-18s %6d  %5.1f%%' % ('free', free, free * 100.0 / region_max))
+    if free < min_free:
+        print('error: only %d bytes of RAM left, budget requires %d' % (free, min_free))
+        sys.exit(1)
@@ -0,0 +1,108 @@
+import functools
+import http.server
+import os
+import subprocess
+import sys
+import threading
+
+import ota_lz
+import ota_pack
+
+# Measure OTA download throughput on the sensor node, raw image against the
+# LZ compressed one.
+#
+# usage: python ota_bench.py Demo.bin <host> [port] [--broker addr] [--runs N]
+#
+# <host> is this machine as the node sees it. The image and its .hsz are
+# served from here, dry-run requests go out on sensor/ota and the node's own
+# timing comes back on sensor/ota/status. A dry run downloads, stages and
+# verifies the body but installs nothing, so the runs can repeat against
+# the image the node already runs. Needs mosquitto_pub and mosquitto_sub.
+
+STATUS_TOPIC = 'sensor/ota/status'
+STATUS_TIMEOUT = 120        # s, covers the MQTT task's 5s poll and a slow link
+DEFAULT_RUNS = 3
+
+
+def parse_status(text):
+    """Result:OK_Mode:DRY_Lz:1_Bytes:... into a dict of strings"""
+    fields = {}
+    for item in text.strip().split('_'):
+        key, _, value = item.partition(':')
+        fields[key] = value
+    return fields
+
+
+def run_once(broker, request):
+    sub = subprocess.Popen(['mosquitto_sub', '-h', broker, '-t', STATUS_TOPIC,
+                            '-C', '1', '-W', str(STATUS_TIMEOUT)],
+                           stdout=subprocess.PIPE, universal_newlines=True)
+    subprocess.check_call(['mosquitto_pub', '-h', broker, '-t', 'sensor/ota', '-m', request])
+    out, _ = sub.communicate()
+    if not out:
+        raise RuntimeError('no %s within %d s' % (STATUS_TOPIC, STATUS_TIMEOUT))
+    return parse_status(out)
+
+
+def median(values):
+    values = sorted(values)
+    return values[len(values) // 2]
+
+
+def serve_background(directory, port):
+    handler = functools.partial(http.server.SimpleHTTPRequestHandler, directory=directory)
+    server = http.server.HTTPServer(('', port), handler)
+    thread = threading.Thread(target=server.serve_forever)
+    thread.daemon = True
+    thread.start()
+    return server
+
+
+def option(args, name, default):
+    if name not in args:
+        return default
+    i = args.index(name)
+    value = args[i + 1]
+    del args[i:i + 2]
+    return value
+
+
+if __name__ == '__main__':
+    args = sys.argv[1:]
+    broker = option(args, '--broker', 'localhost')
+    runs = int(option(args, '--runs', DEFAULT_RUNS))
+    if len(args) < 2:
+        print('usage: %s <image.bin> <host> [port] [--broker addr] [--runs N]' % sys.argv[0])
+        sys.exit(2)
+    path, host = args[0], args[1]
+    port = int(args[2]) if len(args) > 2 else ota_pack.DEFAULT_PORT
+
+    with open(path, 'rb') as f:
+        image = f.read()
+    crc = ota_pack.stm32_crc(image)
+    lz_path = os.path.splitext(path)[0] + '.hsz'
+    ota_lz.build(path, lz_path)
+
+    server = serve_background(os.path.dirname(os.path.abspath(path)), port)
+    modes = [('raw', os.path.basename(path)), ('lz', os.path.basename(lz_path))]
+    results = dict((mode, []) for mode, _ in modes)
+    try:
+        print('%-4s %4s %8s %8s %7s %6s %10s %11s' %
+              ('body', 'run', 'link B', 'image B', 'time ms', 'pages', 'link B/s', 'image B/s'))
+        for run in range(runs):
+            for mode, name in modes:
+                # patch_size 0, dry_run 1
+                request = '%s,%d,/%s,%d,%08X,0,1' % (host, port, name, len(image), crc)
+                status = run_once(broker, request)
+                if status.get('Result') != 'OK':
+                    raise RuntimeError('%s download failed: %s' % (mode, status.get('Result')))
+                link, out, ms = int(status['Bytes']), int(status['Out']), int(status['Time'])
+                results[mode].append(out * 1000.0 / ms)
+                print('%-4s %4d %8d %8d %7d %6s %10.0f %11.0f' %
+                      (mode, run + 1, link, out, ms, status.get('Pages', '?'),
+                       link * 1000.0 / ms, out * 1000.0 / ms))
+    finally:
+        server.shutdown()
+
+    raw, lz = median(results['raw']), median(results['lz'])
+    print('median image throughput: raw %.0f B/s, lz %.0f B/s, %.2fx' % (raw, lz, lz / raw))
@@ -0,0 +1,149 @@
+import struct
+import sys
+
+from ota_pack import stm32_crc
+
+# Binary delta between two application images, applied on the node by
+# OTA_ApplyPatch() in MDK-ARM/ota_delta.c.
+#
+# usage: python ota_delta.py old.bin new.bin patch.dlt
+#
+# old.bin must be exactly the image running on the node, the patch carries
+# its CRC and the node refuses any other base.
+#
+# Format: "DLT1", u32 old_size, u32 old_crc, u32 new_size, then ops until
+# new_size bytes are produced. Each op starts with varint (len << 1 | type):
+#   type 0  ADD   len literal bytes follow
+#   type 1  COPY  zigzag varint seek from the end of the previous copy, then
+#                 len bytes from the old image
+
+MAGIC = b'DLT1'
+MIN_MATCH = 8           # shorter matches cost more than the literal bytes
+HASH_LEN = 4
+MAX_CANDIDATES = 48     # old positions tried per hash, newest first
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def match_length(old, old_pos, new, new_pos):
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    n = 0
+    # compare in blocks first, code images have long identical runs
+    while n + 64 <= limit and old[old_pos + n:old_pos + n + 64] == new[new_pos + n:new_pos + n + 64]:
+        n += 64
+    while n < limit and old[old_pos + n] == new[new_pos + n]:
+        n += 1
+    return n
+
+
+def make_patch(old, new):
+    index = {}
+    for i in range(len(old) - HASH_LEN + 1):
+        index.setdefault(old[i:i + HASH_LEN], []).append(i)
+
+    out = bytearray(MAGIC)
+    out += struct.pack('<III', len(old), stm32_crc(old), len(new))
+    literal = bytearray()
+    copied = 0
+    old_pos = 0
+    i = 0
+
+    def flush_literal():
+        if literal:
+            out.extend(varint(len(literal) << 1))
+            out.extend(literal)
+            del literal[:]
+
+    while i < len(new):
+        best_len, best_pos = 0, 0
+        if i + HASH_LEN <= len(new):
+            # continuing where the last copy ended needs no seek, try it first
+            candidates = [old_pos] + index.get(new[i:i + HASH_LEN], [])[-MAX_CANDIDATES:][::-1]
+            for pos in candidates:
+                if pos >= len(old):
+                    continue
+                n = match_length(old, pos, new, i)
+                if n > best_len:
+                    best_len, best_pos = n, pos
+        if best_len >= MIN_MATCH:
+            flush_literal()
+            out.extend(varint(best_len << 1 | 1))
+            out.extend(varint(zigzag(best_pos - old_pos)))
+            old_pos = best_pos + best_len
+            copied += best_len
+            i += best_len
+        else:
+            literal.append(new[i])
+            i += 1
+    flush_literal()
+    return bytes(out), copied
+
+
+def apply_patch(old, patch):
+    """Reference decoder, mirrors OTA_ApplyPatch()."""
+    magic, old_size, old_crc, new_size = struct.unpack_from('<4sIII', patch)
+    if magic != MAGIC or old_size != len(old) or old_crc != stm32_crc(old):
+        raise ValueError('patch does not match the base image')
+    pos = 16
+    old_pos = 0
+    new = bytearray()
+
+    def read_varint():
+        nonlocal pos
+        value = shift = 0
+        while True:
+            byte = patch[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    while len(new) < new_size:
+        control = read_varint()
+        length = control >> 1
+        if control & 1:
+            seek = read_varint()
+            old_pos += (seek >> 1) if not seek & 1 else -((seek + 1) >> 1)
+            new += old[old_pos:old_pos + length]
+            old_pos += length
+        else:
+            new += patch[pos:pos + length]
+            pos += length
+    return bytes(new)
+
+
+def build(old_path, new_path, patch_path):
+    with open(old_path, 'rb') as f:
+        old = f.read()
+    with open(new_path, 'rb') as f:
+        new = f.read()
+    patch, copied = make_patch(old, new)
+    if apply_patch(old, patch) != new:
+        raise RuntimeError('patch does not reproduce %s' % new_path)
+    with open(patch_path, 'wb') as f:
+        f.write(patch)
+    print('patch %s: %d bytes for a %d byte image (%.1fx smaller), %d bytes copied from the base'
+          % (patch_path, len(patch), len(new), len(new) / float(len(patch)), copied))
+    return patch
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 4:
+        print('usage: %s <old.bin> <new.bin> <patch.dlt>' % sys.argv[0])
+        sys.exit(2)
+    build(sys.argv[1], sys.argv[2], sys.argv[3])
@@ -0,0 +1,144 @@
+import struct
+import sys
+
+# LZSS compression for OTA images. The node stages the compressed body as it
+# arrives and Bootloader_Expand() in Bootloader/bootloader.c expands it into
+# internal flash at install, so the W25Q64 takes fewer page programs too.
+#
+# usage: python ota_lz.py <in.bin|in.dlt> <out.hsz>
+#
+# Format (heatshrink style): "HSZ1", u8 window_bits, u8 lookahead_bits,
+# u16 reserved, u32 raw_size, then a MSB-first bitstream of
+#   1 + 8 bits                          literal
+#   0 + window_bits + lookahead_bits    distance - 1, length - 1
+# The window starts out zero filled on both sides.
+# window_bits must not exceed OTA_LZ_WINDOW_BITS in Hardware/ota_layout.h.
+
+MAGIC = b'HSZ1'
+WINDOW_BITS = 12        # OTA_LZ_WINDOW_BITS, 4KB in the bootloader
+LOOKAHEAD_BITS = 4      # 16 byte matches pack Thumb code best with this window
+MAX_CANDIDATES = 64
+PAGE_SIZE = 256         # W25Q64 page program
+
+
+class BitWriter(object):
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.count = 0
+
+    def put(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.count += bits
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.acc >> self.count) & 0xFF)
+        self.acc &= (1 << self.count) - 1
+
+    def finish(self):
+        if self.count:
+            self.out.append((self.acc << (8 - self.count)) & 0xFF)
+            self.count = 0
+        return bytes(self.out)
+
+
+def compress(data, window_bits=WINDOW_BITS, lookahead_bits=LOOKAHEAD_BITS):
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    # a reference costs 1 + window_bits + lookahead_bits, a literal 9 bits
+    min_len = (1 + window_bits + lookahead_bits) // 9 + 1
+    # the zero filled window is addressable as if it preceded the data
+    buf = bytes(window) + data
+    start = window
+    chains = {}
+    for i in range(start - 2, start):
+        chains.setdefault(buf[i:i + 3], []).append(i)
+
+    bits = BitWriter()
+    i = start
+    while i < len(buf):
+        best_len, best_dist = 0, 0
+        limit = min(max_len, len(buf) - i)
+        if limit >= min_len:
+            for pos in reversed(chains.get(buf[i:i + 3], [])[-MAX_CANDIDATES:]):
+                dist = i - pos
+                if dist > window:
+                    break
+                n = 0
+                # the match may overlap the bytes being produced, like the decoder
+                while n < limit and buf[pos + n] == buf[i + n]:
+                    n += 1
+                if n > best_len:
+                    best_len, best_dist = n, dist
+                    if n == limit:
+                        break
+        step = best_len if best_len >= min_len else 1
+        if step == 1:
+            bits.put(1, 1)
+            bits.put(buf[i], 8)
+        else:
+            bits.put(0, 1)
+            bits.put(best_dist - 1, window_bits)
+            bits.put(best_len - 1, lookahead_bits)
+        for k in range(i, i + step):
+            chains.setdefault(buf[k:k + 3], []).append(k)
+        i += step
+
+    header = MAGIC + struct.pack('<BBHI', window_bits, lookahead_bits, 0, len(data))
+    return header + bits.finish()
+
+
+def decompress(blob):
+    """Reference decoder, mirrors Bootloader_Expand()."""
+    magic, window_bits, lookahead_bits, _, raw_size = struct.unpack_from('<4sBBHI', blob)
+    if magic != MAGIC:
+        raise ValueError('not a compressed stream')
+    window = 1 << window_bits
+    out = bytearray(window)
+    acc = count = 0
+    pos = 12
+
+    def take(n):
+        nonlocal acc, count, pos
+        while count < n:
+            acc = (acc << 8) | blob[pos]
+            pos += 1
+            count += 8
+        count -= n
+        return (acc >> count) & ((1 << n) - 1)
+
+    while len(out) - window < raw_size:
+        if take(1):
+            out.append(take(8))
+        else:
+            dist = take(window_bits) + 1
+            length = take(lookahead_bits) + 1
+            for _ in range(length):
+                out.append(out[-dist])
+    return bytes(out[window:window + raw_size])
+
+
+def pages(size):
+    return (size + PAGE_SIZE - 1) // PAGE_SIZE
+
+
+def build(in_path, out_path):
+    with open(in_path, 'rb') as f:
+        data = f.read()
+    blob = compress(data)
+    if decompress(blob) != data:
+        raise RuntimeError('compressed stream does not reproduce %s' % in_path)
+    with open(out_path, 'wb') as f:
+        f.write(blob)
+    print('compressed %s: %d -> %d bytes (%.1f%%), %d byte window'
+          % (out_path, len(data), len(blob), 100.0 * len(blob) / len(data), 1 << WINDOW_BITS))
+    print('  staging takes %d page programs instead of %d, measure the download with ota_bench.py'
+          % (pages(len(blob)), pages(len(data))))
+    return blob
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        print('usage: %s <in.bin> <out.hsz>' % sys.argv[0])
+        sys.exit(2)
+    build(sys.argv[1], sys.argv[2])
@@ -0,0 +1,109 @@
+import os
+import struct
+import sys
+
+# Prepare an application image for the sensor node OTA download (MDK-ARM/ota.c)
+# and print the request to publish on the sensor/ota topic.
+#
+# usage: python ota_pack.py Demo.bin <host> [port] [--serve] [--base old.bin] [--compress]
+#
+# Demo.bin comes from the Keil output, e.g.
+#   fromelf --bin --output Demo.bin Demo\Demo.axf
+# --serve shares the image's directory over HTTP until Ctrl+C.
+# --base builds a delta patch (Demo.dlt) against the image the node runs,
+# see ota_delta.py.
+# --compress serves the image LZ compressed as .hsz, see ota_lz.py. The node
+# stages it as received and the bootloader expands it at install, so the
+# request sizes stay those of the image. With the 4KB window a firmware image
+# shrinks by about 17%; an image that does not shrink is served raw. A delta
+# patch is applied by the application and is always served raw.
+# ota_bench.py measures the download of both forms on the node.
+
+APP_MAX_SIZE = 0xE000       # OTA_APP_MAX_SIZE in Hardware/ota_layout.h
+DEFAULT_PORT = 8000
+
+
+def stm32_crc(data):
+    """CRC-32 as computed by the STM32F1 CRC unit: poly 0x04C11DB7, init
+    0xFFFFFFFF, 32-bit little-endian words fed MSB first, no reflection.
+    The image is padded to whole words with 0xFF like the firmware does."""
+    if len(data) % 4:
+        data += b'\xff' * (4 - len(data) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack('<I', data):
+        crc ^= word
+        for _ in range(32):
+            if crc & 0x80000000:
+                crc = ((crc << 1) ^ 0x04C11DB7) & 0xFFFFFFFF
+            else:
+                crc = (crc << 1) & 0xFFFFFFFF
+    return crc
+
+
+def serve(directory, port):
+    import http.server
+    import functools
+
+    handler = functools.partial(http.server.SimpleHTTPRequestHandler, directory=directory)
+    server = http.server.HTTPServer(('', port), handler)
+    print('serving %s on port %d, Ctrl+C to stop' % (directory, port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        server.server_close()
+
+
+if __name__ == '__main__':
+    args = [a for a in sys.argv[1:] if a not in ('--serve', '--compress')]
+    base = None
+    if '--base' in args:
+        i = args.index('--base')
+        base = args[i + 1] if i + 1 < len(args) else None
+        del args[i:i + 2]
+    if len(args) < 2 or ('--base' in sys.argv and base is None):
+        print('usage: %s <image.bin> <host> [port] [--serve] [--base old.bin] [--compress]' % sys.argv[0])
+        sys.exit(2)
+    path, host = args[0], args[1]
+    port = int(args[2]) if len(args) > 2 else DEFAULT_PORT
+
+    with open(path, 'rb') as f:
+        image = f.read()
+    if not image or len(image) > APP_MAX_SIZE:
+        print('error: image is %d bytes, must be 1..%d' % (len(image), APP_MAX_SIZE))
+        sys.exit(1)
+
+    # the reset vector must point into the application area, not the bootloader
+    sp, entry = struct.unpack_from('<II', image)
+    if not 0x08002000 <= entry < 0x08002000 + APP_MAX_SIZE:
+        print('error: reset vector 0x%08X, image not linked at 0x08002000' % entry)
+        sys.exit(1)
+
+    crc = stm32_crc(image)
+    request = '%s,%d,/%s,%d,%08X' % (host, port, os.path.basename(path), len(image), crc)
+    print('image %s: %d bytes, crc 0x%08X' % (path, len(image), crc))
+    body_path = path
+    if base:
+        import ota_delta
+        body_path = os.path.splitext(path)[0] + '.dlt'
+        patch = ota_delta.build(base, path, body_path)
+        # the node downloads the patch and rebuilds the image described by size/crc
+        request = '%s,%d,/%s,%d,%08X,%d' % (host, port, os.path.basename(body_path),
+                                            len(image), crc, len(patch))
+    if '--compress' in sys.argv and base:
+        print('a delta patch is applied by the application, serving it raw')
+    elif '--compress' in sys.argv:
+        import ota_lz
+        lz_path = os.path.splitext(body_path)[0] + '.hsz'
+        blob = ota_lz.build(body_path, lz_path)
+        raw_size = os.path.getsize(body_path)
+        if len(blob) < raw_size:
+            request = request.replace('/' + os.path.basename(body_path), '/' + os.path.basename(lz_path), 1)
+        else:
+            # the node tells raw from compressed by the first bytes, the raw body needs nothing else
+            os.remove(lz_path)
+            print('compression saves nothing (%d -> %d bytes), serving the raw body' % (raw_size, len(blob)))
+    print('publish on sensor/ota:')
+    print('  mosquitto_pub -t sensor/ota -m "%s"' % request)
+
+    if '--serve' in sys.argv:
+        serve(os.path.dirname(os.path.abspath(path)), port)
@@ -0,0 +1,136 @@
+import struct
+import sys
+
+# Decode "TRCE" frames dumped by Trace_Dump() on USART1 and print
+# per-stage latency histograms. The trace is off by default for RAM, build
+# with TRACE_ENABLE=1 added to the Demo target's C/C++ defines to capture.
+#
+# usage: python trace_decode.py capture.bin
+#        python trace_decode.py COM5        (needs pyserial, Ctrl+C to stop)
+
+MAGIC = b'TRCE'
+HEADER = struct.Struct('<4sIIHH')
+ENTRY = struct.Struct('<IBBH')
+
+# Keep in sync with Trace_Event_t in Hardware/hardware.h
+SENSOR_READ_START = 1
+SENSOR_READ_END = 2
+MUTEX_WAIT = 3
+MUTEX_TAKEN = 4
+AT_SEND = 5
+AT_RESULT = 6
+PUBLISH_DONE = 7
+DISPLAY_FLUSH_START = 8
+DISPLAY_FLUSH_END = 9
+
+MUTEX_NAMES = {0: 'sensorData', 1: 'ESP8266', 2: 'Oled'}
+
+# Histogram bucket upper edges in microseconds, last bucket is open-ended
+BUCKETS_US = [10, 100, 1000, 10000, 100000, 1000000, 10000000]
+
+
+def parse_frames(data):
+    frames = []
+    pos = data.find(MAGIC)
+    while pos >= 0 and pos + HEADER.size <= len(data):
+        _, seq, clock, count, _ = HEADER.unpack_from(data, pos)
+        end = pos + HEADER.size + count * ENTRY.size
+        if end + 1 > len(data):
+            break
+        if sum(data[pos:end]) & 0xFF != data[end]:
+            print('frame at offset %d: bad checksum, skipped' % pos)
+            pos = data.find(MAGIC, pos + 1)
+            continue
+        entries = [ENTRY.unpack_from(data, pos + HEADER.size + i * ENTRY.size)
+                   for i in range(count)]
+        if seq > count:
+            print('frame at offset %d: %d events overwritten' % (pos, seq - count))
+        frames.append((clock, entries))
+        pos = data.find(MAGIC, end + 1)
+    return frames
+
+
+def collect(frames):
+    stages = {}
+
+    def add(name, start, end, clock):
+        us = ((end - start) & 0xFFFFFFFF) * 1000000 // clock
+        stages.setdefault(name, []).append(us)
+
+    for clock, entries in frames:
+        read_start = None
+        last_sample = None
+        at_send = None
+        flush_start = None
+        mutex_wait = {}
+        for cycles, ev, task, arg in entries:
+            if ev == SENSOR_READ_START:
+                read_start = cycles
+            elif ev == SENSOR_READ_END and read_start is not None:
+                add('sensor read', read_start, cycles, clock)
+                last_sample = read_start
+                read_start = None
+            elif ev == MUTEX_WAIT:
+                # several tasks may wait on one mutex, pair per task
+                mutex_wait[(task, arg)] = cycles
+            elif ev == MUTEX_TAKEN and (task, arg) in mutex_wait:
+                name = 'mutex %s wait' % MUTEX_NAMES.get(arg, arg)
+                add(name, mutex_wait.pop((task, arg)), cycles, clock)
+            elif ev == AT_SEND:
+                at_send = cycles
+            elif ev == AT_RESULT and at_send is not None:
+                add('AT command', at_send, cycles, clock)
+                at_send = None
+            elif ev == PUBLISH_DONE and arg and last_sample is not None:
+                add('sample to publish OK', last_sample, cycles, clock)
+            elif ev == DISPLAY_FLUSH_START:
+                flush_start = cycles
+            elif ev == DISPLAY_FLUSH_END and flush_start is not None:
+                add('display flush', flush_start, cycles, clock)
+                flush_start = None
+    return stages
+
+
+def print_histogram(name, samples):
+    samples.sort()
+    count = len(samples)
+    p50 = samples[count // 2]
+    p99 = samples[min(count - 1, count * 99 // 100)]
+    print('%s: n=%d p50=%dus p99=%dus max=%dus' % (name, count, p50, p99, samples[-1]))
+    hist = [0] * (len(BUCKETS_US) + 1)
+    for us in samples:
+        i = 0
+        while i < len(BUCKETS_US) and us >= BUCKETS_US[i]:
+            i += 1
+        hist[i] += 1
+    labels = ['<%dus' % edge for edge in BUCKETS_US] + ['>=%dus' % BUCKETS_US[-1]]
+    for label, n in zip(labels, hist):
+        if n:
+            print('  %10s %5d %s' % (label, n, '#' * (n * 40 // count or 1)))
+
+
+def read_input(source):
+    try:
+        with open(source, 'rb') as f:
+            return f.read()
+    except (IOError, OSError):
+        import serial
+        data = bytearray()
+        port = serial.Serial(source, 115200, timeout=1)
+        try:
+            while True:
+                data += port.read(1024)
+        except KeyboardInterrupt:
+            port.close()
+        return bytes(data)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        print('usage: %s <capture file | serial port>' % sys.argv[0])
+        sys.exit(1)
+    frames = parse_frames(read_input(sys.argv[1]))
+    print('%d trace frames' % len(frames))
+    stages = collect(frames)
+    for name in sorted(stages):
+        print_histogram(name, stages[name])
@@ -1,184 +1,64 @@
 #include "main.h"
-#include <string.h>
-#include <stdio.h>
+#include "cmsis_os.h"
 #include "hardware.h"
+#include "tasks.h"
 
-// WiFi Configure
-#define WIFI_SSID       "HXH"
-#define WIFI_PASSWORD   "Hxh20010523"
+// Task and Queue Definition
+osThreadId ModemTaskHandle;
+osThreadId ActuatorTaskHandle;
+osThreadId SupervisorTaskHandle;
+osMailQId ActuatorQueueHandle;
 
-// MQTT Configure
-#define MQTT_SERVER     "192.168.137.34"
-#define MQTT_PORT       1883
-#define MQTT_CLIENT_ID  "STM32_Controller_001"
-#define MQTT_USERNAME   ""
-#define MQTT_PASSWORD   ""
-#define MQTT_PUB_TOPIC   "sensor/status"
-#define MQTT_SUB_TOPIC   "sensor/control"
-
-/* BUZZER Configure */
-#define BUZZER_Pin       GPIO_PIN_1
-#define BUZZER_GPIO_Port GPIOA
-
-/* Reconnect time configure */
-#define WIFI_RECONNECT_DELAY_MS    5000
-#define MQTT_RECONNECT_DELAY_MS    5000
-
-uint32_t last_wifi_reconnect = 0;
-uint32_t last_mqtt_reconnect = 0;
-
-/**
- * \brief    BUZZER SET FUNCTION
- */
-void Buzzer_On(void)
-{
-    HAL_GPIO_WritePin(BUZZER_GPIO_Port, BUZZER_Pin, GPIO_PIN_SET);
-}
-
-void Buzzer_Off(void)
-{
-    HAL_GPIO_WritePin(BUZZER_GPIO_Port, BUZZER_Pin, GPIO_PIN_RESET);
-}
-
-/**
- * \brief    BUZZER BEEP FUNCTION
- */
-void Buzzer_Beep(uint16_t duration_ms)
-{
-    Buzzer_On();
-    HAL_Delay(duration_ms);
-    Buzzer_Off();
-}
-
-/**
- * \brief   Extract Control value from MQTT Info
- */
-int extract_control_value(const char* buffer)
+int main(void)
 {
-    // mqtt post format: +MQTTSUBRECV:0,"sensor/control",1,0 or 1
-    char* mqttrecv_pos = strstr(buffer, "+MQTTSUBRECV:");
-    if (mqttrecv_pos == NULL) {
-        return -1;
-    }
+    // Hardware Init
+    HAL_Init();
+    SystemClock_Config();
+    Hardware_Init();
 
-    // find last comma
-    char* last_comma = strrchr(mqttrecv_pos, ',');
-    if (last_comma == NULL) {
-        return -1;
-    }
+    // DWT cycle counter times the actuator commands
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 
-    // read control value
-    char* value_str = last_comma + 1;
+    /* Create the queue(s) */
+    /* definition and creation of ActuatorQueue */
+    osMailQDef(ActuatorQueue, ACTUATOR_QUEUE_LEN, Actuator_Command_t);
+    ActuatorQueueHandle = osMailCreate(osMailQ(ActuatorQueue), NULL);
 
-    // extract command
-    if (*value_str == '0') {
-        return 0;
-    } else if (*value_str == '1') {
-        return 1;
-    }
+    /* Create the thread(s) */
+    /* definition and creation of ActuatorTask, never waits behind the network */
+    osThreadDef(ActuatorTask, StartActuatorTask, osPriorityHigh, 0, 128);
+    ActuatorTaskHandle = osThreadCreate(osThread(ActuatorTask), NULL);
 
-    return -1;
-}
+    /* definition and creation of SupervisorTask */
+    osThreadDef(SupervisorTask, StartSupervisorTask, osPriorityAboveNormal, 0, 128);
+    SupervisorTaskHandle = osThreadCreate(osThread(SupervisorTask), NULL);
 
-/**
- * \brief    MQTT Info Check
- */
-void check_mqtt_messages(void)
-{
-    char* buffer = ESP8266_GetBuffer();
+    /* definition and creation of ModemTask */
+    osThreadDef(ModemTask, StartModemTask, osPriorityNormal, 0, 512);
+    ModemTaskHandle = osThreadCreate(osThread(ModemTask), NULL);
 
-    // Check if there is data in the buffer
-    if (buffer == NULL || strlen(buffer) == 0) {
-        return;
-    }
+    /* Start scheduler */
+    osKernelStart();
+    while (1)
+    {
 
-    // Check if MQTT subscription messages are received
-    if (strstr(buffer, "+MQTTSUBRECV:") != NULL) {
-        // Check if MQTT topic "sensor/control" messages are received
-        if (strstr(buffer, "sensor/control") != NULL) {
-            int control_value = extract_control_value(buffer);
-            // execute command
-            if (control_value == 0) {
-                Buzzer_Off();
-                ESP8266_PublishMQTT(MQTT_PUB_TOPIC, "received", 0, 0);
-            }
-            else if (control_value == 1) {
-                Buzzer_On();
-                ESP8266_PublishMQTT(MQTT_PUB_TOPIC, "received", 0, 0);
-            }
-        }
-        // clean esp8266 buffer
-        ESP8266_ClearBuffer();
-    }
-    else {
-        // Clean buffer if non-MQTT data exceeds threshold to prevent accumulation
-        if (strlen(buffer) > 100) {
-            ESP8266_ClearBuffer();
-        }
     }
 }
 
-int main(void)
+/**
+  * @brief  Period elapsed callback, TIM1 is the HAL time base,
+  *         TIM4 (motor PWM) steps the actuator patterns
+  * @param  htim : TIM handle
+  * @retval None
+  */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
-    // Hardware Init
-    HAL_Init();
-    SystemClock_Config();
-    Hardware_Init();
-
-    //ESP8266 Init
-    if (ESP8266_Init() != ESP8266_OK) {
-        while (1);
+    if (htim->Instance == TIM1) {
+        HAL_IncTick();
     }
-
-    //ESP8266 Connect WiFi
-    if (ESP8266_ConnectWiFi(WIFI_SSID, WIFI_PASSWORD) == ESP8266_OK) {
-        Buzzer_Beep(300);
-    }
-
-    while (1)
-    {
-        uint32_t now = HAL_GetTick();
-
-        // WiFi state detect and reconnect
-        if (ESP8266_GetWiFiStatus() != WIFI_CONNECTED)
-        {
-            if (now - last_wifi_reconnect > WIFI_RECONNECT_DELAY_MS)
-            {
-                if (ESP8266_ConnectWiFi(WIFI_SSID, WIFI_PASSWORD) == ESP8266_OK)
-                {
-                    Buzzer_Beep(200);
-                }
-                last_wifi_reconnect = now;
-            }
-        }
-        else
-        {
-            // MQTT state detect and reconnect
-            if (ESP8266_GetMQTTStatus() != MQTT_CONNECTED)
-            {
-                if (now - last_mqtt_reconnect > MQTT_RECONNECT_DELAY_MS)
-                {
-                    if (ESP8266_ConnectMQTT(MQTT_SERVER, MQTT_PORT, MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD) == ESP8266_OK)
-                    {
-                        ESP8266_SubscribeMQTT(MQTT_SUB_TOPIC, 0);
-                        Buzzer_Beep(200);
-                    }
-                    last_mqtt_reconnect = now;
-                }
-            }
-            else
-            {
-                // wait for control command
-                check_mqtt_messages();
-                // every 15s publish online status
-                static uint32_t last_publish = 0;
-                if (now - last_publish > 15000)
-                {
-                    ESP8266_PublishMQTT(MQTT_PUB_TOPIC, "Status:Online_Device:STM32_Controller_001", 0, 0);
-                    last_publish = now;
-                }
-            }
-        }
-        HAL_Delay(50);
+    else if (htim->Instance == TIM4) {
+        Pattern_Tick();
     }
 }
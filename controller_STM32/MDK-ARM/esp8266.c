@@ -1,13 +1,16 @@
 /**
- * ESP8266 Driver for STM32 Bare Metal
+ * ESP8266 Driver for STM32 (FreeRTOS)
  * Based on ESP_AT_LIB official library
  * Optimized for Ai-Thinker AT Firmware 1471
+ * Only the modem task may call into the driver.
  */
 
 #include "main.h"
+#include "cmsis_os.h"
 #include "hardware.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
 /* Configuration */
@@ -20,6 +23,11 @@
 /* Buffer configuration */
 #define ESP_RX_BUFFER_SIZE          512
 #define ESP_AT_BUFFER_SIZE          256
+#define ESP_RX_RING_SIZE            512             /* power of two */
+#define ESP_RX_RING_MASK            (ESP_RX_RING_SIZE - 1)
+#define ESP_LINE_SIZE               256
+#define ESP_RX_STAMP_SLOTS          8               /* power of two */
+#define ESP_RX_STAMP_MASK           (ESP_RX_STAMP_SLOTS - 1)
 
 /* Timeouts */
 #define ESP_TIMEOUT_RESET           3000
@@ -35,6 +43,11 @@
 #define ESP_AT_CMD_WIFI_GOT_IP      "WIFI GOT IP"
 #define ESP_AT_CMD_MQTTCONNECTED    "MQTTCONNECTED"
 
+/* Unsolicited result codes */
+#define ESP_URC_MQTTSUBRECV         "+MQTTSUBRECV:"
+#define ESP_URC_MQTTDISCONNECTED    "+MQTTDISCONNECTED"
+#define ESP_URC_WIFI_DISCONNECT     "WIFI DISCONNECT"
+
 /* Internal buffers */
 static char esp_rx_buffer[ESP_RX_BUFFER_SIZE];
 static char esp_at_buffer[ESP_AT_BUFFER_SIZE];
@@ -50,6 +63,32 @@ static esp_state_t esp_state = ESP_STATE_IDLE;
 static WiFi_Status_t wifi_status = WIFI_DISCONNECTED;
 static MQTT_Status_t mqtt_status = MQTT_DISCONNECTED;
 
+/* Receive ring, filled from the USART2 RXNE interrupt */
+static uint8_t esp_rx_ring[ESP_RX_RING_SIZE];
+static volatile uint16_t esp_rx_head = 0;
+static volatile uint16_t esp_rx_tail = 0;
+static volatile uint32_t esp_rx_dropped = 0;   /* ring full or USART overrun */
+
+/* DWT cycle count at each line end still in the ring, with the ring index
+ * of its '\n': lines that arrived with the slots full have no stamp, and
+ * the index keeps them from taking the stamp of a later line */
+typedef struct {
+    uint32_t cycles;
+    uint16_t pos;
+} esp_rx_stamp_t;
+
+static esp_rx_stamp_t esp_rx_stamps[ESP_RX_STAMP_SLOTS];
+static volatile uint8_t esp_rx_stamp_head = 0;
+static volatile uint8_t esp_rx_stamp_tail = 0;
+static uint32_t esp_line_stamp = 0;
+
+/* Line assembly, complete lines are URCs or part of a command response */
+static char esp_line[ESP_LINE_SIZE];
+static uint16_t esp_line_len = 0;
+static size_t esp_rx_len = 0;
+
+static ESP8266_MessageHandler_t esp_msg_handler = NULL;
+
 /* Debug function */
 void debug_printf(const char* format, ...)
 {
@@ -88,43 +127,190 @@ static ESP8266_Status_t esp_ll_send(const void* data, size_t len)
 }
 
 /**
- * \brief           Hardware reset ESP device
+ * \brief           USART2 interrupt hook, queues received bytes in the ring
+ * \return          1 when the interrupt was a receive and is handled
+ * \note            Called first thing in USART2_IRQHandler, transmit still
+ *                  goes through the HAL
  */
-static void esp_ll_reset(void)
+uint8_t ESP8266_UART_IRQHandler(void)
 {
-		// Pull the pin down and then pull it up for reset	
-		// debug_printf("[ESP] Hardware reset...\r\n");
-    HAL_GPIO_WritePin(ESP_RESET_PORT, ESP_RESET_PIN, GPIO_PIN_RESET);
-    HAL_Delay(100);
-    HAL_GPIO_WritePin(ESP_RESET_PORT, ESP_RESET_PIN, GPIO_PIN_SET);
-    HAL_Delay(ESP_TIMEOUT_RESET);
-    
-    // Clear RX buffer
-    uint8_t dummy;
-    while (HAL_UART_Receive(&ESP_USART, &dummy, 1, 10) == HAL_OK);
-    // debug_printf("[ESP] Reset complete\r\n");
+    uint32_t sr = ESP_USART.Instance->SR;
+    uint8_t byte;
+    uint16_t next;
+
+    if (!(sr & (USART_SR_RXNE | USART_SR_ORE))) {
+        return 0;
+    }
+
+    /* SR then DR read also clears ORE, the byte behind it is lost */
+    byte = (uint8_t)ESP_USART.Instance->DR;
+    if (sr & USART_SR_ORE) {
+        esp_rx_dropped++;
+    }
+    next = (esp_rx_head + 1) & ESP_RX_RING_MASK;
+    if (next != esp_rx_tail) {
+        if (byte == '\n' && ((esp_rx_stamp_head + 1) & ESP_RX_STAMP_MASK) != esp_rx_stamp_tail) {
+            esp_rx_stamps[esp_rx_stamp_head].cycles = DWT->CYCCNT;
+            esp_rx_stamps[esp_rx_stamp_head].pos = esp_rx_head;
+            esp_rx_stamp_head = (esp_rx_stamp_head + 1) & ESP_RX_STAMP_MASK;
+        }
+        esp_rx_ring[esp_rx_head] = byte;
+        esp_rx_head = next;
+    } else {
+        esp_rx_dropped++;
+    }
+    if (byte == '\n') {
+        ESP8266_RxLineCallback();
+    }
+    return 1;
 }
 
 /**
- * \brief           Receive data with timeout
- * \param[out]      buffer: Buffer to store received data
- * \param[in]       len: Maximum number of bytes to receive
- * \param[in]       timeout: Timeout in milliseconds
- * \return          Number of bytes actually received
+ * \brief           A line ended in the receive ring, called from the interrupt
+ * \note            Weak, the modem task overrides it to wake up
  */
-static size_t esp_ll_receive(void* buffer, size_t len, uint32_t timeout)
+__weak void ESP8266_RxLineCallback(void)
 {
-    uint32_t start_time = HAL_GetTick();
-    uint8_t* buf = (uint8_t*)buffer;
-    size_t received = 0;
-    
-    while (received < len && (HAL_GetTick() - start_time) < timeout) {
-        if (HAL_UART_Receive(&ESP_USART, &buf[received], 1, 50) == HAL_OK) {
-            received++;
+}
+
+/**
+ * \brief           Start interrupt driven reception
+ */
+static void esp_ll_rx_start(void)
+{
+    esp_rx_head = 0;
+    esp_rx_tail = 0;
+    esp_rx_stamp_head = 0;
+    esp_rx_stamp_tail = 0;
+    esp_line_len = 0;
+    (void)ESP_USART.Instance->SR;
+    (void)ESP_USART.Instance->DR;
+    __HAL_UART_ENABLE_IT(&ESP_USART, UART_IT_RXNE);
+}
+
+/**
+ * \brief           Hand a +MQTTSUBRECV line to the message handler
+ * \param[in]       args: Line after the URC prefix, e.g. 0,"sensor/control",1,1
+ */
+static void esp_dispatch_message(char* args)
+{
+    char* topic;
+    char* end;
+    char* data;
+    size_t len;
+
+    topic = strchr(args, '"');
+    if (topic == NULL) {
+        return;
+    }
+    topic++;
+    end = strchr(topic, '"');
+    if (end == NULL || end[1] != ',') {
+        return;
+    }
+    *end = '\0';
+
+    data = strchr(end + 2, ',');
+    if (data == NULL) {
+        return;
+    }
+    data++;
+
+    /* the payload cannot be longer than what made it into the line */
+    len = strtoul(end + 2, NULL, 10);
+    if (len > strlen(data)) {
+        len = strlen(data);
+    }
+
+    if (esp_msg_handler != NULL) {
+        esp_msg_handler(topic, data, (uint16_t)len);
+    }
+}
+
+/**
+ * \brief           Act on unsolicited result codes
+ * \param[in]       line: Complete line without CR/LF
+ * \return          1 when the line is consumed and is not part of a response
+ */
+static uint8_t esp_handle_urc(char* line)
+{
+    if (strncmp(line, ESP_URC_MQTTSUBRECV, strlen(ESP_URC_MQTTSUBRECV)) == 0) {
+        esp_dispatch_message(line + strlen(ESP_URC_MQTTSUBRECV));
+        return 1;
+    }
+
+    /* link state follows the URCs, no need to poll it with AT commands */
+    if (strcmp(line, ESP_URC_WIFI_DISCONNECT) == 0) {
+        wifi_status = WIFI_DISCONNECTED;
+        mqtt_status = MQTT_DISCONNECTED;
+    } else if (strncmp(line, ESP_URC_MQTTDISCONNECTED, strlen(ESP_URC_MQTTDISCONNECTED)) == 0) {
+        mqtt_status = MQTT_DISCONNECTED;
+    } else if (strcmp(line, ESP_AT_CMD_WIFI_GOT_IP) == 0) {
+        wifi_status = WIFI_CONNECTED;
+    }
+    return 0;
+}
+
+/**
+ * \brief           Drain the receive ring line by line
+ * \return          Number of response lines added to esp_rx_buffer
+ */
+static size_t esp_rx_poll(void)
+{
+    size_t added = 0;
+
+    while (esp_rx_tail != esp_rx_head) {
+        uint16_t pos = esp_rx_tail;
+        char c = (char)esp_rx_ring[pos];
+        esp_rx_tail = (esp_rx_tail + 1) & ESP_RX_RING_MASK;
+
+        if (c != '\n') {
+            if (c != '\r' && esp_line_len < ESP_LINE_SIZE - 1) {
+                esp_line[esp_line_len++] = c;
+            }
+            continue;
+        }
+
+        /* more lines queued than stamps: the unstamped ones count from now */
+        if (esp_rx_stamp_tail != esp_rx_stamp_head && esp_rx_stamps[esp_rx_stamp_tail].pos == pos) {
+            esp_line_stamp = esp_rx_stamps[esp_rx_stamp_tail].cycles;
+            esp_rx_stamp_tail = (esp_rx_stamp_tail + 1) & ESP_RX_STAMP_MASK;
+        } else {
+            esp_line_stamp = DWT->CYCCNT;
+        }
+
+        esp_line[esp_line_len] = '\0';
+        if (esp_line_len > 0 && !esp_handle_urc(esp_line) && esp_state == ESP_STATE_BUSY &&
+            esp_rx_len + esp_line_len + 2 < sizeof(esp_rx_buffer)) {
+            memcpy(&esp_rx_buffer[esp_rx_len], esp_line, esp_line_len);
+            esp_rx_len += esp_line_len;
+            esp_rx_buffer[esp_rx_len++] = '\r';
+            esp_rx_buffer[esp_rx_len++] = '\n';
+            esp_rx_buffer[esp_rx_len] = '\0';
+            added++;
         }
+        esp_line_len = 0;
     }
+    return added;
+}
+
+/**
+ * \brief           Hardware reset ESP device
+ */
+static void esp_ll_reset(void)
+{
+		// Pull the pin down and then pull it up for reset	
+		// debug_printf("[ESP] Hardware reset...\r\n");
+    HAL_GPIO_WritePin(ESP_RESET_PORT, ESP_RESET_PIN, GPIO_PIN_RESET);
+    osDelay(100);
+    HAL_GPIO_WritePin(ESP_RESET_PORT, ESP_RESET_PIN, GPIO_PIN_SET);
+    osDelay(ESP_TIMEOUT_RESET);
     
-    return received;
+    // Drop the boot messages
+    esp_rx_tail = esp_rx_head;
+    esp_rx_stamp_tail = esp_rx_stamp_head;
+    esp_line_len = 0;
+    // debug_printf("[ESP] Reset complete\r\n");
 }
 
 /**
@@ -140,11 +326,14 @@ static ESP8266_Status_t esp_send_cmd(const char* cmd, const char* resp, uint32_t
         return ESP8266_ERROR;
     }
     
+    /* Lines queued so far are URCs, handle them before the response starts */
+    esp_rx_poll();
     esp_state = ESP_STATE_BUSY;
     
     /* Clear buffers */
     memset(esp_rx_buffer, 0, sizeof(esp_rx_buffer));
     memset(esp_at_buffer, 0, sizeof(esp_at_buffer));
+    esp_rx_len = 0;
     
     /* Prepare AT command */
     if (strncmp(cmd, "AT", 2) != 0) {
@@ -163,15 +352,10 @@ static ESP8266_Status_t esp_send_cmd(const char* cmd, const char* resp, uint32_t
     
     /* Wait for response */
     uint32_t start_time = HAL_GetTick();
-    size_t rx_len = 0;
     
     while ((HAL_GetTick() - start_time) < timeout) {
-        size_t received = esp_ll_receive(&esp_rx_buffer[rx_len], 
-                                       sizeof(esp_rx_buffer) - rx_len - 1, 100);
-        if (received > 0) {
-            rx_len += received;
-            esp_rx_buffer[rx_len] = '\0';
-            
+        /* URCs arriving meanwhile are dispatched, not added to the response */
+        if (esp_rx_poll() > 0) {
             /* Check for expected response */
             if (resp && strstr(esp_rx_buffer, resp)) {
                 //debug_printf("[RX] Found: %s\r\n", resp);
@@ -216,10 +400,10 @@ static ESP8266_Status_t esp_send_cmd(const char* cmd, const char* resp, uint32_t
             }
         }
         
-        HAL_Delay(10);
+        osDelay(1);
     }   
-    //debug_printf("[RX] TIMEOUT (%d bytes)\r\n", rx_len);
-    if (rx_len > 0) {
+    //debug_printf("[RX] TIMEOUT (%d bytes)\r\n", esp_rx_len);
+    if (esp_rx_len > 0) {
         //debug_printf("[RX] Partial: %s\r\n", esp_rx_buffer);
     }   
     esp_state = ESP_STATE_IDLE;
@@ -233,6 +417,7 @@ static ESP8266_Status_t esp_send_cmd(const char* cmd, const char* resp, uint32_t
 ESP8266_Status_t ESP8266_Init(void)
 {
     /* Hardware reset */
+    esp_ll_rx_start();
     esp_ll_reset(); 
     /* Test basic communication */
     for (int i = 0; i < 3; i++) {
@@ -245,7 +430,7 @@ ESP8266_Status_t ESP8266_Init(void)
             // debug_printf("[ESP] Communication FAILED\r\n");
             return ESP8266_ERROR;
         }
-        HAL_Delay(1000);
+        osDelay(1000);
     }
     
     /* Disable echo */
@@ -279,7 +464,7 @@ ESP8266_Status_t ESP8266_ConnectWiFi(char* ssid, char* password)
     
     /* Disconnect first */
     esp_send_cmd("+CWQAP", NULL, 3000);
-    HAL_Delay(1000);
+    osDelay(1000);
     
     /* Connect to WiFi */
     snprintf(cmd, sizeof(cmd), "+CWJAP=\"%s\",\"%s\"", ssid, password);
@@ -310,6 +495,8 @@ ESP8266_Status_t ESP8266_DisconnectWiFi(void)
 
 /**
  * \brief           Get WiFi connection status
+ * \note            Queries the module with AT+CWJAP?, may block for
+ *                  ESP_TIMEOUT_CMD; see ESP8266_GetWiFiState()
  * \return          Current WiFi status
  */
 WiFi_Status_t ESP8266_GetWiFiStatus(void)
@@ -328,6 +515,16 @@ WiFi_Status_t ESP8266_GetWiFiStatus(void)
     return wifi_status;
 }
 
+/**
+ * \brief           Get the WiFi status last reported by the module
+ * \note            Updated from connect results and WIFI URCs, no AT traffic
+ * \return          Current WiFi status
+ */
+WiFi_Status_t ESP8266_GetWiFiState(void)
+{
+    return wifi_status;
+}
+
 /**
  * \brief           Connect to MQTT broker
  * \param[in]       host: MQTT broker host
@@ -460,6 +657,48 @@ void ESP8266_ClearBuffer(void)
 {
     memset(esp_rx_buffer, 0, sizeof(esp_rx_buffer));
     memset(esp_at_buffer, 0, sizeof(esp_at_buffer));
+    esp_rx_len = 0;
+}
+
+/**
+ * \brief           Register the callback for +MQTTSUBRECV messages
+ * \param[in]       handler: Called with topic and payload as soon as the
+ *                  line is complete, possibly from inside another ESP8266
+ *                  call, so it must not send AT commands itself
+ */
+void ESP8266_SetMessageHandler(ESP8266_MessageHandler_t handler)
+{
+    esp_msg_handler = handler;
+}
+
+/**
+ * \brief           Receive time of the line being handled
+ * \return          DWT cycle count when its '\n' arrived, valid inside the
+ *                  message handler
+ */
+uint32_t ESP8266_GetLineStamp(void)
+{
+    return esp_line_stamp;
+}
+
+/**
+ * \brief           Received bytes lost since start
+ * \return          Bytes dropped with the receive ring full plus USART
+ *                  overruns, a truncated line is not parsed correctly
+ */
+uint32_t ESP8266_GetRxDropped(void)
+{
+    return esp_rx_dropped;
+}
+
+/**
+ * \brief           Handle received URCs while no command is running
+ */
+void ESP8266_Process(void)
+{
+    if (esp_state == ESP_STATE_IDLE) {
+        esp_rx_poll();
+    }
 }
 /**
  * \brief           Send AT command (public wrapper)
@@ -28,7 +28,15 @@ void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(ESP8266_RST_GPIO_Port, &GPIO_InitStruct);
   
+  /*Configure GPIO pins : AIN1_Pin AIN2_Pin STBY_Pin (motor driver) */
+  GPIO_InitStruct.Pin = AIN1_Pin|AIN2_Pin|STBY_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(AIN1_GPIO_Port, &GPIO_InitStruct);
+  
   /*Configure GPIO pin Output Level */
   HAL_GPIO_WritePin(GPIOA, GPIO_PIN_1, GPIO_PIN_RESET);  
+  HAL_GPIO_WritePin(AIN1_GPIO_Port, AIN1_Pin|AIN2_Pin|STBY_Pin, GPIO_PIN_RESET);
   HAL_GPIO_WritePin(ESP8266_RST_GPIO_Port, ESP8266_RST_Pin, GPIO_PIN_SET);
 }
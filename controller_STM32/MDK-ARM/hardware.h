@@ -52,6 +52,40 @@ typedef enum {
     MQTT_ERROR                      /*!< MQTT connection error */
 } MQTT_Status_t;
 
+/**
+ * @brief MQTT message callback, topic and payload point into the driver's
+ *        line buffer and are valid only during the call
+ */
+typedef void (*ESP8266_MessageHandler_t)(const char* topic, const char* data, uint16_t len);
+
+/**
+ * @brief Outputs driven by the pattern engine
+ */
+typedef enum {
+    PATTERN_CH_BUZZER = 0,          /*!< PA1, on for any level above 0 */
+    PATTERN_CH_MOTOR,               /*!< TIM4 CH1 duty of the TB6612 PWMA input */
+    PATTERN_CH_COUNT
+} Pattern_Channel_t;
+
+/**
+ * @brief One pattern step, level is reached at the start of the step or,
+ *        for a ramp, slid into linearly over the step
+ */
+typedef struct {
+    uint8_t level;                  /*!< Output level in percent */
+    uint8_t ramp;                   /*!< 1: slide from the previous level */
+    uint16_t ms;                    /*!< Step length, rounded to PATTERN_TICK_MS */
+} Pattern_Step_t;
+
+/**
+ * @brief Step table with a pass count, the last level stays on the output
+ */
+typedef struct {
+    const Pattern_Step_t* steps;
+    uint8_t count;                  /*!< Number of steps */
+    uint8_t repeat;                 /*!< Passes through the table, 0 repeats until stopped */
+} Pattern_t;
+
 /* Exported constants --------------------------------------------------------*/
 
 // GPIO Pin Definitions - Motor Control
@@ -59,6 +93,13 @@ typedef enum {
 #define AIN2_Pin                    GPIO_PIN_1  
 #define STBY_Pin                    GPIO_PIN_4
 
+// GPIO Pin Definitions - Buzzer
+#define BUZZER_Pin                  GPIO_PIN_1
+#define BUZZER_GPIO_Port            GPIOA
+
+// Pattern engine tick, one TIM4 PWM period: 36 MHz / 72 / 1000
+#define PATTERN_TICK_MS             2
+
 
 // UART Configuration
 #define DEBUG_UART                  huart1          /*!< Debug UART interface */
@@ -102,6 +143,16 @@ void MX_USART2_UART_Init(void);
 // Timer functions
 void MX_TIM4_Init(void);
 
+// Pattern engine functions
+void Pattern_Init(void);
+void Pattern_Start(Pattern_Channel_t ch, const Pattern_t* pattern);
+void Pattern_Ramp(Pattern_Channel_t ch, uint8_t level, uint16_t ms);
+void Pattern_Pulse(Pattern_Channel_t ch, uint8_t level, uint16_t ms);
+void Pattern_Stop(Pattern_Channel_t ch);
+uint8_t Pattern_IsRunning(Pattern_Channel_t ch);
+uint8_t Pattern_GetLevel(Pattern_Channel_t ch);
+void Pattern_Tick(void);
+
 // Watchdog functions
 void MX_IWDG_Init(void);
 
@@ -113,11 +164,18 @@ ESP8266_Status_t ESP8266_Init(void);
 ESP8266_Status_t ESP8266_SendCommand(const char* cmd, uint32_t timeout);
 char* ESP8266_GetBuffer(void);
 void ESP8266_ClearBuffer(void);
+uint8_t ESP8266_UART_IRQHandler(void);
+void ESP8266_RxLineCallback(void);
+void ESP8266_Process(void);
+void ESP8266_SetMessageHandler(ESP8266_MessageHandler_t handler);
+uint32_t ESP8266_GetLineStamp(void);
+uint32_t ESP8266_GetRxDropped(void);
 
 // ESP8266 WiFi Functions
 ESP8266_Status_t ESP8266_ConnectWiFi(char* ssid, char* password);
 ESP8266_Status_t ESP8266_DisconnectWiFi(void);
 WiFi_Status_t ESP8266_GetWiFiStatus(void);
+WiFi_Status_t ESP8266_GetWiFiState(void);
 
 // ESP8266 MQTT Functions
 ESP8266_Status_t ESP8266_ConnectMQTT(char* server, uint16_t port, char* client_id, char* username, char* password);
@@ -0,0 +1,203 @@
+#include "hardware.h"
+
+/*
+ * Actuator pattern engine, stepped from the TIM4 update interrupt.
+ * TIM4 already runs the motor PWM, so every PWM period is one engine tick
+ * and a duty change lands on the next period boundary. Each channel walks
+ * its own step table, the channels run independently of each other.
+ * Levels are kept in 1/100 percent so slow ramps still move every tick.
+ */
+#define PATTERN_LEVEL_FULL          10000
+
+typedef struct {
+    const Pattern_Step_t* steps;
+    uint8_t count;
+    uint8_t index;
+    uint8_t loops;                  // passes left, 0 repeats until stopped
+    uint8_t forever;
+    volatile uint8_t running;
+    uint16_t level;                 // current output, 1/100 percent
+    uint16_t from;                  // step start level
+    uint16_t to;                    // step end level
+    uint16_t ticks;                 // step length in engine ticks
+    uint16_t elapsed;
+    Pattern_Step_t single[2];       // backing table for Pattern_Ramp/Pattern_Pulse
+} Pattern_Channel_State_t;
+
+static Pattern_Channel_State_t channels[PATTERN_CH_COUNT];
+
+static void Pattern_Apply(Pattern_Channel_t ch, uint16_t level)
+{
+    uint32_t period;
+
+    switch(ch)
+    {
+        case PATTERN_CH_BUZZER:
+            HAL_GPIO_WritePin(BUZZER_GPIO_Port, BUZZER_Pin, level ? GPIO_PIN_SET : GPIO_PIN_RESET);
+            break;
+        case PATTERN_CH_MOTOR:
+            period = __HAL_TIM_GET_AUTORELOAD(&htim4) + 1;
+            __HAL_TIM_SET_COMPARE(&htim4, TIM_CHANNEL_1, period * level / PATTERN_LEVEL_FULL);
+            break;
+        default:
+            break;
+    }
+}
+
+static void Pattern_LoadStep(Pattern_Channel_t ch)
+{
+    Pattern_Channel_State_t* c = &channels[ch];
+    const Pattern_Step_t* step = &c->steps[c->index];
+
+    c->from = c->level;
+    c->to = (uint16_t)(step->level > 100 ? 100 : step->level) * 100;
+    c->ticks = step->ms / PATTERN_TICK_MS;
+    if(c->ticks == 0) c->ticks = 1;
+    c->elapsed = 0;
+    if(!step->ramp)
+    {
+        c->level = c->to;
+        Pattern_Apply(ch, c->level);
+    }
+}
+
+/**
+  * @brief start a pattern on a channel, replaces whatever ran there
+  * @note  The table must stay valid while it runs, the engine keeps the pointer
+  */
+void Pattern_Start(Pattern_Channel_t ch, const Pattern_t* pattern)
+{
+    Pattern_Channel_State_t* c;
+
+    if(ch >= PATTERN_CH_COUNT || pattern == NULL || pattern->count == 0) return;
+    c = &channels[ch];
+
+    // the update interrupt is the only other writer
+    __HAL_TIM_DISABLE_IT(&htim4, TIM_IT_UPDATE);
+    c->steps = pattern->steps;
+    c->count = pattern->count;
+    c->loops = pattern->repeat;
+    c->forever = pattern->repeat == 0;
+    c->index = 0;
+    Pattern_LoadStep(ch);
+    c->running = 1;
+    __HAL_TIM_ENABLE_IT(&htim4, TIM_IT_UPDATE);
+}
+
+static void Pattern_StartSingle(Pattern_Channel_t ch, uint8_t steps)
+{
+    Pattern_t pattern;
+
+    pattern.steps = channels[ch].single;
+    pattern.count = steps;
+    pattern.repeat = 1;
+    Pattern_Start(ch, &pattern);
+}
+
+/**
+  * @brief slide a channel from its current level to level over ms, then hold
+  */
+void Pattern_Ramp(Pattern_Channel_t ch, uint8_t level, uint16_t ms)
+{
+    if(ch >= PATTERN_CH_COUNT) return;
+
+    __HAL_TIM_DISABLE_IT(&htim4, TIM_IT_UPDATE);
+    channels[ch].single[0].level = level;
+    channels[ch].single[0].ramp = 1;
+    channels[ch].single[0].ms = ms;
+    Pattern_StartSingle(ch, 1);
+}
+
+/**
+  * @brief hold level for ms, then switch the channel off
+  */
+void Pattern_Pulse(Pattern_Channel_t ch, uint8_t level, uint16_t ms)
+{
+    if(ch >= PATTERN_CH_COUNT) return;
+
+    __HAL_TIM_DISABLE_IT(&htim4, TIM_IT_UPDATE);
+    channels[ch].single[0].level = level;
+    channels[ch].single[0].ramp = 0;
+    channels[ch].single[0].ms = ms;
+    channels[ch].single[1].level = 0;
+    channels[ch].single[1].ramp = 0;
+    channels[ch].single[1].ms = 0;
+    Pattern_StartSingle(ch, 2);
+}
+
+/**
+  * @brief stop a channel and switch its output off at once
+  */
+void Pattern_Stop(Pattern_Channel_t ch)
+{
+    if(ch >= PATTERN_CH_COUNT) return;
+
+    __HAL_TIM_DISABLE_IT(&htim4, TIM_IT_UPDATE);
+    channels[ch].running = 0;
+    channels[ch].level = 0;
+    Pattern_Apply(ch, 0);
+    __HAL_TIM_ENABLE_IT(&htim4, TIM_IT_UPDATE);
+}
+
+uint8_t Pattern_IsRunning(Pattern_Channel_t ch)
+{
+    return ch < PATTERN_CH_COUNT ? channels[ch].running : 0;
+}
+
+/**
+  * @brief current output level of a channel in percent
+  */
+uint8_t Pattern_GetLevel(Pattern_Channel_t ch)
+{
+    return ch < PATTERN_CH_COUNT ? (uint8_t)(channels[ch].level / 100) : 0;
+}
+
+/**
+  * @brief enable the engine tick, TIM4 must already run the PWM
+  */
+void Pattern_Init(void)
+{
+    uint8_t ch;
+
+    for(ch = 0; ch < PATTERN_CH_COUNT; ch++)
+    {
+        Pattern_Stop((Pattern_Channel_t)ch);
+    }
+    __HAL_TIM_CLEAR_IT(&htim4, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE_IT(&htim4, TIM_IT_UPDATE);
+}
+
+/**
+  * @brief advance every running channel by one tick, TIM4 update interrupt
+  */
+void Pattern_Tick(void)
+{
+    Pattern_Channel_State_t* c;
+    uint8_t ch;
+
+    for(ch = 0; ch < PATTERN_CH_COUNT; ch++)
+    {
+        c = &channels[ch];
+        if(!c->running) continue;
+
+        c->elapsed++;
+        if(c->steps[c->index].ramp)
+        {
+            c->level = (uint16_t)(c->from + ((int32_t)c->to - c->from) * c->elapsed / c->ticks);
+            Pattern_Apply((Pattern_Channel_t)ch, c->level);
+        }
+        if(c->elapsed < c->ticks) continue;
+
+        if(++c->index >= c->count)
+        {
+            c->index = 0;
+            if(!c->forever && --c->loops == 0)
+            {
+                // the last level stays on the output
+                c->running = 0;
+                continue;
+            }
+        }
+        Pattern_LoadStep((Pattern_Channel_t)ch);
+    }
+}
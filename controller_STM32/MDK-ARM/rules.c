@@ -0,0 +1,295 @@
+#include "main.h"
+#include "tasks.h"
+#include "hardware.h"
+#include <string.h>
+
+/*
+ * Edge rules: the controller reads the sensor node's own sensor/data
+ * publish and drives the buzzer and motor without the round trip through
+ * the monitor UI. Each rule switches on above one threshold and off below
+ * a lower one, and holds each state for a minimum time. An output is on
+ * while any of its rules is. A manual command on an output suspends the
+ * rules for that output until it expires or RA (resume) arrives. The rules
+ * start off: an RN control frame turns them on, RF off again.
+ *
+ * Payload from the sensor node:
+ *   Temp:25.3_Humidity:60.0_SmokePPM:12_AirPPM:80_Lightlux:300_Alarm:0_Updatetime:1234
+ * Values are kept in tenths so the thresholds stay integers.
+ *
+ * Only the modem task calls in here, no locking.
+ */
+#define RULES_ENABLED_AT_BOOT       0       // RN control frame enables them
+#define RULES_OVERRIDE_MS           600000  // manual command holds an output for 10 min
+#define RULES_FAN_DUTY              70      // motor duty while a rule wants it on
+#define RULES_PAYLOAD_MAX           160
+#define RULES_VALUE_DIGITS          8       // integer digits, tenths of it still fit int32_t
+
+typedef enum {
+    RULE_FIELD_TEMP = 0,
+    RULE_FIELD_HUMIDITY,
+    RULE_FIELD_SMOKE,
+    RULE_FIELD_AIR,
+    RULE_FIELD_LIGHT,
+    RULE_FIELD_ALARM,
+    RULE_FIELD_COUNT
+} Rule_Field_t;
+
+typedef struct {
+    uint8_t field;                  // Rule_Field_t
+    uint8_t output;                 // Rule_Output_t
+    int32_t on_above;               // tenths
+    int32_t off_below;              // tenths, on_above minus the hysteresis
+    uint16_t min_on_s;
+    uint16_t min_off_s;
+} Rule_t;
+
+typedef struct {
+    uint8_t on;
+    uint8_t settled;                // has switched at least once, min times apply
+    uint32_t changed_at;            // HAL tick of the last switch
+} Rule_State_t;
+
+typedef struct {
+    uint8_t applied;                // state last sent to the actuator
+    uint8_t known;                  // 0 forces the next evaluation to send
+    uint8_t overridden;
+    uint32_t override_until;
+} Rule_OutputState_t;
+
+static const char* const rule_keys[RULE_FIELD_COUNT] = {
+    "Temp:", "Humidity:", "SmokePPM:", "AirPPM:", "Lightlux:", "Alarm:"
+};
+
+static const Rule_t rules[] = {
+    { RULE_FIELD_ALARM, RULE_OUT_BUZZER, 5,     5,     5,  0  },
+    { RULE_FIELD_SMOKE, RULE_OUT_BUZZER, 3000,  2000,  10, 5  },
+    { RULE_FIELD_TEMP,  RULE_OUT_MOTOR,  300,   280,   60, 30 },
+    { RULE_FIELD_AIR,   RULE_OUT_MOTOR,  10000, 8000,  60, 30 },
+};
+
+#define RULE_COUNT  (sizeof(rules) / sizeof(rules[0]))
+
+static Rule_State_t rule_state[RULE_COUNT];
+static Rule_OutputState_t outputs[RULE_OUT_COUNT];
+static int32_t values[RULE_FIELD_COUNT];
+static uint8_t have_values = 0;
+static uint8_t rules_enabled = RULES_ENABLED_AT_BOOT;
+static uint32_t sample_time = 0;    // sensor's Updatetime of the last sample
+
+/**
+ * \brief    Parse "[-]digits[.digit]" after key into tenths
+ * \return   1 when the key was found with a number of at most
+ *           RULES_VALUE_DIGITS integer digits
+ */
+static uint8_t rules_parse(const char* payload, const char* key, int32_t* value)
+{
+    const char* p = strstr(payload, key);
+    int32_t v = 0;
+    uint8_t neg = 0;
+    uint8_t digits = 0;
+
+    if (p == NULL) {
+        return 0;
+    }
+    p += strlen(key);
+    if (*p == '-') {
+        neg = 1;
+        p++;
+    }
+    if (*p < '0' || *p > '9') {
+        return 0;
+    }
+    while (*p >= '0' && *p <= '9') {
+        if (++digits > RULES_VALUE_DIGITS) {
+            return 0;
+        }
+        v = v * 10 + (*p++ - '0');
+    }
+    v *= 10;
+    if (*p == '.' && p[1] >= '0' && p[1] <= '9') {
+        v += p[1] - '0';
+    }
+    *value = neg ? -v : v;
+    return 1;
+}
+
+/**
+ * \brief    Queue an output change, only a change caused by a fresh sample
+ *           counts toward the reaction time
+ */
+static uint8_t rules_submit(Actuator_Cmd_t cmd, uint16_t arg, const uint32_t* received_at)
+{
+    return received_at ? Actuator_SubmitRule(cmd, arg, *received_at) : Actuator_Submit(cmd, arg);
+}
+
+static void rules_drive(Rule_Output_t output, uint8_t on, const uint32_t* received_at)
+{
+    Rule_OutputState_t* out = &outputs[output];
+    uint8_t queued;
+
+    if (out->known && out->applied == on) {
+        return;
+    }
+    if (output == RULE_OUT_BUZZER) {
+        queued = on ? rules_submit(ACT_CMD_BUZZER_PATTERN, BUZZER_PATTERN_ALARM, received_at)
+                    : rules_submit(ACT_CMD_BUZZER_OFF, 0, received_at);
+    } else {
+        queued = on ? rules_submit(ACT_CMD_MOTOR_FORWARD, RULES_FAN_DUTY, received_at)
+                    : rules_submit(ACT_CMD_MOTOR_STOP, 0, received_at);
+    }
+    // a full queue leaves the output unknown, the next pass retries
+    if (queued) {
+        out->applied = on;
+        out->known = 1;
+    }
+}
+
+/**
+ * \brief    Step every rule on the latest values and drive the outputs
+ * \param    received_at: arrival of the sample being evaluated, NULL on a
+ *           timed re-evaluation
+ */
+static void rules_evaluate(const uint32_t* received_at)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t want[RULE_OUT_COUNT] = { 0 };
+    uint8_t i;
+
+    if (!rules_enabled || !have_values) {
+        return;
+    }
+
+    for (i = 0; i < RULE_COUNT; i++) {
+        const Rule_t* rule = &rules[i];
+        Rule_State_t* st = &rule_state[i];
+        int32_t v = values[rule->field];
+
+        if (!st->on && v > rule->on_above &&
+            (!st->settled || now - st->changed_at >= (uint32_t)rule->min_off_s * 1000)) {
+            st->on = 1;
+            st->settled = 1;
+            st->changed_at = now;
+        } else if (st->on && v < rule->off_below &&
+                   now - st->changed_at >= (uint32_t)rule->min_on_s * 1000) {
+            st->on = 0;
+            st->changed_at = now;
+        }
+        want[rule->output] |= st->on;
+    }
+
+    for (i = 0; i < RULE_OUT_COUNT; i++) {
+        if (outputs[i].overridden) {
+            if ((int32_t)(now - outputs[i].override_until) < 0) {
+                continue;
+            }
+            outputs[i].overridden = 0;
+            outputs[i].known = 0;
+        }
+        rules_drive((Rule_Output_t)i, want[i], received_at);
+    }
+}
+
+void Rules_Init(void)
+{
+    memset(rule_state, 0, sizeof(rule_state));
+    memset(outputs, 0, sizeof(outputs));
+    have_values = 0;
+}
+
+/**
+ * \brief    Turn the rules on or off, outputs they switched on go off
+ */
+void Rules_Enable(uint8_t enable)
+{
+    uint8_t i;
+
+    if (!enable && rules_enabled) {
+        for (i = 0; i < RULE_OUT_COUNT; i++) {
+            if (!outputs[i].overridden && outputs[i].known && outputs[i].applied) {
+                rules_drive((Rule_Output_t)i, 0, NULL);
+            }
+        }
+    }
+    if (enable && !rules_enabled) {
+        Rules_Init();
+    }
+    rules_enabled = enable ? 1 : 0;
+}
+
+uint8_t Rules_IsEnabled(void)
+{
+    return rules_enabled;
+}
+
+/**
+ * \brief    Evaluate a sensor/data payload
+ * \param    received_at: DWT->CYCCNT when its line arrived
+ */
+void Rules_HandleData(const char* data, uint16_t len, uint32_t received_at)
+{
+    char payload[RULES_PAYLOAD_MAX];
+    int32_t update;
+    uint8_t i;
+
+    if (!rules_enabled) {
+        return;
+    }
+    if (len >= sizeof(payload)) {
+        len = sizeof(payload) - 1;
+    }
+    memcpy(payload, data, len);
+    payload[len] = '\0';
+
+    // a sample missing a field keeps that field's previous value
+    for (i = 0; i < RULE_FIELD_COUNT; i++) {
+        rules_parse(payload, rule_keys[i], &values[i]);
+    }
+    if (rules_parse(payload, "Updatetime:", &update)) {
+        sample_time = (uint32_t)(update / 10);
+    }
+    have_values = 1;
+    rules_evaluate(&received_at);
+}
+
+/**
+ * \brief    Re-evaluate between samples so minimum times and overrides
+ *           expire on time, called every modem loop pass
+ */
+void Rules_Poll(void)
+{
+    rules_evaluate(NULL);
+}
+
+/**
+ * \brief    A manual command took the output, rules leave it alone for a while
+ */
+void Rules_Override(Rule_Output_t output)
+{
+    if (output >= RULE_OUT_COUNT) {
+        return;
+    }
+    outputs[output].overridden = 1;
+    outputs[output].override_until = HAL_GetTick() + RULES_OVERRIDE_MS;
+}
+
+/**
+ * \brief    Hand every output back to the rules at once
+ */
+void Rules_Resume(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < RULE_OUT_COUNT; i++) {
+        outputs[i].overridden = 0;
+        outputs[i].known = 0;
+    }
+    rules_evaluate(NULL);
+}
+
+/**
+ * \brief    Sensor uptime in seconds of the sample evaluated last
+ */
+uint32_t Rules_GetSampleTime(void)
+{
+    return sample_time;
+}
@@ -0,0 +1,236 @@
+#include "main.h"
+#include "tasks.h"
+#include "hardware.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Longest wait for a command, keeps the heartbeat fresh for the supervisor
+#define ACTUATOR_IDLE_WAIT          500
+
+// Soft start slope, a full 0..100 % change takes 100 * this
+#define MOTOR_RAMP_MS_PER_PERCENT   5
+
+typedef enum {
+    MOTOR_DIR_COAST = 0,
+    MOTOR_DIR_FORWARD,
+    MOTOR_DIR_REVERSE,
+    MOTOR_DIR_BRAKE
+} Motor_Dir_t;
+
+volatile uint32_t g_actuator_heartbeat = 0;
+
+static Actuator_Stats_t actuator_stats;
+static Motor_Dir_t motor_dir = MOTOR_DIR_COAST;
+
+static const Pattern_Step_t beep_ack[] = {
+    { 100, 0, 80 }, { 0, 0, 80 }, { 100, 0, 80 }, { 0, 0, 0 },
+};
+static const Pattern_Step_t beep_error[] = {
+    { 100, 0, 400 }, { 0, 0, 150 },
+};
+static const Pattern_Step_t beep_alarm[] = {
+    { 100, 0, 150 }, { 0, 0, 100 }, { 100, 0, 150 }, { 0, 0, 600 },
+};
+
+static const Pattern_t buzzer_patterns[BUZZER_PATTERN_COUNT] = {
+    { beep_ack,   sizeof(beep_ack) / sizeof(beep_ack[0]),     1 },
+    { beep_error, sizeof(beep_error) / sizeof(beep_error[0]), 3 },
+    { beep_alarm, sizeof(beep_alarm) / sizeof(beep_alarm[0]), 0 },
+};
+
+static const Pattern_Step_t motor_soft_start[] = {
+    { 60, 1, 1200 },
+};
+static const Pattern_Step_t motor_kick_start[] = {
+    { 100, 0, 80 }, { 40, 1, 300 },
+};
+static const Pattern_Step_t motor_sweep[] = {
+    { 30, 1, 300 }, { 80, 1, 1500 }, { 30, 1, 1500 },
+};
+
+static const Pattern_t motor_profiles[MOTOR_PROFILE_COUNT] = {
+    { motor_soft_start, sizeof(motor_soft_start) / sizeof(motor_soft_start[0]), 1 },
+    { motor_kick_start, sizeof(motor_kick_start) / sizeof(motor_kick_start[0]), 1 },
+    { motor_sweep,      sizeof(motor_sweep) / sizeof(motor_sweep[0]),           0 },
+};
+
+/**
+ * \brief    MOTOR DIRECTION, TB6612 channel A, the duty belongs to the pattern engine
+ * \note     Direction only changes with the output at 0 %, a running pattern is cut
+ */
+static void Motor_Direction(Motor_Dir_t dir)
+{
+    if(dir == motor_dir) return;
+
+    Pattern_Stop(PATTERN_CH_MOTOR);
+    HAL_GPIO_WritePin(AIN1_GPIO_Port, AIN1_Pin, (dir == MOTOR_DIR_FORWARD || dir == MOTOR_DIR_BRAKE) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(AIN2_GPIO_Port, AIN2_Pin, (dir == MOTOR_DIR_REVERSE || dir == MOTOR_DIR_BRAKE) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(STBY_GPIO_Port, STBY_Pin, dir == MOTOR_DIR_COAST ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    motor_dir = dir;
+}
+
+/**
+ * \brief    MOTOR DRIVE, soft start from the current duty to duty
+ */
+static void Motor_Drive(Motor_Dir_t dir, uint16_t duty)
+{
+    uint8_t level;
+
+    Motor_Direction(dir);
+    level = Pattern_GetLevel(PATTERN_CH_MOTOR);
+    Pattern_Ramp(PATTERN_CH_MOTOR, (uint8_t)duty,
+                 (uint16_t)((duty > level ? duty - level : level - duty) * MOTOR_RAMP_MS_PER_PERCENT));
+}
+
+static uint8_t Actuator_Queue(Actuator_Cmd_t cmd, uint16_t arg, uint8_t from_rule, uint32_t queued_at)
+{
+    Actuator_Command_t* command = osMailAlloc(ActuatorQueueHandle, 0);
+
+    if(command == NULL)
+    {
+        taskENTER_CRITICAL();
+        actuator_stats.dropped++;
+        taskEXIT_CRITICAL();
+        return 0;
+    }
+    command->cmd = cmd;
+    command->from_rule = from_rule;
+    command->arg = arg;
+    command->queued_at = queued_at;
+    osMailPut(ActuatorQueueHandle, command);
+    return 1;
+}
+
+/**
+  * @brief queue a command for the actuator task, never blocks
+  * @retval 1 when queued, 0 when the queue is full
+  */
+uint8_t Actuator_Submit(Actuator_Cmd_t cmd, uint16_t arg)
+{
+    return Actuator_Queue(cmd, arg, 0, DWT->CYCCNT);
+}
+
+/**
+  * @brief queue a command decided by the edge rules
+  * @param received_at: DWT->CYCCNT when the sensor sample arrived, the
+  *        reaction time is measured from there
+  */
+uint8_t Actuator_SubmitRule(Actuator_Cmd_t cmd, uint16_t arg, uint32_t received_at)
+{
+    return Actuator_Queue(cmd, arg, 1, received_at);
+}
+
+void Actuator_GetStats(Actuator_Stats_t* stats)
+{
+    taskENTER_CRITICAL();
+    *stats = actuator_stats;
+    taskEXIT_CRITICAL();
+}
+
+/* USER CODE BEGIN Header_StartActuatorTask */
+/**
+* @brief Function implementing the ActuatorTask thread.
+* @param argument: Not used
+* @retval None
+*/
+/* USER CODE END Header_StartActuatorTask */
+void StartActuatorTask(void const * argument)
+{
+    /* USER CODE BEGIN StartActuatorTask */
+    osEvent evt;
+    Actuator_Command_t* command;
+    uint32_t start;
+    uint32_t queue_us;
+    uint32_t exec_us;
+    uint8_t from_rule;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+    // TIM4 runs the PWM and from here on steps the patterns
+    HAL_TIM_PWM_Start(&htim4, TIM_CHANNEL_1);
+    Pattern_Init();
+
+    /* Infinite loop */
+    for(;;)
+    {
+        g_actuator_heartbeat = HAL_GetTick();
+
+        // Timing lives in the TIM4 interrupt, the task only starts patterns
+        evt = osMailGet(ActuatorQueueHandle, ACTUATOR_IDLE_WAIT);
+        if(evt.status != osEventMail)
+        {
+            continue;
+        }
+
+        command = (Actuator_Command_t*)evt.value.p;
+        start = DWT->CYCCNT;
+        queue_us = (start - command->queued_at) / cycles_per_us;
+
+        switch(command->cmd)
+        {
+            case ACT_CMD_BUZZER_OFF:
+                Pattern_Stop(PATTERN_CH_BUZZER);
+                break;
+            case ACT_CMD_BUZZER_ON:
+                Pattern_Ramp(PATTERN_CH_BUZZER, 100, 0);
+                break;
+            case ACT_CMD_BUZZER_BEEP:
+                Pattern_Pulse(PATTERN_CH_BUZZER, 100, command->arg);
+                break;
+            case ACT_CMD_BUZZER_PATTERN:
+                if(command->arg < BUZZER_PATTERN_COUNT)
+                {
+                    Pattern_Start(PATTERN_CH_BUZZER, &buzzer_patterns[command->arg]);
+                }
+                break;
+            case ACT_CMD_MOTOR_FORWARD:
+                Motor_Drive(MOTOR_DIR_FORWARD, command->arg);
+                break;
+            case ACT_CMD_MOTOR_REVERSE:
+                Motor_Drive(MOTOR_DIR_REVERSE, command->arg);
+                break;
+            case ACT_CMD_MOTOR_STOP:
+                Motor_Direction(MOTOR_DIR_COAST);
+                Pattern_Stop(PATTERN_CH_MOTOR);
+                break;
+            case ACT_CMD_MOTOR_BRAKE:
+                Motor_Direction(MOTOR_DIR_BRAKE);
+                Pattern_Stop(PATTERN_CH_MOTOR);
+                break;
+            case ACT_CMD_MOTOR_PROFILE:
+                if(command->arg < MOTOR_PROFILE_COUNT)
+                {
+                    if(motor_dir != MOTOR_DIR_REVERSE)
+                    {
+                        Motor_Direction(MOTOR_DIR_FORWARD);
+                    }
+                    Pattern_Start(PATTERN_CH_MOTOR, &motor_profiles[command->arg]);
+                }
+                break;
+            default:
+                break;
+        }
+
+        exec_us = (DWT->CYCCNT - start) / cycles_per_us;
+        from_rule = command->from_rule;
+        osMailFree(ActuatorQueueHandle, command);
+
+        taskENTER_CRITICAL();
+        actuator_stats.executed++;
+        if(from_rule)
+        {
+            // queue_us already counts from the sample's arrival
+            actuator_stats.rule_executed++;
+            actuator_stats.react_us_last = queue_us + exec_us;
+            if(actuator_stats.react_us_last > actuator_stats.react_us_max) actuator_stats.react_us_max = actuator_stats.react_us_last;
+        }
+        else
+        {
+            actuator_stats.queue_us_last = queue_us;
+            if(queue_us > actuator_stats.queue_us_max) actuator_stats.queue_us_max = queue_us;
+        }
+        actuator_stats.exec_us_last = exec_us;
+        if(exec_us > actuator_stats.exec_us_max) actuator_stats.exec_us_max = exec_us;
+        taskEXIT_CRITICAL();
+    }
+    /* USER CODE END StartActuatorTask */
+}
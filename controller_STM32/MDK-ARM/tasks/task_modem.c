@@ -0,0 +1,365 @@
+#include "main.h"
+#include "tasks.h"
+#include "hardware.h"
+#include <string.h>
+#include <stdio.h>
+
+// WiFi Configure
+#define WIFI_SSID       "HXH"
+#define WIFI_PASSWORD   "Hxh20010523"
+
+// MQTT Configure
+#define MQTT_SERVER     "192.168.137.34"
+#define MQTT_PORT       1883
+#define MQTT_CLIENT_ID  "STM32_Controller_001"
+#define MQTT_USERNAME   ""
+#define MQTT_PASSWORD   ""
+#define MQTT_PUB_TOPIC   "sensor/status"
+#define MQTT_SUB_TOPIC   "sensor/control"
+#define MQTT_ACK_TOPIC   "sensor/control/ack"
+
+/* Reconnect time configure */
+#define WIFI_RECONNECT_DELAY_MS    5000
+#define MQTT_RECONNECT_DELAY_MS    5000
+
+// Longest sleep between housekeeping passes when no line arrives
+#define MODEM_IDLE_WAIT            100
+
+// Control frames
+#define CONTROL_MAX_BATCH          8       // commands per frame
+#define CONTROL_ACK_SLOTS          8       // frames acked per publish
+#define CONTROL_CMD_RULES          0xFF    // handled here, not by the actuator
+
+volatile uint32_t g_modem_heartbeat = 0;
+
+static uint32_t last_wifi_reconnect = 0;
+static uint32_t last_mqtt_reconnect = 0;
+static volatile uint8_t control_ack_pending = 0;
+static uint8_t rules_subscribed = 0;
+
+/*
+ * Control frame on sensor/control:
+ *   <msg_id>:<cmd>[;<cmd>...]      e.g. 17:BN  or  18:MF60;BP200
+ *   cmd = actuator letter, op letter, optional decimal value
+ * Ack on sensor/control/ack, several frames per publish:
+ *   <msg_id>:OK  <msg_id>:E<n> (command n invalid, nothing executed)
+ *   <msg_id>:Q<n> (queue full from command n on)   joined with ';'
+ * A bare '0' or '1' is still accepted and acked with "received" on sensor/status.
+ * B and M commands take the output away from the edge rules (rules.c) for a
+ * while; RN/RF switch the rules on/off, RA hands the outputs back at once.
+ */
+typedef struct {
+    char actuator;
+    char op;
+    uint8_t cmd;                    // Actuator_Cmd_t
+    uint16_t max_value;             // 0 when the op takes no value
+} Control_Op_t;
+
+static const Control_Op_t control_ops[] = {
+    { 'B', 'N', ACT_CMD_BUZZER_ON,       0                        },
+    { 'B', 'F', ACT_CMD_BUZZER_OFF,      0                        },
+    { 'B', 'P', ACT_CMD_BUZZER_BEEP,     10000                    },
+    { 'B', 'S', ACT_CMD_BUZZER_PATTERN,  BUZZER_PATTERN_COUNT - 1 },
+    { 'M', 'F', ACT_CMD_MOTOR_FORWARD,   100                      },
+    { 'M', 'R', ACT_CMD_MOTOR_REVERSE,   100                      },
+    { 'M', 'S', ACT_CMD_MOTOR_STOP,      0                        },
+    { 'M', 'B', ACT_CMD_MOTOR_BRAKE,     0                        },
+    { 'M', 'P', ACT_CMD_MOTOR_PROFILE,   MOTOR_PROFILE_COUNT - 1  },
+    { 'R', 'N', CONTROL_CMD_RULES,       0                        },
+    { 'R', 'F', CONTROL_CMD_RULES,       0                        },
+    { 'R', 'A', CONTROL_CMD_RULES,       0                        },
+};
+
+typedef struct {
+    uint16_t msg_id;
+    char status;                    // 'K' ok, 'E' invalid, 'Q' queue full
+    uint8_t index;                  // 1-based command the status refers to
+} Control_Ack_t;
+
+static Control_Ack_t control_acks[CONTROL_ACK_SLOTS];
+static uint8_t control_ack_count = 0;
+
+static const Control_Op_t* control_lookup(char actuator, char op)
+{
+    for (uint8_t i = 0; i < sizeof(control_ops) / sizeof(control_ops[0]); i++) {
+        if (control_ops[i].actuator == actuator && control_ops[i].op == op) {
+            return &control_ops[i];
+        }
+    }
+    return NULL;
+}
+
+static void control_ack(uint16_t msg_id, char status, uint8_t index)
+{
+    // more frames than slots before the next publish: the extra acks are lost
+    if (control_ack_count < CONTROL_ACK_SLOTS) {
+        control_acks[control_ack_count].msg_id = msg_id;
+        control_acks[control_ack_count].status = status;
+        control_acks[control_ack_count].index = index;
+        control_ack_count++;
+    }
+}
+
+/**
+ * \brief    Decode a control frame and queue its commands
+ * \note     The whole frame is validated before the first command is queued
+ */
+static void control_handle_frame(const char* data, uint16_t len)
+{
+    const char* p = data;
+    const char* end = data + len;
+    const Control_Op_t* ops[CONTROL_MAX_BATCH];
+    uint16_t values[CONTROL_MAX_BATCH];
+    uint8_t count = 0;
+    uint32_t msg_id = 0;
+
+    // message id, frames without one cannot be acked and are dropped
+    if (p == end || *p < '0' || *p > '9') {
+        return;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        msg_id = msg_id * 10 + (*p++ - '0');
+    }
+    if (p == end || *p++ != ':' || msg_id > 0xFFFF) {
+        return;
+    }
+
+    while (p < end) {
+        uint32_t value = 0;
+
+        if (count == CONTROL_MAX_BATCH || end - p < 2 ||
+            (ops[count] = control_lookup(p[0], p[1])) == NULL) {
+            control_ack((uint16_t)msg_id, 'E', count + 1);
+            return;
+        }
+        p += 2;
+        while (p < end && *p >= '0' && *p <= '9' && value <= 0xFFFF) {
+            value = value * 10 + (*p++ - '0');
+        }
+        if (value > ops[count]->max_value || (p < end && *p++ != ';')) {
+            control_ack((uint16_t)msg_id, 'E', count + 1);
+            return;
+        }
+        values[count++] = (uint16_t)value;
+    }
+    if (count == 0) {
+        control_ack((uint16_t)msg_id, 'E', 1);
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (ops[i]->cmd == CONTROL_CMD_RULES) {
+            if (ops[i]->op == 'A') {
+                Rules_Resume();
+            } else {
+                Rules_Enable(ops[i]->op == 'N');
+            }
+            continue;
+        }
+        if (!Actuator_Submit((Actuator_Cmd_t)ops[i]->cmd, values[i])) {
+            control_ack((uint16_t)msg_id, 'Q', i + 1);
+            return;
+        }
+        Rules_Override(ops[i]->actuator == 'M' ? RULE_OUT_MOTOR : RULE_OUT_BUZZER);
+    }
+    control_ack((uint16_t)msg_id, 'K', count);
+}
+
+/**
+ * \brief    Publish the acks collected since the last call in one message
+ * \note     The actuator task has higher priority, so by now the acked
+ *           commands have been executed, not only queued
+ */
+static void control_publish_acks(void)
+{
+    char msg[128];
+    int pos = 0;
+
+    for (uint8_t i = 0; i < control_ack_count && pos < (int)sizeof(msg) - 12; i++) {
+        if (control_acks[i].status == 'K') {
+            pos += snprintf(&msg[pos], sizeof(msg) - pos, "%s%u:OK", i ? ";" : "", control_acks[i].msg_id);
+        } else {
+            pos += snprintf(&msg[pos], sizeof(msg) - pos, "%s%u:%c%u", i ? ";" : "",
+                            control_acks[i].msg_id, control_acks[i].status, control_acks[i].index);
+        }
+    }
+    control_ack_count = 0;
+    ESP8266_PublishMQTT(MQTT_ACK_TOPIC, msg, 0, 0);
+}
+
+/**
+ * \brief    MQTT message callback, runs as soon as the +MQTTSUBRECV line is in
+ * \note     Called from inside ESP8266 driver calls, so it only queues the
+ *           commands; acks are published later from the modem loop
+ */
+static void on_mqtt_message(const char* topic, const char* data, uint16_t len)
+{
+    if (strcmp(topic, RULES_TOPIC_DATA) == 0) {
+        Rules_HandleData(data, len, ESP8266_GetLineStamp());
+        return;
+    }
+    if (strcmp(topic, MQTT_SUB_TOPIC) != 0 || len == 0) {
+        return;
+    }
+
+    // legacy single character command
+    if (len == 1) {
+        if (data[0] == '0') {
+            Actuator_Submit(ACT_CMD_BUZZER_OFF, 0);
+            Rules_Override(RULE_OUT_BUZZER);
+            control_ack_pending = 1;
+        }
+        else if (data[0] == '1') {
+            Actuator_Submit(ACT_CMD_BUZZER_ON, 0);
+            Rules_Override(RULE_OUT_BUZZER);
+            control_ack_pending = 1;
+        }
+        return;
+    }
+
+    control_handle_frame(data, len);
+}
+
+/**
+ * \brief    Wake the modem task when the USART2 interrupt completes a line
+ */
+void ESP8266_RxLineCallback(void)
+{
+    if (ModemTaskHandle != NULL) {
+        osSignalSet(ModemTaskHandle, MODEM_SIGNAL_RX_LINE);
+    }
+}
+
+/**
+ * \brief    Online status with the actuator command timing
+ * \note     React is sample receipt to rule command executed, RuleSample the
+ *           sensor's Updatetime of the last sample evaluated
+ */
+static void publish_status(void)
+{
+    Actuator_Stats_t stats;
+    char msg[288];
+
+    Actuator_GetStats(&stats);
+    snprintf(msg, sizeof(msg), "Status:Online_Device:%s_Cmds:%lu_Dropped:%lu_QueueUs:%lu_QueueMaxUs:%lu_ExecUs:%lu_ExecMaxUs:%lu"
+             "_Rules:%u_RuleCmds:%lu_ReactUs:%lu_ReactMaxUs:%lu_RuleSample:%lu_RxDropped:%lu",
+             MQTT_CLIENT_ID,
+             (unsigned long)stats.executed,
+             (unsigned long)stats.dropped,
+             (unsigned long)stats.queue_us_last,
+             (unsigned long)stats.queue_us_max,
+             (unsigned long)stats.exec_us_last,
+             (unsigned long)stats.exec_us_max,
+             Rules_IsEnabled(),
+             (unsigned long)stats.rule_executed,
+             (unsigned long)stats.react_us_last,
+             (unsigned long)stats.react_us_max,
+             (unsigned long)Rules_GetSampleTime(),
+             (unsigned long)ESP8266_GetRxDropped());
+    ESP8266_PublishMQTT(MQTT_PUB_TOPIC, msg, 0, 0);
+}
+
+/* USER CODE BEGIN Header_StartModemTask */
+/**
+* @brief Function implementing the ModemTask thread.
+* @param argument: Not used
+* @retval None
+*/
+/* USER CODE END Header_StartModemTask */
+void StartModemTask(void const * argument)
+{
+    /* USER CODE BEGIN StartModemTask */
+    static uint32_t last_publish = 0;
+    uint32_t now;
+
+    ESP8266_SetMessageHandler(on_mqtt_message);
+    Rules_Init();
+
+    //ESP8266 Init, retried: the actuator keeps working without the network
+    while (ESP8266_Init() != ESP8266_OK) {
+        g_modem_heartbeat = HAL_GetTick();
+        osDelay(WIFI_RECONNECT_DELAY_MS);
+    }
+    g_modem_heartbeat = HAL_GetTick();
+
+    //ESP8266 Connect WiFi
+    if (ESP8266_ConnectWiFi(WIFI_SSID, WIFI_PASSWORD) == ESP8266_OK) {
+        Actuator_Submit(ACT_CMD_BUZZER_BEEP, 300);
+    }
+
+    /* Infinite loop */
+    for(;;)
+    {
+        now = HAL_GetTick();
+        g_modem_heartbeat = now;
+
+        // control messages and link loss URCs queued by the USART2 interrupt
+        ESP8266_Process();
+        Rules_Poll();
+
+        // WiFi state detect and reconnect, only after a disconnect was reported
+        if (ESP8266_GetWiFiState() != WIFI_CONNECTED)
+        {
+            if (now - last_wifi_reconnect > WIFI_RECONNECT_DELAY_MS)
+            {
+                if (ESP8266_GetWiFiStatus() != WIFI_CONNECTED &&
+                    ESP8266_ConnectWiFi(WIFI_SSID, WIFI_PASSWORD) == ESP8266_OK)
+                {
+                    Actuator_Submit(ACT_CMD_BUZZER_BEEP, 200);
+                }
+                last_wifi_reconnect = now;
+            }
+        }
+        else
+        {
+            // MQTT state detect and reconnect
+            if (ESP8266_GetMQTTStatus() != MQTT_CONNECTED)
+            {
+                if (now - last_mqtt_reconnect > MQTT_RECONNECT_DELAY_MS)
+                {
+                    if (ESP8266_ConnectMQTT(MQTT_SERVER, MQTT_PORT, MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD) == ESP8266_OK)
+                    {
+                        ESP8266_SubscribeMQTT(MQTT_SUB_TOPIC, 0);
+                        rules_subscribed = 0;
+                        Actuator_Submit(ACT_CMD_BUZZER_BEEP, 200);
+                    }
+                    else
+                    {
+                        // drop the old session so the next MQTTCONN starts clean
+                        ESP8266_DisconnectMQTT();
+                    }
+                    last_mqtt_reconnect = now;
+                }
+            }
+            else
+            {
+                // the sensor's own publish feeds the edge rules, subscribed once enabled
+                if (Rules_IsEnabled() && !rules_subscribed &&
+                    ESP8266_SubscribeMQTT(RULES_TOPIC_DATA, 0) == ESP8266_OK)
+                {
+                    rules_subscribed = 1;
+                }
+                // acknowledge the commands queued by on_mqtt_message()
+                if (control_ack_count > 0)
+                {
+                    control_publish_acks();
+                }
+                if (control_ack_pending)
+                {
+                    control_ack_pending = 0;
+                    ESP8266_PublishMQTT(MQTT_PUB_TOPIC, "received", 0, 0);
+                }
+                // every 15s publish online status
+                if (now - last_publish > 15000)
+                {
+                    publish_status();
+                    last_publish = now;
+                }
+            }
+        }
+
+        // sleep until the USART2 interrupt completes a line
+        osSignalWait(MODEM_SIGNAL_RX_LINE, MODEM_IDLE_WAIT);
+    }
+    /* USER CODE END StartModemTask */
+}
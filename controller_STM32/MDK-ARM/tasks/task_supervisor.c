@@ -0,0 +1,38 @@
+#include "main.h"
+#include "tasks.h"
+#include "hardware.h"
+
+#define SUPERVISOR_PERIOD_MS        1000
+#define ACTUATOR_DEADLINE_MS        3000    // idle loop passes every 500 ms
+#define MODEM_DEADLINE_MS           60000   // a WiFi connect alone can take 26 s
+
+/* USER CODE BEGIN Header_StartSupervisorTask */
+/**
+* @brief Function implementing the SupervisorTask thread.
+* @param argument: Not used
+* @retval None
+*/
+/* USER CODE END Header_StartSupervisorTask */
+void StartSupervisorTask(void const * argument)
+{
+    /* USER CODE BEGIN StartSupervisorTask */
+    uint32_t now;
+
+    // about 26 s at LSI 40 kHz, /256, reload 4095
+    MX_IWDG_Init();
+
+    /* Infinite loop */
+    for(;;)
+    {
+        now = HAL_GetTick();
+
+        // A task that stops making progress stops the refresh and the IWDG resets the node
+        if(now - g_actuator_heartbeat < ACTUATOR_DEADLINE_MS &&
+           now - g_modem_heartbeat < MODEM_DEADLINE_MS)
+        {
+            HAL_IWDG_Refresh(&hiwdg);
+        }
+        osDelay(SUPERVISOR_PERIOD_MS);
+    }
+    /* USER CODE END StartSupervisorTask */
+}
@@ -0,0 +1,98 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "main.h"
+#include "cmsis_os.h"
+
+// Task handles
+extern osThreadId ModemTaskHandle;
+extern osThreadId ActuatorTaskHandle;
+extern osThreadId SupervisorTaskHandle;
+
+// Queue handles
+extern osMailQId ActuatorQueueHandle;
+
+// Task function prototypes
+void StartModemTask(void const * argument);
+void StartActuatorTask(void const * argument);
+void StartSupervisorTask(void const * argument);
+
+// Modem task signals
+#define MODEM_SIGNAL_RX_LINE        0x01    // a line ended in the ESP8266 receive ring
+
+// Actuator commands, executed in queue order by the actuator task
+typedef enum {
+    ACT_CMD_BUZZER_OFF = 0,
+    ACT_CMD_BUZZER_ON,
+    ACT_CMD_BUZZER_BEEP,                    // arg: duration in ms
+    ACT_CMD_MOTOR_FORWARD,                  // arg: duty in percent, soft start
+    ACT_CMD_MOTOR_REVERSE,                  // arg: duty in percent, soft start
+    ACT_CMD_MOTOR_STOP,                     // coast, driver in standby
+    ACT_CMD_MOTOR_BRAKE,                    // short brake
+    ACT_CMD_BUZZER_PATTERN,                 // arg: Buzzer_Pattern_t
+    ACT_CMD_MOTOR_PROFILE                   // arg: Motor_Profile_t, keeps the direction
+} Actuator_Cmd_t;
+
+// Step tables run by the TIM4 pattern engine
+typedef enum {
+    BUZZER_PATTERN_ACK = 0,                 // two short beeps
+    BUZZER_PATTERN_ERROR,                   // three long beeps
+    BUZZER_PATTERN_ALARM,                   // repeats until ACT_CMD_BUZZER_OFF
+    BUZZER_PATTERN_COUNT
+} Buzzer_Pattern_t;
+
+typedef enum {
+    MOTOR_PROFILE_SOFT_START = 0,           // slow ramp to 60 %
+    MOTOR_PROFILE_KICK_START,               // full duty to break away, settle at 40 %
+    MOTOR_PROFILE_SWEEP,                    // 30..80 % back and forth until changed
+    MOTOR_PROFILE_COUNT
+} Motor_Profile_t;
+
+typedef struct {
+    uint8_t cmd;                            // Actuator_Cmd_t
+    uint8_t from_rule;                      // issued by the edge rules, not a person
+    uint16_t arg;
+    uint32_t queued_at;                     // DWT->CYCCNT at submit, sample receipt for rules
+} Actuator_Command_t;
+
+typedef struct {
+    uint32_t executed;
+    uint32_t dropped;                       // queue full at submit
+    uint32_t queue_us_last;                 // submit to start of execution
+    uint32_t queue_us_max;
+    uint32_t exec_us_last;
+    uint32_t exec_us_max;
+    uint32_t rule_executed;
+    uint32_t react_us_last;                 // sensor/data line received to rule command executed
+    uint32_t react_us_max;
+} Actuator_Stats_t;
+
+#define ACTUATOR_QUEUE_LEN          8
+
+uint8_t Actuator_Submit(Actuator_Cmd_t cmd, uint16_t arg);
+uint8_t Actuator_SubmitRule(Actuator_Cmd_t cmd, uint16_t arg, uint32_t received_at);
+void Actuator_GetStats(Actuator_Stats_t* stats);
+
+// Edge rules on sensor/data, run in the modem task only
+#define RULES_TOPIC_DATA            "sensor/data"
+
+typedef enum {
+    RULE_OUT_BUZZER = 0,
+    RULE_OUT_MOTOR,
+    RULE_OUT_COUNT
+} Rule_Output_t;
+
+void Rules_Init(void);
+void Rules_Enable(uint8_t enable);
+uint8_t Rules_IsEnabled(void);
+void Rules_HandleData(const char* data, uint16_t len, uint32_t received_at);
+void Rules_Poll(void);
+void Rules_Override(Rule_Output_t output);
+void Rules_Resume(void);
+uint32_t Rules_GetSampleTime(void);
+
+// Heartbeats checked by the supervisor, HAL tick of each task's last loop pass
+extern volatile uint32_t g_modem_heartbeat;
+extern volatile uint32_t g_actuator_heartbeat;
+
+#endif
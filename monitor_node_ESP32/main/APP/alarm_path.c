@@ -0,0 +1,145 @@
+#include "alarm_path.h"
+#include "esp_timer.h"
+#include <string.h>
+
+/*
+ * Alarms skip the regular display path (batched data handler frame, read
+ * by the 1 s UI timer). The parser reports every sample's alarm flag; a
+ * change is stored as the pending event and the LVGL task is notified,
+ * which wakes it from its frame delay to draw the overlay. Per device
+ * state is one bit per registry slot, the last bit stands for the single
+ * node seen when there is no registry.
+ */
+#define ALARM_PATH_SLOTS (DEVICE_REGISTRY_CAPACITY + 1)
+
+static uint32_t alarm_bits[(ALARM_PATH_SLOTS + 31) / 32];
+static int active_devices = 0;
+static alarm_event_t pending;
+static bool pending_set = false;
+static TaskHandle_t ui_task = NULL;
+static alarm_path_stats_t stats;
+static uint64_t latency_us_total = 0;
+static portMUX_TYPE alarm_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void alarm_path_register_ui_task(TaskHandle_t task)
+{
+	ui_task = task;
+}
+
+bool alarm_path_report(int slot, const char *id, int id_len, int alarm, int64_t received_us)
+{
+	int bit = (slot >= 0 && slot < DEVICE_REGISTRY_CAPACITY) ? slot : DEVICE_REGISTRY_CAPACITY;
+	uint32_t mask = 1u << (bit % 32);
+	bool was = (alarm_bits[bit / 32] & mask) != 0;
+
+	// the common case, nothing changed, costs one load
+	if (was == (alarm != 0))
+	{
+		return false;
+	}
+	if (id_len > DEVICE_ID_LEN - 1)
+	{
+		id_len = DEVICE_ID_LEN - 1;
+	}
+
+	taskENTER_CRITICAL(&alarm_lock);
+	if (alarm)
+	{
+		alarm_bits[bit / 32] |= mask;
+		active_devices++;
+		stats.raised++;
+	}
+	else
+	{
+		alarm_bits[bit / 32] &= ~mask;
+		active_devices--;
+		stats.cleared++;
+	}
+	// a raise the UI has not taken yet is kept, a later clear must not hide it
+	if (alarm || !(pending_set && pending.raised))
+	{
+		memcpy(pending.device_id, id, id_len);
+		pending.device_id[id_len] = '\0';
+		pending.raised = alarm != 0;
+		pending.transient = false;
+	}
+	pending.active_devices = active_devices;
+	pending.received_us = received_us;
+	pending_set = true;
+	taskEXIT_CRITICAL(&alarm_lock);
+
+	if (ui_task != NULL)
+	{
+		xTaskNotifyGive(ui_task);
+	}
+	return true;
+}
+
+void alarm_path_report_transient(const char *id, int id_len, int64_t received_us)
+{
+	if (id_len > DEVICE_ID_LEN - 1)
+	{
+		id_len = DEVICE_ID_LEN - 1;
+	}
+
+	taskENTER_CRITICAL(&alarm_lock);
+	stats.raised++;
+	stats.cleared++;
+	memcpy(pending.device_id, id, id_len);
+	pending.device_id[id_len] = '\0';
+	pending.raised = true;
+	pending.transient = true;
+	pending.active_devices = active_devices;
+	pending.received_us = received_us;
+	pending_set = true;
+	taskEXIT_CRITICAL(&alarm_lock);
+
+	if (ui_task != NULL)
+	{
+		xTaskNotifyGive(ui_task);
+	}
+}
+
+bool alarm_path_take(alarm_event_t *event)
+{
+	bool taken = false;
+
+	// checked every UI loop, skip the lock while nothing is pending
+	if (!__atomic_load_n(&pending_set, __ATOMIC_ACQUIRE))
+	{
+		return false;
+	}
+	taskENTER_CRITICAL(&alarm_lock);
+	if (pending_set)
+	{
+		*event = pending;
+		pending_set = false;
+		taken = true;
+	}
+	taskEXIT_CRITICAL(&alarm_lock);
+	return taken;
+}
+
+uint32_t alarm_path_shown(const alarm_event_t *event)
+{
+	uint32_t latency_us = (uint32_t)(esp_timer_get_time() - event->received_us);
+
+	taskENTER_CRITICAL(&alarm_lock);
+	stats.shown++;
+	stats.latency_us_last = latency_us;
+	latency_us_total += latency_us;
+	if (latency_us > stats.latency_us_max)
+	{
+		stats.latency_us_max = latency_us;
+	}
+	taskEXIT_CRITICAL(&alarm_lock);
+	return latency_us;
+}
+
+void alarm_path_get_stats(alarm_path_stats_t *out)
+{
+	taskENTER_CRITICAL(&alarm_lock);
+	*out = stats;
+	out->latency_us_avg = stats.shown ? (uint32_t)(latency_us_total / stats.shown) : 0;
+	taskEXIT_CRITICAL(&alarm_lock);
+}
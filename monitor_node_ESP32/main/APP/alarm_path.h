@@ -0,0 +1,84 @@
+#ifndef __ALARM_PATH_H
+#define __ALARM_PATH_H
+
+#include "esp_err.h"
+#include "device_registry.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Alarm change handed to the UI */
+typedef struct
+{
+	char device_id[DEVICE_ID_LEN]; /* device whose alarm changed last */
+	bool raised;				   /* that device's alarm went 0 -> 1 */
+	bool transient;				   /* raised and cleared between two reports, shown until acknowledged */
+	int active_devices;			   /* devices in alarm now, 0 clears the overlay */
+	int64_t received_us;		   /* MQTT receipt of the message, esp_timer_get_time() */
+} alarm_event_t;
+
+/* Alarm counters and receipt to pixel latency */
+typedef struct
+{
+	uint32_t raised;  /* 0 -> 1 transitions */
+	uint32_t cleared; /* 1 -> 0 transitions */
+	uint32_t shown;	  /* events drawn by the UI */
+	uint32_t latency_us_last;
+	uint32_t latency_us_max;
+	uint32_t latency_us_avg;
+} alarm_path_stats_t;
+
+/* Function declarations */
+
+/**
+ * @brief Set the task woken when an alarm changes, the LVGL task
+ * @param task Task waiting in ulTaskNotifyTake()
+ */
+void alarm_path_register_ui_task(TaskHandle_t task);
+
+/**
+ * @brief Report a device's alarm flag, called by the parser for every sample
+ * Only changes are passed on; a change wakes the UI task at once instead of
+ * waiting for the display timer. MQTT pipeline worker only.
+ * @param slot Registry slot of the device, -1 without a registry
+ * @param id Device id, need not be '\0' terminated
+ * @param id_len Id length
+ * @param alarm Alarm flag of the sample
+ * @param received_us Receipt of the message, mqtt_pipeline_received_us()
+ * @retval true The alarm state changed
+ */
+bool alarm_path_report(int slot, const char *id, int id_len, int alarm, int64_t received_us);
+
+/**
+ * @brief Report an alarm that rose and cleared again between two reports,
+ * e.g. inside one sample batch, which alarm_path_report() alone would not
+ * see. The device's alarm state is left as it is. MQTT pipeline worker only.
+ * @param id Device id, need not be '\0' terminated
+ * @param id_len Id length
+ * @param received_us Receipt of the message, mqtt_pipeline_received_us()
+ */
+void alarm_path_report_transient(const char *id, int id_len, int64_t received_us);
+
+/**
+ * @brief Take the newest alarm change, UI task only
+ * Changes the UI has not taken yet collapse into one, keeping a raise
+ * @param event Output
+ * @retval true A change was pending
+ */
+bool alarm_path_take(alarm_event_t *event);
+
+/**
+ * @brief Record that an event is on the screen
+ * @param event Event from alarm_path_take(), after its frame was flushed
+ * @retval Receipt to pixel latency (us)
+ */
+uint32_t alarm_path_shown(const alarm_event_t *event);
+
+/**
+ * @brief Get alarm counters and latency
+ * @param stats Output
+ */
+void alarm_path_get_stats(alarm_path_stats_t *stats);
+
+#endif /* __ALARM_PATH_H */
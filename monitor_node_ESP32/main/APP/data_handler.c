@@ -2,16 +2,28 @@
 #include "data_handler.h"
 #include "mqtt_manager.h"
 #include "esp_log.h"
+#include "log_ring.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include <string.h>
 
 static const char *TAG = "DATA_HANDLER";
 
-/* Data caching and synchronization */
+/*
+ * display_data is written by one task and read lock free. display_seq is
+ * odd while a write is in progress; readers copy the whole frame and retry
+ * if the sequence moved. The write runs in a critical section so a reader
+ * on the same core can never preempt it halfway and spin.
+ */
 static sensor_display_data_t display_data = {0};
-static SemaphoreHandle_t data_mutex = NULL;
+static uint32_t display_seq = 0;
 static bool data_updated = false;
+static portMUX_TYPE data_write_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Batch state, only the writer task touches it */
+static bool batch_open = false;
+static bool batch_pending = false;
+static sensor_display_data_t batch_frame;
 
 /* LVGL update callback function pointer */
 static ui_update_callback_t ui_update_callback = NULL;
@@ -21,23 +33,13 @@ static ui_update_callback_t ui_update_callback = NULL;
  */
 esp_err_t data_handler_init(void)
 {
-	// Create data protection mutex
-	data_mutex = xSemaphoreCreateMutex();
-	if (data_mutex == NULL)
-	{
-		// ESP_LOGE(TAG, "Failed to create data mutex");
-		return ESP_FAIL;
-	}
-
 	// Initialize display data to default values
-	display_data.temperature = 0;
-	display_data.humidity = 0;
-	display_data.air_quality = 0;
-	display_data.smoke_level = 0;
-	display_data.light_intensity = 0;
-	display_data.device_alarm = 0;
-	display_data.data_valid = false;
-	display_data.last_update = 0;
+	taskENTER_CRITICAL(&data_write_lock);
+	__atomic_store_n(&display_seq, display_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memset(&display_data, 0, sizeof(display_data));
+	__atomic_store_n(&display_seq, display_seq + 1, __ATOMIC_RELEASE);
+	taskEXIT_CRITICAL(&data_write_lock);
 
 	ESP_LOGI(TAG, "Data handler module initialization completed");
 	return ESP_OK;
@@ -53,52 +55,119 @@ void data_handler_register_ui_callback(ui_update_callback_t callback)
 	ESP_LOGI(TAG, "UI update callback registered");
 }
 
+/**
+ * @brief Make a frame visible to readers and notify the UI
+ */
+static void data_handler_publish(const sensor_display_data_t *frame)
+{
+	taskENTER_CRITICAL(&data_write_lock);
+	__atomic_store_n(&display_seq, display_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	display_data = *frame;
+	__atomic_store_n(&display_seq, display_seq + 1, __ATOMIC_RELEASE);
+	taskEXIT_CRITICAL(&data_write_lock);
+	__atomic_store_n(&data_updated, true, __ATOMIC_RELEASE);
+
+	LOG_RING_I(TAG, "Data updated - T:%d°C H:%d%% Air:%dppm Smoke:%dppm Light:%dlux Alarm:%d",
+			   frame->temperature, frame->humidity,
+			   frame->air_quality, frame->smoke_level,
+			   frame->light_intensity, frame->device_alarm);
+
+	// Notify UI update
+	if (ui_update_callback)
+	{
+		ui_update_callback();
+	}
+}
+
 /**
  * @brief Process new sensor data from MQTT
  * @param mqtt_data Sensor data received from MQTT
  */
 void data_handler_process_mqtt_data(const sensor_data_t *mqtt_data)
 {
+	sensor_display_data_t frame;
+
 	if (mqtt_data == NULL)
 	{
 		return;
 	}
 
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
+	// Build the frame first, the critical section only copies it
+	frame.temperature = (int)(mqtt_data->temperature + 0.5f); // Round to nearest integer
+	frame.humidity = (int)(mqtt_data->humidity + 0.5f);
+	frame.air_quality = mqtt_data->air_quality;
+	frame.smoke_level = mqtt_data->smoke_level;
+	frame.light_intensity = mqtt_data->light_intensity;
+	frame.device_alarm = mqtt_data->device_alarm;
+	frame.data_valid = true;
+	frame.last_update = esp_timer_get_time() / 1000; // Convert to milliseconds
+
+	if (batch_open)
+	{
+		// a later sample of the same batch replaces this one
+		batch_frame = frame;
+		batch_pending = true;
+		return;
+	}
+	data_handler_publish(&frame);
+}
+
+/**
+ * @brief Start collecting samples, published together by data_handler_end_batch()
+ */
+void data_handler_begin_batch(void)
+{
+	batch_open = true;
+	batch_pending = false;
+}
+
+/**
+ * @brief Publish the newest sample of the batch, one write and one UI notification
+ */
+void data_handler_end_batch(void)
+{
+	batch_open = false;
+	if (batch_pending)
 	{
-		// Update display data
-		display_data.temperature = (int)(mqtt_data->temperature + 0.5f); // Round to nearest integer
-		display_data.humidity = (int)(mqtt_data->humidity + 0.5f);
-		display_data.air_quality = mqtt_data->air_quality;
-		display_data.smoke_level = mqtt_data->smoke_level;
-		display_data.light_intensity = mqtt_data->light_intensity;
-		display_data.device_alarm = mqtt_data->device_alarm;
-		display_data.data_valid = true;
-		display_data.last_update = esp_timer_get_time() / 1000; // Convert to milliseconds
-
-		data_updated = true;
-
-		xSemaphoreGive(data_mutex);
-
-		ESP_LOGI(TAG, "Data updated - T:%d°C H:%d%% Air:%dppm Smoke:%dppm Light:%dlux Alarm:%d",
-				 display_data.temperature, display_data.humidity,
-				 display_data.air_quality, display_data.smoke_level,
-				 display_data.light_intensity, display_data.device_alarm);
-
-		// Notify UI update
-		if (ui_update_callback)
-		{
-			ui_update_callback();
-		}
+		batch_pending = false;
+		data_handler_publish(&batch_frame);
 	}
-	else
+}
+
+/**
+ * @brief Get one consistent display frame, lock free
+ * @param data Output data structure pointer
+ */
+void data_handler_get_snapshot(sensor_display_data_t *data)
+{
+	uint32_t before;
+	uint32_t after;
+
+	do
 	{
-		ESP_LOGW(TAG, "Cannot acquire data lock, data update skipped");
+		before = __atomic_load_n(&display_seq, __ATOMIC_ACQUIRE);
+		memcpy(data, &display_data, sizeof(*data));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&display_seq, __ATOMIC_RELAXED);
+	} while ((before & 1) || before != after);
+}
+
+/**
+ * @brief Age of a frame (milliseconds), 0 if it holds no data yet
+ * @param data Frame from data_handler_get_snapshot()
+ */
+uint64_t data_handler_snapshot_age(const sensor_display_data_t *data)
+{
+	if (data->last_update == 0)
+	{
+		return 0;
 	}
+	return esp_timer_get_time() / 1000 - data->last_update;
 }
 
 /**
- * @brief Get current display data (thread-safe)
+ * @brief Get current display data (thread-safe, same as data_handler_get_snapshot)
  * @param data Output data structure pointer
  * @retval true Get success, false Get failure
  */
@@ -109,14 +178,8 @@ bool data_handler_get_display_data(sensor_display_data_t *data)
 		return false;
 	}
 
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(50)) == pdTRUE)
-	{
-		memcpy(data, &display_data, sizeof(sensor_display_data_t));
-		xSemaphoreGive(data_mutex);
-		return true;
-	}
-
-	return false;
+	data_handler_get_snapshot(data);
+	return true;
 }
 
 /**
@@ -124,13 +187,10 @@ bool data_handler_get_display_data(sensor_display_data_t *data)
  */
 int data_handler_get_temperature(void)
 {
-	int value = 25; // Default value
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		value = display_data.temperature;
-		xSemaphoreGive(data_mutex);
-	}
-	return value;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.temperature;
 }
 
 /**
@@ -138,13 +198,10 @@ int data_handler_get_temperature(void)
  */
 int data_handler_get_humidity(void)
 {
-	int value = 50; // Default value
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		value = display_data.humidity;
-		xSemaphoreGive(data_mutex);
-	}
-	return value;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.humidity;
 }
 
 /**
@@ -152,13 +209,10 @@ int data_handler_get_humidity(void)
  */
 int data_handler_get_air_quality(void)
 {
-	int value = 200; // Default value
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		value = display_data.air_quality;
-		xSemaphoreGive(data_mutex);
-	}
-	return value;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.air_quality;
 }
 
 /**
@@ -166,13 +220,10 @@ int data_handler_get_air_quality(void)
  */
 int data_handler_get_smoke_level(void)
 {
-	int value = 10; // Default value
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		value = display_data.smoke_level;
-		xSemaphoreGive(data_mutex);
-	}
-	return value;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.smoke_level;
 }
 
 /**
@@ -180,13 +231,10 @@ int data_handler_get_smoke_level(void)
  */
 int data_handler_get_light_intensity(void)
 {
-	int value = 500; // Default value
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		value = display_data.light_intensity;
-		xSemaphoreGive(data_mutex);
-	}
-	return value;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.light_intensity;
 }
 
 /**
@@ -194,13 +242,10 @@ int data_handler_get_light_intensity(void)
  */
 bool data_handler_get_alarm_status(void)
 {
-	bool alarm = false;
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		alarm = (display_data.device_alarm != 0);
-		xSemaphoreGive(data_mutex);
-	}
-	return alarm;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.device_alarm != 0;
 }
 
 /**
@@ -208,13 +253,10 @@ bool data_handler_get_alarm_status(void)
  */
 bool data_handler_is_data_valid(void)
 {
-	bool valid = false;
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		valid = display_data.data_valid;
-		xSemaphoreGive(data_mutex);
-	}
-	return valid;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.data_valid;
 }
 
 /**
@@ -222,17 +264,8 @@ bool data_handler_is_data_valid(void)
  */
 bool data_handler_check_update(void)
 {
-	bool updated = false;
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		updated = data_updated;
-		if (updated)
-		{
-			data_updated = false; // Clear update flag
-		}
-		xSemaphoreGive(data_mutex);
-	}
-	return updated;
+	// Clear update flag
+	return __atomic_exchange_n(&data_updated, false, __ATOMIC_ACQ_REL);
 }
 
 /**
@@ -240,17 +273,10 @@ bool data_handler_check_update(void)
  */
 uint64_t data_handler_get_data_age(void)
 {
-	uint64_t age = 0;
-	if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE)
-	{
-		uint64_t now = esp_timer_get_time() / 1000;
-		if (display_data.last_update > 0)
-		{
-			age = now - display_data.last_update;
-		}
-		xSemaphoreGive(data_mutex);
-	}
-	return age;
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return data_handler_snapshot_age(&frame);
 }
 
 /**
@@ -260,5 +286,8 @@ uint64_t data_handler_get_data_age(void)
  */
 bool data_handler_is_data_fresh(uint32_t timeout_ms)
 {
-	return (data_handler_get_data_age() < timeout_ms) && data_handler_is_data_valid();
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
+	return frame.data_valid && data_handler_snapshot_age(&frame) < timeout_ms;
 }
\ No newline at end of file
@@ -41,6 +41,32 @@ void data_handler_register_ui_callback(ui_update_callback_t callback);
  */
 void data_handler_process_mqtt_data(const sensor_data_t *mqtt_data);
 
+/**
+ * @brief Start a batch, samples processed until data_handler_end_batch()
+ * are published together (writer task only)
+ */
+void data_handler_begin_batch(void);
+
+/**
+ * @brief End a batch, the newest sample becomes visible and the UI is notified once
+ */
+void data_handler_end_batch(void);
+
+/**
+ * @brief Get one consistent display frame, lock free
+ * Never blocks the writer, a frame being written is retried. Take one
+ * frame per UI tick instead of calling the single value getters.
+ * @param data Output data structure pointer
+ */
+void data_handler_get_snapshot(sensor_display_data_t *data);
+
+/**
+ * @brief Age of a frame (time since its update)
+ * @param data Frame from data_handler_get_snapshot()
+ * @retval Frame age (milliseconds), 0 if it holds no data yet
+ */
+uint64_t data_handler_snapshot_age(const sensor_display_data_t *data);
+
 /**
  * @brief Get current display data (thread-safe)
  * @param data Output data structure pointer
@@ -0,0 +1,248 @@
+#include "device_registry.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "DEVICE_REGISTRY";
+
+/*
+ * Open addressing with linear probing, keyed by device id. Devices are
+ * never removed, so a probe can stop at the first empty slot and a slot's
+ * id never changes once it is published.
+ *
+ * The MQTT pipeline worker is the only writer. Each slot carries a sequence number
+ * that is odd while its state is written; readers copy the state and retry
+ * if the number moved. Only plain loads and stores are used, no atomic
+ * read-modify-write, so the table may live in external RAM. The write runs
+ * in a critical section so a reader on the same core cannot preempt it
+ * halfway and spin.
+ */
+typedef struct
+{
+	uint32_t seq;
+	uint32_t hash;
+	uint8_t used;
+	device_state_t state;
+} registry_slot_t;
+
+static registry_slot_t *slots = NULL;
+static int device_count = 0;
+static uint32_t dropped = 0;
+static int selected = -1;
+static portMUX_TYPE registry_write_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief FNV-1a over the id bytes
+ */
+static uint32_t registry_hash(const char *id, int len)
+{
+	uint32_t h = 2166136261u;
+
+	for (int i = 0; i < len; i++)
+	{
+		h = (h ^ (uint8_t)id[i]) * 16777619u;
+	}
+	return h;
+}
+
+/**
+ * @brief Probe for an id
+ * @retval Slot holding the id, or the empty slot ending the probe, -1 if neither
+ */
+static int registry_probe(const char *id, int len, uint32_t hash)
+{
+	uint32_t mask = DEVICE_REGISTRY_CAPACITY - 1;
+	uint32_t i = hash & mask;
+
+	for (int n = 0; n < DEVICE_REGISTRY_CAPACITY; n++, i = (i + 1) & mask)
+	{
+		registry_slot_t *s = &slots[i];
+
+		if (!__atomic_load_n(&s->used, __ATOMIC_ACQUIRE))
+		{
+			return (int)i;
+		}
+		if (s->hash == hash && strncmp(s->state.id, id, len) == 0 && s->state.id[len] == '\0')
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+esp_err_t device_registry_init(void)
+{
+	size_t size = sizeof(registry_slot_t) * DEVICE_REGISTRY_CAPACITY;
+
+	if (slots != NULL)
+	{
+		return ESP_OK;
+	}
+	slots = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	if (slots == NULL)
+	{
+		slots = heap_caps_calloc(1, size, MALLOC_CAP_8BIT);
+	}
+	if (slots == NULL)
+	{
+		ESP_LOGE(TAG, "Cannot allocate %u byte device table", (unsigned)size);
+		return ESP_ERR_NO_MEM;
+	}
+	ESP_LOGI(TAG, "Device table: %d slots, %u bytes", DEVICE_REGISTRY_CAPACITY, (unsigned)size);
+	return ESP_OK;
+}
+
+int device_registry_update(const char *id, int id_len, const sensor_data_t *data, uint32_t update_time)
+{
+	return device_registry_update_run(id, id_len, data, update_time, 1, data->device_alarm, 0);
+}
+
+int device_registry_update_run(const char *id, int id_len, const sensor_data_t *last, uint32_t update_time,
+							   uint32_t samples, int first_alarm, uint32_t alarm_rises)
+{
+	uint32_t hash;
+	uint32_t seq;
+	registry_slot_t *s;
+	int slot;
+
+	if (slots == NULL || id == NULL || id_len <= 0 || id_len >= DEVICE_ID_LEN)
+	{
+		dropped++;
+		return -1;
+	}
+
+	hash = registry_hash(id, id_len);
+	slot = registry_probe(id, id_len, hash);
+	if (slot < 0)
+	{
+		dropped++;
+		return -1;
+	}
+	s = &slots[slot];
+
+	if (!s->used)
+	{
+		if (device_count >= DEVICE_REGISTRY_MAX_LOAD)
+		{
+			dropped++;
+			ESP_LOGW(TAG, "Device table full, %.*s ignored", id_len, id);
+			return -1;
+		}
+		// fill in the new slot, then publish it
+		memset(&s->state, 0, sizeof(s->state));
+		memcpy(s->state.id, id, id_len);
+		s->state.first_seen = esp_timer_get_time() / 1000;
+		s->hash = hash;
+		s->seq = 0;
+		__atomic_store_n(&s->used, 1, __ATOMIC_RELEASE);
+		device_count++;
+		ESP_LOGI(TAG, "New device %s, %d known", s->state.id, device_count);
+	}
+
+	taskENTER_CRITICAL(&registry_write_lock);
+	seq = s->seq;
+	__atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	// the run's first sample continues from the stored state
+	if (first_alarm && !s->state.data.device_alarm)
+	{
+		s->state.alarms++;
+	}
+	s->state.alarms += alarm_rises;
+	s->state.data = *last;
+	s->state.update_time = update_time;
+	s->state.messages += samples;
+
+	__atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+	taskEXIT_CRITICAL(&registry_write_lock);
+	return slot;
+}
+
+int device_registry_find(const char *id, int id_len)
+{
+	int slot;
+
+	if (slots == NULL || id == NULL || id_len <= 0 || id_len >= DEVICE_ID_LEN)
+	{
+		return -1;
+	}
+	slot = registry_probe(id, id_len, registry_hash(id, id_len));
+	return (slot >= 0 && __atomic_load_n(&slots[slot].used, __ATOMIC_ACQUIRE)) ? slot : -1;
+}
+
+bool device_registry_get(int slot, device_state_t *state)
+{
+	registry_slot_t *s;
+	uint32_t before;
+	uint32_t after;
+
+	if (slots == NULL || slot < 0 || slot >= DEVICE_REGISTRY_CAPACITY)
+	{
+		return false;
+	}
+	s = &slots[slot];
+	if (!__atomic_load_n(&s->used, __ATOMIC_ACQUIRE))
+	{
+		return false;
+	}
+
+	do
+	{
+		before = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		memcpy(state, &s->state, sizeof(*state));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+	} while ((before & 1) || before != after);
+	return true;
+}
+
+int device_registry_next(int slot)
+{
+	if (slots == NULL)
+	{
+		return -1;
+	}
+	for (int i = slot + 1; i < DEVICE_REGISTRY_CAPACITY; i++)
+	{
+		if (__atomic_load_n(&slots[i].used, __ATOMIC_ACQUIRE))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool device_registry_is_fresh(int slot, uint32_t timeout_ms)
+{
+	device_state_t state;
+
+	if (!device_registry_get(slot, &state))
+	{
+		return false;
+	}
+	return (uint64_t)(esp_timer_get_time() / 1000) - state.data.timestamp < timeout_ms;
+}
+
+int device_registry_count(void)
+{
+	return __atomic_load_n(&device_count, __ATOMIC_RELAXED);
+}
+
+uint32_t device_registry_get_dropped(void)
+{
+	return dropped;
+}
+
+void device_registry_select(int slot)
+{
+	__atomic_store_n(&selected, slot, __ATOMIC_RELAXED);
+}
+
+int device_registry_get_selected(void)
+{
+	return __atomic_load_n(&selected, __ATOMIC_RELAXED);
+}
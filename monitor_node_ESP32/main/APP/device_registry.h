@@ -0,0 +1,108 @@
+#ifndef __DEVICE_REGISTRY_H
+#define __DEVICE_REGISTRY_H
+
+#include "esp_err.h"
+#include "mqtt_manager.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEVICE_REGISTRY_CAPACITY 512 /* hash slots, a power of two */
+#define DEVICE_REGISTRY_MAX_LOAD 384 /* devices accepted, keeps probes short */
+#define DEVICE_ID_LEN 24			 /* longest device id, with the '\0' */
+#define DEVICE_REGISTRY_DEFAULT_ID "default" /* node publishing on plain sensor/data */
+
+/* State of one sensor node */
+typedef struct
+{
+	char id[DEVICE_ID_LEN];
+	sensor_data_t data;	  /* latest values, timestamp in local ms */
+	uint32_t update_time; /* node uptime (s) of the latest sample */
+	uint32_t messages;	  /* samples received */
+	uint32_t alarms;	  /* times the alarm went from 0 to 1 */
+	uint64_t first_seen;  /* local ms */
+} device_state_t;
+
+/* Function declarations */
+
+/**
+ * @brief Allocate the device table, in PSRAM when the board has it
+ * @retval ESP_OK Success, ESP_ERR_NO_MEM table not allocated
+ */
+esp_err_t device_registry_init(void);
+
+/**
+ * @brief Store a sample of a device, adding the device when new
+ * Only the MQTT pipeline worker may call this, readers never block it
+ * @param id Device id, need not be '\0' terminated
+ * @param id_len Id length, 1..DEVICE_ID_LEN - 1
+ * @param data Sample values
+ * @param update_time Node uptime (s) of the sample
+ * @retval Slot of the device, -1 if the id is invalid or the table is full
+ */
+int device_registry_update(const char *id, int id_len, const sensor_data_t *data, uint32_t update_time);
+
+/**
+ * @brief Store a run of samples of a device in one write, e.g. a batch
+ * Same rules as device_registry_update()
+ * @param id Device id, need not be '\0' terminated
+ * @param id_len Id length, 1..DEVICE_ID_LEN - 1
+ * @param last Newest sample of the run
+ * @param update_time Node uptime (s) of the newest sample
+ * @param samples Samples in the run
+ * @param first_alarm Alarm of the oldest sample
+ * @param alarm_rises Alarm 0 -> 1 transitions inside the run
+ * @retval Slot of the device, -1 if the id is invalid or the table is full
+ */
+int device_registry_update_run(const char *id, int id_len, const sensor_data_t *last, uint32_t update_time,
+							   uint32_t samples, int first_alarm, uint32_t alarm_rises);
+
+/**
+ * @brief Find a device
+ * @param id Device id, need not be '\0' terminated
+ * @param id_len Id length
+ * @retval Slot of the device, -1 if unknown
+ */
+int device_registry_find(const char *id, int id_len);
+
+/**
+ * @brief Copy one consistent state of a device, lock free
+ * @param slot Slot from device_registry_find() or device_registry_next()
+ * @param state Output
+ * @retval true Copied, false no device in the slot
+ */
+bool device_registry_get(int slot, device_state_t *state);
+
+/**
+ * @brief Iterate over the known devices
+ * @param slot -1 to start, then the previous result
+ * @retval Next slot holding a device, -1 at the end
+ */
+int device_registry_next(int slot);
+
+/**
+ * @brief Check a device sent a sample within timeout_ms
+ */
+bool device_registry_is_fresh(int slot, uint32_t timeout_ms);
+
+/**
+ * @brief Number of known devices
+ */
+int device_registry_count(void);
+
+/**
+ * @brief Samples dropped because the table was full or the id invalid
+ */
+uint32_t device_registry_get_dropped(void);
+
+/**
+ * @brief Choose the device shown on the display
+ * @param slot Device slot, -1 follows the first device that reports
+ */
+void device_registry_select(int slot);
+
+/**
+ * @brief Slot of the device shown on the display, -1 if none yet
+ */
+int device_registry_get_selected(void);
+
+#endif /* __DEVICE_REGISTRY_H */
@@ -0,0 +1,397 @@
+#include "log_ring.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+
+static const char *TAG = "LOG_RING";
+
+/*
+ * Any task may log, so the ring is guarded by a spinlock held only for the
+ * copy of one line; formatting and printing happen outside it, on the
+ * print task or on the caller of log_ring_flush(). A full ring drops new
+ * lines and counts them rather than blocking the caller.
+ */
+#define LOG_RING_TASK_PRIO 1 /* above idle only */
+#define LOG_RING_STK_SIZE 4 * 1024
+#define LOG_RING_PERIOD_MS 100 /* print latency when the ring is quiet */
+#define LOG_RING_MEASURE_CALLS 32
+
+static log_ring_record_t *ring = NULL;
+static uint32_t ring_head = 0;
+static uint32_t ring_tail = 0;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t ring_task_handle = NULL;
+
+static uint32_t stat_records = 0;
+static uint32_t stat_rendered = 0;
+static uint32_t stat_dropped = 0;
+static uint32_t stat_depth_peak = 0;
+static uint32_t stat_call_cycles = 0;
+static uint32_t stat_format_cycles = 0;
+static uint32_t dropped_reported = 0;
+
+/**
+ * @brief Format one conversion with the argument converted to the type the
+ * specification expects
+ * @param spec Conversion specification, '\0' terminated
+ * @param length Length modifier: 0, 'h', 'l', 'L' (ll/j), 'z'
+ * @param conv Conversion character
+ * @retval What snprintf() returns
+ */
+static int format_arg(char *out, int size, const char *spec, char length, char conv, const log_ring_record_t *rec,
+					  const log_ring_arg_t *arg)
+{
+	log_ring_arg_t zero = {0};
+
+	if (arg == NULL)
+	{
+		arg = &zero; // fewer arguments than conversions
+	}
+	switch (conv)
+	{
+	case 'd':
+	case 'i':
+		if (length == 'L')
+		{
+			return snprintf(out, size, spec, (long long)arg->i);
+		}
+		if (length == 'l' || length == 'z')
+		{
+			return snprintf(out, size, spec, (long)arg->i);
+		}
+		return snprintf(out, size, spec, (int)arg->i);
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+		if (length == 'L')
+		{
+			return snprintf(out, size, spec, (unsigned long long)arg->i);
+		}
+		if (length == 'l')
+		{
+			return snprintf(out, size, spec, (unsigned long)arg->i);
+		}
+		if (length == 'z')
+		{
+			return snprintf(out, size, spec, (size_t)arg->i);
+		}
+		return snprintf(out, size, spec, (unsigned int)arg->i);
+	case 'c':
+		return snprintf(out, size, spec, (int)arg->i);
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		return snprintf(out, size, spec, arg->d);
+	case 'p':
+		return snprintf(out, size, spec, arg->p);
+	case 's':
+		// the offset is checked, a format that does not match its arguments prints garbage, never crashes
+		if (arg == &zero || arg->i < 0 || arg->i >= rec->str_used)
+		{
+			return snprintf(out, size, "(null)");
+		}
+		return snprintf(out, size, spec, rec->str + arg->i);
+	default:
+		return snprintf(out, size, "%s", spec); // unknown, printed as written
+	}
+}
+
+/**
+ * @brief Expand a line's format with its recorded arguments
+ * @retval Length of the text in out
+ */
+static int format_record(const log_ring_record_t *rec, char *out, int size)
+{
+	const char *f = rec->fmt;
+	int pos = 0;
+	int next = 0;
+
+	while (*f != '\0' && pos < size - 1)
+	{
+		char spec[24];
+		int n = 0;
+		char length = 0;
+		int ret;
+
+		if (*f != '%')
+		{
+			out[pos++] = *f++;
+			continue;
+		}
+		if (f[1] == '%')
+		{
+			out[pos++] = '%';
+			f += 2;
+			continue;
+		}
+
+		spec[n++] = *f++;
+		while (*f != '\0' && strchr("-+ #0123456789.*hlLjzt", *f) != NULL && n < (int)sizeof(spec) - 12)
+		{
+			if (*f == '*')
+			{
+				// width or precision taken from an argument, written into the spec
+				n += snprintf(spec + n, sizeof(spec) - n, "%d", next < rec->nargs ? (int)rec->args[next].i : 0);
+				next++;
+			}
+			else
+			{
+				if (*f == 'l' && length == 'l')
+				{
+					length = 'L';
+				}
+				else if (*f == 'j')
+				{
+					length = 'L';
+				}
+				else if (*f == 'h' || *f == 'l' || *f == 'z' || *f == 't')
+				{
+					length = *f == 't' ? 'z' : *f;
+				}
+				spec[n++] = *f;
+			}
+			f++;
+		}
+		if (*f == '\0')
+		{
+			break;
+		}
+		spec[n++] = *f;
+		spec[n] = '\0';
+
+		ret = format_arg(out + pos, size - pos, spec, length, *f, rec, next < rec->nargs ? &rec->args[next] : NULL);
+		next++;
+		f++;
+		if (ret > 0)
+		{
+			pos += ret < size - pos ? ret : size - pos - 1;
+		}
+	}
+	out[pos] = '\0';
+	return pos;
+}
+
+/**
+ * @brief Print a line the way ESP_LOGx does, with the time it was logged
+ */
+static void render_record(const log_ring_record_t *rec)
+{
+	static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+	char text[LOG_RING_LINE_LEN];
+	const char *color = "";
+	const char *reset = "";
+
+	format_record(rec, text, sizeof(text));
+#if CONFIG_LOG_COLORS
+	if (rec->level == ESP_LOG_ERROR)
+	{
+		color = LOG_COLOR_E;
+		reset = LOG_RESET_COLOR;
+	}
+	else if (rec->level == ESP_LOG_WARN)
+	{
+		color = LOG_COLOR_W;
+		reset = LOG_RESET_COLOR;
+	}
+	else if (rec->level == ESP_LOG_INFO)
+	{
+		color = LOG_COLOR_I;
+		reset = LOG_RESET_COLOR;
+	}
+#endif
+	esp_log_write((esp_log_level_t)rec->level, rec->tag, "%s%c (%lu) %s: %s%s\n", color,
+				  letters[rec->level < sizeof(letters) ? rec->level : 0], (unsigned long)rec->time_ms, rec->tag,
+				  text, reset);
+}
+
+/**
+ * @brief Take the oldest line off the ring
+ * @retval true A line was copied to rec
+ */
+static bool ring_pop(log_ring_record_t *rec)
+{
+	bool popped = false;
+
+	taskENTER_CRITICAL(&ring_lock);
+	if (ring_head != ring_tail)
+	{
+		*rec = ring[ring_tail & (LOG_RING_DEPTH - 1)];
+		ring_tail++;
+		popped = true;
+	}
+	taskEXIT_CRITICAL(&ring_lock);
+	return popped;
+}
+
+void log_ring_flush(void)
+{
+	log_ring_record_t rec;
+	uint32_t dropped;
+
+	if (ring == NULL)
+	{
+		return;
+	}
+	while (ring_pop(&rec))
+	{
+		render_record(&rec);
+		__atomic_add_fetch(&stat_rendered, 1, __ATOMIC_RELAXED);
+	}
+	dropped = __atomic_load_n(&stat_dropped, __ATOMIC_RELAXED);
+	if (dropped != dropped_reported)
+	{
+		ESP_LOGW(TAG, "%lu lines dropped, ring full", (unsigned long)(dropped - dropped_reported));
+		dropped_reported = dropped;
+	}
+}
+
+void log_ring_commit(const log_ring_record_t *rec)
+{
+	log_ring_record_t *slot;
+	uint32_t now_ms = esp_log_timestamp();
+	uint32_t depth;
+	bool wake = false;
+
+	if (ring == NULL)
+	{
+		log_ring_record_t now = *rec;
+
+		now.time_ms = now_ms;
+		render_record(&now);
+		return;
+	}
+
+	taskENTER_CRITICAL(&ring_lock);
+	depth = ring_head - ring_tail;
+	if (depth >= LOG_RING_DEPTH)
+	{
+		stat_dropped++;
+	}
+	else
+	{
+		slot = &ring[ring_head & (LOG_RING_DEPTH - 1)];
+		*slot = *rec;
+		slot->time_ms = now_ms;
+		ring_head++;
+		stat_records++;
+		if (++depth > stat_depth_peak)
+		{
+			stat_depth_peak = depth;
+		}
+		// half full, print now instead of at the next period
+		wake = depth == LOG_RING_DEPTH / 2;
+	}
+	taskEXIT_CRITICAL(&ring_lock);
+
+	if (wake && ring_task_handle != NULL)
+	{
+		xTaskNotifyGive(ring_task_handle);
+	}
+}
+
+static void log_ring_task(void *arg)
+{
+	while (1)
+	{
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_RING_PERIOD_MS));
+		log_ring_flush();
+	}
+}
+
+/**
+ * @brief Time a deferred call against formatting the same line in place
+ * Runs before any other task logs, the measured lines are discarded
+ */
+static void log_ring_measure(void)
+{
+	char line[LOG_RING_LINE_LEN];
+	uint32_t start;
+	uint32_t calls;
+	uint32_t formats;
+	float t = 26.5f;
+	int h = 65;
+
+	start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < LOG_RING_MEASURE_CALLS; i++)
+	{
+		LOG_RING_AT(ESP_LOG_INFO, TAG, "Measure - T:%.1f H:%d%% Air:%dppm Smoke:%dppm Light:%dlux Alarm:%d", t, h,
+					300, 80, 950, i & 1);
+	}
+	calls = esp_cpu_get_cycle_count() - start;
+
+	start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < LOG_RING_MEASURE_CALLS; i++)
+	{
+		snprintf(line, sizeof(line), "Measure - T:%.1f H:%d%% Air:%dppm Smoke:%dppm Light:%dlux Alarm:%d", t, h,
+				 300, 80, 950, i & 1);
+	}
+	formats = esp_cpu_get_cycle_count() - start;
+
+	taskENTER_CRITICAL(&ring_lock);
+	ring_head = ring_tail;
+	stat_records = 0;
+	stat_depth_peak = 0;
+	taskEXIT_CRITICAL(&ring_lock);
+
+	stat_call_cycles = calls / LOG_RING_MEASURE_CALLS;
+	stat_format_cycles = formats / LOG_RING_MEASURE_CALLS;
+}
+
+esp_err_t log_ring_init(void)
+{
+	BaseType_t ret;
+
+	if (ring != NULL)
+	{
+		return ESP_OK;
+	}
+	ring = heap_caps_malloc(LOG_RING_DEPTH * sizeof(log_ring_record_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	if (ring == NULL)
+	{
+		ESP_LOGE(TAG, "No PSRAM for the log ring, lines are printed at once");
+		return ESP_ERR_NO_MEM;
+	}
+
+	log_ring_measure();
+
+	ret = xTaskCreate(log_ring_task, "log_ring", LOG_RING_STK_SIZE, NULL, LOG_RING_TASK_PRIO, &ring_task_handle);
+	if (ret != pdPASS)
+	{
+		// without the task nothing would print, keep logging synchronous
+		ESP_LOGE(TAG, "Failed to create log task");
+		heap_caps_free(ring);
+		ring = NULL;
+		ring_task_handle = NULL;
+		return ESP_FAIL;
+	}
+	// esp_restart() runs it, the OTA reboot would otherwise lose the last lines
+	if (esp_register_shutdown_handler(log_ring_flush) != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Lines buffered at a restart will be lost");
+	}
+	ESP_LOGI(TAG, "%d lines in PSRAM, deferred call %lu cycles, formatting in place %lu cycles", LOG_RING_DEPTH,
+			 (unsigned long)stat_call_cycles, (unsigned long)stat_format_cycles);
+	return ESP_OK;
+}
+
+void log_ring_get_stats(log_ring_stats_t *stats)
+{
+	taskENTER_CRITICAL(&ring_lock);
+	stats->records = stat_records;
+	stats->dropped = stat_dropped;
+	stats->depth = ring_head - ring_tail;
+	stats->depth_peak = stat_depth_peak;
+	taskEXIT_CRITICAL(&ring_lock);
+	stats->rendered = __atomic_load_n(&stat_rendered, __ATOMIC_RELAXED);
+	stats->call_cycles = stat_call_cycles;
+	stats->format_cycles = stat_format_cycles;
+}
@@ -0,0 +1,184 @@
+#ifndef __LOG_RING_H
+#define __LOG_RING_H
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * Deferred logging for hot paths. A call stores the format string pointer
+ * (strings live in flash for the life of the firmware, so the pointer is
+ * the format id), the tag and the raw arguments in a ring in PSRAM; a low
+ * priority task formats and prints them later through esp_log_write(),
+ * with the timestamp of the call. The caller never formats and never waits
+ * for the UART.
+ *
+ * Levels are filtered at compile time per file with LOG_LOCAL_LEVEL, as for
+ * ESP_LOGx: define it before the first include to change a module's level.
+ * Calls above it compile to nothing. The runtime level of the tag is
+ * applied when the line is printed.
+ *
+ * Arguments: integers, floating point, pointers and strings, at most
+ * LOG_RING_MAX_ARGS. Strings are copied, LOG_RING_STR_LEN bytes per line
+ * shared by all string arguments and truncated beyond, and must be '\0'
+ * terminated: "%.*s" of a payload stays with ESP_LOGx. Pointers other than
+ * void and byte pointers must be cast to (void *) for %p, uncast they fall
+ * to the integer case and fail to compile.
+ *
+ * The ring is printed before esp_restart(), lines logged just before a
+ * restart are not lost. A panic does not print it.
+ */
+#define LOG_RING_DEPTH 512	 /* lines buffered, a power of two */
+#define LOG_RING_MAX_ARGS 6	 /* arguments per line */
+#define LOG_RING_STR_LEN 24	 /* bytes of copied string arguments per line */
+#define LOG_RING_LINE_LEN 160 /* longest printed line */
+
+typedef union
+{
+	int64_t i; /* integers, offset into str for strings */
+	double d;
+	const void *p;
+} log_ring_arg_t;
+
+/* One recorded line */
+typedef struct
+{
+	const char *tag;
+	const char *fmt;
+	uint32_t time_ms; /* esp_log_timestamp() of the call */
+	uint8_t level;
+	uint8_t nargs;
+	uint8_t str_used;
+	log_ring_arg_t args[LOG_RING_MAX_ARGS];
+	char str[LOG_RING_STR_LEN];
+} log_ring_record_t;
+
+/* Ring counters and the measured cost of a call */
+typedef struct
+{
+	uint32_t records;  /* lines recorded */
+	uint32_t rendered; /* lines printed */
+	uint32_t dropped;  /* ring full */
+	uint32_t depth;	   /* lines waiting now */
+	uint32_t depth_peak;
+	uint32_t call_cycles;	/* one deferred call, six arguments */
+	uint32_t format_cycles; /* formatting the same line in place, UART time not included */
+} log_ring_stats_t;
+
+/* Deferred counterparts of ESP_LOGx */
+#define LOG_RING_E(tag, fmt, ...) LOG_RING_AT(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define LOG_RING_W(tag, fmt, ...) LOG_RING_AT(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define LOG_RING_I(tag, fmt, ...) LOG_RING_AT(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define LOG_RING_D(tag, fmt, ...) LOG_RING_AT(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define LOG_RING_V(tag, fmt, ...) LOG_RING_AT(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+#define LOG_RING_AT(level, tag, fmt, ...)                    \
+	do                                                       \
+	{                                                        \
+		if (LOG_LOCAL_LEVEL >= (level))                      \
+		{                                                    \
+			log_ring_record_t _rec;                          \
+			log_ring_begin(&_rec, (level), (tag), (fmt));    \
+			LOG_RING_ARGS(&_rec, ##__VA_ARGS__);             \
+			log_ring_commit(&_rec);                          \
+		}                                                    \
+	} while (0)
+
+/* Argument capture, the type picks how each one is stored */
+#define LOG_RING_ARG(r, x) _Generic((x),     \
+	float: log_ring_arg_double,              \
+	double: log_ring_arg_double,             \
+	char *: log_ring_arg_str,                \
+	const char *: log_ring_arg_str,          \
+	void *: log_ring_arg_ptr,                \
+	const void *: log_ring_arg_ptr,          \
+	signed char *: log_ring_arg_ptr,         \
+	const signed char *: log_ring_arg_ptr,   \
+	unsigned char *: log_ring_arg_ptr,       \
+	const unsigned char *: log_ring_arg_ptr, \
+	default: log_ring_arg_int)(r, x)
+
+/* More than LOG_RING_MAX_ARGS arguments fails to compile here */
+#define LOG_RING_NARGS(...) LOG_RING_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_RING_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define LOG_RING_CAT(a, b) LOG_RING_CAT_(a, b)
+#define LOG_RING_CAT_(a, b) a##b
+#define LOG_RING_ARGS(r, ...) LOG_RING_CAT(LOG_RING_ARGS_, LOG_RING_NARGS(__VA_ARGS__))(r, ##__VA_ARGS__)
+#define LOG_RING_ARGS_0(r) ((void)0)
+#define LOG_RING_ARGS_1(r, a) LOG_RING_ARG(r, a)
+#define LOG_RING_ARGS_2(r, a, ...) (LOG_RING_ARG(r, a), LOG_RING_ARGS_1(r, __VA_ARGS__))
+#define LOG_RING_ARGS_3(r, a, ...) (LOG_RING_ARG(r, a), LOG_RING_ARGS_2(r, __VA_ARGS__))
+#define LOG_RING_ARGS_4(r, a, ...) (LOG_RING_ARG(r, a), LOG_RING_ARGS_3(r, __VA_ARGS__))
+#define LOG_RING_ARGS_5(r, a, ...) (LOG_RING_ARG(r, a), LOG_RING_ARGS_4(r, __VA_ARGS__))
+#define LOG_RING_ARGS_6(r, a, ...) (LOG_RING_ARG(r, a), LOG_RING_ARGS_5(r, __VA_ARGS__))
+
+static inline void log_ring_begin(log_ring_record_t *r, esp_log_level_t level, const char *tag, const char *fmt)
+{
+	r->tag = tag;
+	r->fmt = fmt;
+	r->level = (uint8_t)level;
+	r->nargs = 0;
+	r->str_used = 0;
+}
+
+static inline void log_ring_arg_int(log_ring_record_t *r, int64_t v)
+{
+	r->args[r->nargs++].i = v;
+}
+
+static inline void log_ring_arg_double(log_ring_record_t *r, double v)
+{
+	r->args[r->nargs++].d = v;
+}
+
+static inline void log_ring_arg_ptr(log_ring_record_t *r, const void *v)
+{
+	r->args[r->nargs++].p = v;
+}
+
+static inline void log_ring_arg_str(log_ring_record_t *r, const char *s)
+{
+	int room = LOG_RING_STR_LEN - r->str_used - 1;
+	int len;
+
+	if (s == NULL || room < 0)
+	{
+		r->args[r->nargs++].i = -1;
+		return;
+	}
+	len = (int)strnlen(s, room);
+	memcpy(r->str + r->str_used, s, len);
+	r->str[r->str_used + len] = '\0';
+	r->args[r->nargs++].i = r->str_used;
+	r->str_used += len + 1;
+}
+
+/* Function declarations */
+
+/**
+ * @brief Allocate the ring, start the print task and measure the call cost
+ * Lines logged before this, or without a ring, are printed at once
+ * @retval ESP_OK Success, ESP_ERR_NO_MEM no ring, ESP_FAIL task not created
+ */
+esp_err_t log_ring_init(void);
+
+/**
+ * @brief Store a line built by the LOG_RING_x macros, task context only
+ * @param rec Line, copied
+ */
+void log_ring_commit(const log_ring_record_t *rec);
+
+/**
+ * @brief Print every buffered line on the caller, e.g. before a restart
+ */
+void log_ring_flush(void);
+
+/**
+ * @brief Get ring counters and the measured call cost
+ * @param stats Output
+ */
+void log_ring_get_stats(log_ring_stats_t *stats);
+
+#endif /* __LOG_RING_H */
@@ -3,9 +3,12 @@
 #include "wifi_manager.h"
 #include "mqtt_manager.h"
 #include "ota_manager.h"
+#include "alarm_path.h"
 #include "lvgl.h"
 #include "esp_log.h"
+#include "log_ring.h"
 #include <stdio.h>
+#include <stddef.h>
 
 LV_FONT_DECLARE(myFont14);
 
@@ -17,7 +20,7 @@ typedef struct
 	const char *unit;
 	int min;
 	int max;
-	int (*get_value_func)(void);
+	size_t value_offset; // int field of sensor_display_data_t shown
 	lv_obj_t *bar;	 // Progress Bar Control
 	lv_obj_t *label; // label control
 } SensorWidget;
@@ -42,6 +45,9 @@ static lv_obj_t *ota_screen = NULL;
 static lv_obj_t *ota_full_progress_bar = NULL;
 static lv_obj_t *ota_full_status_label = NULL;
 static lv_obj_t *main_screen = NULL;
+/* Alarm overlay, on the top layer above every screen */
+static lv_obj_t *alarm_overlay = NULL;
+static lv_obj_t *alarm_overlay_label = NULL;
 /* Timer */
 static lv_timer_t *update_timer = NULL;
 
@@ -64,10 +70,27 @@ static void return_to_main_timer_cb(lv_timer_t *timer)
 	}
 }
 
+/* ota/status result, set on the MQTT pipeline worker and shown in the LVGL task */
+static bool ota_available_new = false;
+static bool ota_available_state = false;
+static portMUX_TYPE ota_available_lock = portMUX_INITIALIZER_UNLOCKED;
+
 /**
- * @brief Update OTA notification display
+ * @brief OTA availability callback, runs on the MQTT pipeline worker
+ * Only records the result, update_status_display() shows it.
  */
 void update_ota_notification(bool available)
+{
+	taskENTER_CRITICAL(&ota_available_lock);
+	ota_available_state = available;
+	ota_available_new = true;
+	taskEXIT_CRITICAL(&ota_available_lock);
+}
+
+/**
+ * @brief Update OTA notification display, LVGL task only
+ */
+static void show_ota_notification(bool available)
 {
 	if (ota_notification_label && lv_obj_is_valid(ota_notification_label))
 	{
@@ -405,14 +428,19 @@ static lv_color_t get_sensor_color(const char *sensor_name, int value)
 	return lv_palette_main(LV_PALETTE_BLUE);
 }
 
-// Update sensor widgets
-void update_sensor_widgets(SensorWidget *sensors, int count)
+static int sensor_widget_value(const SensorWidget *sensor, const sensor_display_data_t *frame)
+{
+	return *(const int *)((const char *)frame + sensor->value_offset);
+}
+
+// Update sensor widgets, all from the same frame
+void update_sensor_widgets(SensorWidget *sensors, int count, const sensor_display_data_t *frame)
 {
 	for (int i = 0; i < count; i++)
 	{
-		if (sensors[i].get_value_func && sensors[i].bar && sensors[i].label)
+		if (sensors[i].bar && sensors[i].label)
 		{
-			int current_value = sensors[i].get_value_func();
+			int current_value = sensor_widget_value(&sensors[i], frame);
 			lv_bar_set_value(sensors[i].bar, current_value, LV_ANIM_ON);
 
 			char buf[64];
@@ -423,7 +451,7 @@ void update_sensor_widgets(SensorWidget *sensors, int count)
 			lv_color_t bar_color = get_sensor_color(sensors[i].name, current_value);
 			lv_obj_set_style_bg_color(sensors[i].bar, bar_color, LV_PART_INDICATOR);
 
-			if (data_handler_get_alarm_status())
+			if (frame->device_alarm)
 			{
 				lv_obj_set_style_border_color(sensors[i].bar, lv_palette_main(LV_PALETTE_RED), LV_PART_MAIN);
 				lv_obj_set_style_border_width(sensors[i].bar, 2, LV_PART_MAIN);
@@ -437,7 +465,7 @@ void update_sensor_widgets(SensorWidget *sensors, int count)
 }
 
 // update status tab page display
-void update_status_display(void)
+void update_status_display(const sensor_display_data_t *frame)
 {
 	if (wifi_status_label)
 	{
@@ -457,11 +485,12 @@ void update_status_display(void)
 
 	if (data_status_label)
 	{
-		bool data_fresh = data_handler_is_data_fresh(30000);
-		uint64_t data_age_sec = data_handler_get_data_age() / 1000;
+		uint64_t data_age_ms = data_handler_snapshot_age(frame);
+		bool data_fresh = frame->data_valid && data_age_ms < 30000;
+		uint64_t data_age_sec = data_age_ms / 1000;
 
 		char data_text[64];
-		if (data_handler_is_data_valid())
+		if (frame->data_valid)
 		{
 			snprintf(data_text, sizeof(data_text), "Data: %llu sec ago", data_age_sec);
 		}
@@ -474,6 +503,31 @@ void update_status_display(void)
 		lv_obj_set_style_text_color(data_status_label,
 									data_fresh ? lv_palette_main(LV_PALETTE_GREEN) : lv_palette_main(LV_PALETTE_ORANGE), 0);
 	}
+
+	// Controller acks arrive on the MQTT pipeline worker, shown here in the LVGL context
+	control_ack_t ack;
+	if (mqtt_manager_get_control_ack(&ack) && control_status_label)
+	{
+		char ack_text[64];
+		snprintf(ack_text, sizeof(ack_text), "Status: Frame %u %s, round trip %lu ms",
+				 ack.frame_id, ack.ok ? "executed" : ack.status, (unsigned long)ack.rtt_ms);
+		lv_label_set_text(control_status_label, ack_text);
+		lv_obj_set_style_text_color(control_status_label,
+									ack.ok ? lv_palette_main(LV_PALETTE_GREEN) : lv_palette_main(LV_PALETTE_RED), 0);
+	}
+
+	// Likewise the ota/status result
+	bool ota_fresh;
+	bool ota_available;
+	taskENTER_CRITICAL(&ota_available_lock);
+	ota_fresh = ota_available_new;
+	ota_available = ota_available_state;
+	ota_available_new = false;
+	taskEXIT_CRITICAL(&ota_available_lock);
+	if (ota_fresh)
+	{
+		show_ota_notification(ota_available);
+	}
 }
 
 /* Control Page Button Turn On State Reset Timer*/
@@ -503,11 +557,12 @@ static void control_on_btn_event_cb(lv_event_t *e)
 			return;
 		}
 
-		int msg_id = mqtt_manager_send_control_command("1");
+		control_cmd_t cmd = {'B', 'N', 0};
+		int msg_id = mqtt_manager_send_control_frame(&cmd, 1);
 
 		if (msg_id != -1)
 		{
-			ESP_LOGI(TAG, "ON command sent, msg_id=%d", msg_id);
+			ESP_LOGI(TAG, "ON command sent, frame_id=%d", msg_id);
 			lv_label_set_text_static(lv_obj_get_child(btn, 0), "ON SENT");
 
 			if (control_status_label)
@@ -559,11 +614,12 @@ static void control_off_btn_event_cb(lv_event_t *e)
 			return;
 		}
 
-		int msg_id = mqtt_manager_send_control_command("0");
+		control_cmd_t cmd = {'B', 'F', 0};
+		int msg_id = mqtt_manager_send_control_frame(&cmd, 1);
 
 		if (msg_id != -1)
 		{
-			ESP_LOGI(TAG, "OFF command sent, msg_id=%d", msg_id);
+			ESP_LOGI(TAG, "OFF command sent, frame_id=%d", msg_id);
 			lv_label_set_text_static(lv_obj_get_child(btn, 0), "OFF SENT");
 
 			if (control_status_label)
@@ -658,6 +714,9 @@ void create_status_area(lv_obj_t *parent)
 
 void create_sensor_widgets(lv_obj_t *parent, SensorWidget *sensors)
 {
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
 	for (int i = 0; i < 5; i++)
 	{
 		int y_offset = 20 + i * 80;
@@ -667,7 +726,7 @@ void create_sensor_widgets(lv_obj_t *parent, SensorWidget *sensors)
 		lv_obj_align(sensors[i].bar, LV_ALIGN_TOP_LEFT, 20, y_offset);
 		lv_bar_set_range(sensors[i].bar, sensors[i].min, sensors[i].max);
 		// set initial value
-		int initial_value = sensors[i].get_value_func ? sensors[i].get_value_func() : sensors[i].min;
+		int initial_value = frame.data_valid ? sensor_widget_value(&sensors[i], &frame) : sensors[i].min;
 		lv_bar_set_value(sensors[i].bar, initial_value, LV_ANIM_OFF);
 		// creat sensor lable
 		sensors[i].label = lv_label_create(parent);
@@ -682,17 +741,89 @@ void create_sensor_widgets(lv_obj_t *parent, SensorWidget *sensors)
 
 static void update_timer_cb(lv_timer_t *timer)
 {
+	// one consistent frame per tick, taken without blocking the MQTT side
+	sensor_display_data_t frame;
+
+	data_handler_get_snapshot(&frame);
 	if (data_handler_check_update() || (lv_tick_get() % 5000 == 0))
 	{
-		ESP_LOGI(TAG, "Updating sensor display");
-		update_sensor_widgets(sensors_page1, 5);
+		LOG_RING_I(TAG, "Updating sensor display");
+		update_sensor_widgets(sensors_page1, 5, &frame);
+	}
+	update_status_display(&frame);
+}
+
+/* Alarm overlay click, acknowledges until the next alarm */
+static void alarm_overlay_event_cb(lv_event_t *e)
+{
+	if (lv_event_get_code(e) == LV_EVENT_CLICKED)
+	{
+		lv_obj_add_flag(alarm_overlay, LV_OBJ_FLAG_HIDDEN);
+	}
+}
+
+/* Created hidden at startup, raising it is a flag and a label */
+static void create_alarm_overlay(void)
+{
+	alarm_overlay = lv_obj_create(lv_layer_top());
+	lv_obj_set_size(alarm_overlay, LV_PCT(100), LV_PCT(100));
+	lv_obj_set_style_bg_color(alarm_overlay, lv_palette_main(LV_PALETTE_RED), LV_PART_MAIN);
+	lv_obj_set_style_bg_opa(alarm_overlay, LV_OPA_COVER, LV_PART_MAIN);
+	lv_obj_set_style_radius(alarm_overlay, 0, LV_PART_MAIN);
+	lv_obj_set_style_border_width(alarm_overlay, 0, LV_PART_MAIN);
+	lv_obj_clear_flag(alarm_overlay, LV_OBJ_FLAG_SCROLLABLE);
+	lv_obj_add_event_cb(alarm_overlay, alarm_overlay_event_cb, LV_EVENT_CLICKED, NULL);
+
+	alarm_overlay_label = lv_label_create(alarm_overlay);
+	lv_obj_set_style_text_font(alarm_overlay_label, &lv_font_montserrat_20, LV_PART_MAIN);
+	lv_obj_set_style_text_color(alarm_overlay_label, lv_color_white(), LV_PART_MAIN);
+	lv_obj_set_style_text_align(alarm_overlay_label, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN);
+	lv_obj_center(alarm_overlay_label);
+	lv_obj_add_flag(alarm_overlay, LV_OBJ_FLAG_HIDDEN);
+}
+
+void lv_mainstart_handle_alarm(void)
+{
+	alarm_event_t event;
+	uint32_t latency_us;
+	char buf[96];
+
+	if (alarm_overlay == NULL || !alarm_path_take(&event))
+	{
+		return;
+	}
+
+	if (event.active_devices == 0 && !event.transient)
+	{
+		lv_obj_add_flag(alarm_overlay, LV_OBJ_FLAG_HIDDEN);
 	}
-	update_status_display();
+	else if (event.raised || !lv_obj_has_flag(alarm_overlay, LV_OBJ_FLAG_HIDDEN))
+	{
+		// a new alarm shows the overlay again even if it was acknowledged
+		if (event.active_devices == 0)
+		{
+			// over before it arrived, stays up until acknowledged
+			snprintf(buf, sizeof(buf), "ALARM\n%s\nraised and cleared\nTap to acknowledge", event.device_id);
+		}
+		else
+		{
+			snprintf(buf, sizeof(buf), "ALARM\n%s\n%d device(s) in alarm\nTap to acknowledge",
+					 event.device_id, event.active_devices);
+		}
+		lv_label_set_text(alarm_overlay_label, buf);
+		lv_obj_clear_flag(alarm_overlay, LV_OBJ_FLAG_HIDDEN);
+	}
+
+	// draw and flush now instead of at the next display refresh period
+	lv_refr_now(NULL);
+	latency_us = alarm_path_shown(&event);
+	LOG_RING_W(TAG, "Alarm of %s %s, on screen %lu us after receipt", event.device_id,
+			   event.transient ? "raised and cleared" : event.raised ? "raised" : "cleared", (unsigned long)latency_us);
 }
 
 void ui_update_callback(void) // for debug
 {
-	ESP_LOGI(TAG, "Received data update notification");
+	LOG_RING_I(TAG, "Received data update notification");
 }
 
 void lv_mainstart(void)
@@ -703,6 +834,7 @@ void lv_mainstart(void)
 	data_handler_register_ui_callback(ui_update_callback);
 	ota_manager_register_status_callback(ota_status_callback_debug);
 	ota_manager_register_progress_callback(ota_progress_callback_debug);
+	ota_manager_register_available_callback(update_ota_notification);
 
 	lv_obj_set_style_bg_color(lv_scr_act(), lv_palette_lighten(LV_PALETTE_BLUE, 3), LV_PART_MAIN);
 
@@ -712,11 +844,11 @@ void lv_mainstart(void)
 	lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
 
 	// Configure sensor controls
-	sensors_page1[0] = (SensorWidget){"Temp", "C", 0, 40, data_handler_get_temperature, NULL, NULL};
-	sensors_page1[1] = (SensorWidget){"Humidity", "%", 0, 100, data_handler_get_humidity, NULL, NULL};
-	sensors_page1[2] = (SensorWidget){"Air", "ppm", 0, 1000, data_handler_get_air_quality, NULL, NULL};
-	sensors_page1[3] = (SensorWidget){"Smoke", "ppm", 0, 5000, data_handler_get_smoke_level, NULL, NULL};
-	sensors_page1[4] = (SensorWidget){"Light", "lux", 0, 1000, data_handler_get_light_intensity, NULL, NULL};
+	sensors_page1[0] = (SensorWidget){"Temp", "C", 0, 40, offsetof(sensor_display_data_t, temperature), NULL, NULL};
+	sensors_page1[1] = (SensorWidget){"Humidity", "%", 0, 100, offsetof(sensor_display_data_t, humidity), NULL, NULL};
+	sensors_page1[2] = (SensorWidget){"Air", "ppm", 0, 1000, offsetof(sensor_display_data_t, air_quality), NULL, NULL};
+	sensors_page1[3] = (SensorWidget){"Smoke", "ppm", 0, 5000, offsetof(sensor_display_data_t, smoke_level), NULL, NULL};
+	sensors_page1[4] = (SensorWidget){"Light", "lux", 0, 1000, offsetof(sensor_display_data_t, light_intensity), NULL, NULL};
 
 	lv_obj_t *tabview = lv_tabview_create(lv_scr_act(), LV_DIR_TOP, 50);
 	lv_obj_set_size(tabview, 600, 480);
@@ -758,6 +890,8 @@ void lv_mainstart(void)
 	lv_label_set_text(rollback_btn_label, "ROLLBACK");
 	lv_obj_center(rollback_btn_label);
 
+	create_alarm_overlay();
+
 	// Create timer
 	update_timer = lv_timer_create(update_timer_cb, 1000, NULL);
 	ESP_LOGI(TAG, "LVGL main interface initialization completed");
@@ -8,6 +8,11 @@
  */
 void lv_mainstart(void);
 
+/**
+ * @brief Draw a pending alarm change at once, called by the LVGL task loop
+ */
+void lv_mainstart_handle_alarm(void);
+
 /**
  * @brief UI update callback function (called by data_handler)
  */
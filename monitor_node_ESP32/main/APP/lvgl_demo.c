@@ -5,6 +5,7 @@
 #include "esp_timer.h"
 #include "lvgl.h"
 #include "lv_mainstart.h"
+#include "alarm_path.h"
 
 /* LV_DEMO_TASK task configuration
  * Includes: task priority, stack size, task handle, create task
@@ -49,6 +50,7 @@ void lvgl_demo(void)
 							(UBaseType_t)LV_DEMO_TASK_PRIO,		  /* Task priority */
 							(TaskHandle_t *)&LV_DEMOTask_Handler, /* Task handle */
 							(BaseType_t)0);						  /* Which core this task runs on */
+	alarm_path_register_ui_task(LV_DEMOTask_Handler); /* Alarms wake the LVGL task */
 
 	/* Create LED test task */
 	xTaskCreatePinnedToCore((TaskFunction_t)led_task,		  /* Task function */
@@ -73,8 +75,9 @@ void lv_demo_task(void *pvParameters)
 
 	while (1)
 	{
-		lv_timer_handler();			   /* LVGL timer */
-		vTaskDelay(pdMS_TO_TICKS(10)); /* Delay 10 milliseconds */
+		lv_mainstart_handle_alarm();				 /* Alarm overlay first */
+		lv_timer_handler();							 /* LVGL timer */
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10)); /* Delay 10 milliseconds, an alarm wakes it early */
 	}
 }
 
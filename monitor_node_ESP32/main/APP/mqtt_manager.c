@@ -1,9 +1,21 @@
 #include "mqtt_manager.h"
+#include "sensor_parser.h"
+#include "sensor_batch.h"
+#include "mqtt_router.h"
+#include "mqtt_reassembly.h"
+#include "mqtt_pipeline.h"
+#include "device_registry.h"
+#include "alarm_path.h"
+#include "log_ring.h"
 #include "mqtt_client.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 static const char *TAG = "MQTT_MANAGER";
 /* MQTT configuration - Please modify according to your MQTT server */
@@ -14,10 +26,13 @@ static const char *TAG = "MQTT_MANAGER";
 
 /* MQTT topic definitions - Match topics sent by STM32 */
 #define TOPIC_SENSOR_DATA "sensor/data"
+#define TOPIC_DEVICE_DATA "sensor/+/data" /* per node, the level is the device id */
+#define TOPIC_SENSOR_BATCH "sensor/batch"	   /* binary batches, see sensor_batch.h */
+#define TOPIC_DEVICE_BATCH "sensor/+/batch"
 #define TOPIC_SENSOR_STATUS "sensor/status"
 #define TOPIC_SENSOR_FAULT "sensor/fault"
 #define TOPIC_SENSOR_CONTROL "sensor/control"
-#define TOPIC_OTA_STATUS "ota/status"
+#define TOPIC_CONTROL_ACK "sensor/control/ack"
 /* MQTT client handle */
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 static mqtt_data_callback_t data_callback = NULL;
@@ -27,63 +42,242 @@ static bool mqtt_connected = false;
 /* Sensor data cache */
 static sensor_data_t sensor_cache = {0};
 
+/* Control frames waiting for their ack, to measure the round trip */
+#define CONTROL_PENDING_SLOTS 8
+typedef struct
+{
+	uint16_t frame_id;
+	bool used;
+	int64_t sent_us;
+} control_pending_t;
+
+static control_pending_t control_pending[CONTROL_PENDING_SLOTS];
+static uint16_t control_frame_id = 0;
+static control_ack_t control_last_ack;
+static bool control_ack_new = false;
+static portMUX_TYPE control_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Parse acks from the controller
+ * Ack format: "17:OK;18:E2" - frame id and status per frame
+ * @param data Data string
+ * @param data_len Data length
+ */
+static void parse_control_ack(const char *data, int data_len)
+{
+	char ack_str[128] = {0};
+	int len = (data_len < sizeof(ack_str) - 1) ? data_len : sizeof(ack_str) - 1;
+	memcpy(ack_str, data, len);
+
+	char *save = NULL;
+	for (char *entry = strtok_r(ack_str, ";", &save); entry; entry = strtok_r(NULL, ";", &save))
+	{
+		char *colon = strchr(entry, ':');
+		if (colon == NULL)
+		{
+			continue;
+		}
+
+		control_ack_t ack = {0};
+		ack.frame_id = (uint16_t)strtoul(entry, NULL, 10);
+		ack.ok = strcmp(colon + 1, "OK") == 0;
+		strncpy(ack.status, colon + 1, sizeof(ack.status) - 1);
+
+		int64_t now = esp_timer_get_time();
+		taskENTER_CRITICAL(&control_lock);
+		for (int i = 0; i < CONTROL_PENDING_SLOTS; i++)
+		{
+			if (control_pending[i].used && control_pending[i].frame_id == ack.frame_id)
+			{
+				ack.rtt_ms = (uint32_t)((now - control_pending[i].sent_us) / 1000);
+				control_pending[i].used = false;
+				break;
+			}
+		}
+		control_last_ack = ack;
+		control_ack_new = true;
+		taskEXIT_CRITICAL(&control_lock);
+
+		LOG_RING_I(TAG, "Control frame %u: %s, rtt %lu ms", ack.frame_id, ack.status, (unsigned long)ack.rtt_ms);
+	}
+}
+
+/**
+ * @brief Device id of a sensor topic
+ * The middle level of sensor/<id>/<kind>, DEVICE_REGISTRY_DEFAULT_ID for
+ * sensor/<kind>; the route filters guarantee the shape
+ * @param kind_len Length of the last level
+ */
+static void sensor_topic_device(const char *topic, int topic_len, int kind_len, const char **id, int *id_len)
+{
+	int prefix = sizeof("sensor/") - 1;
+
+	if (topic_len > prefix + kind_len)
+	{
+		*id = topic + prefix;
+		*id_len = topic_len - prefix - kind_len - 1;
+	}
+	else
+	{
+		*id = DEVICE_REGISTRY_DEFAULT_ID;
+		*id_len = sizeof(DEVICE_REGISTRY_DEFAULT_ID) - 1;
+	}
+}
+
+/**
+ * @brief Hand a device's newest sample to the display if it is the one shown
+ * @param slot Registry slot of the device, -1 without a registry
+ */
+static void show_device_sample(int slot, const sensor_data_t *sample)
+{
+	// the display follows one device, the first to report unless one was chosen
+	if (slot >= 0 && device_registry_get_selected() < 0)
+	{
+		device_registry_select(slot);
+	}
+	if (slot != device_registry_get_selected())
+	{
+		return;
+	}
+	sensor_cache = *sample;
+
+	// Notify application layer of data update
+	if (data_callback)
+	{
+		data_callback(&sensor_cache);
+	}
+}
+
 /**
  * @brief Parse sensor data sent by STM32
  * STM32 data format: "Temp:26.5_Humidity:65.2_SmokePPM:80_AirPPM:300_Lightlux:950_Alarm:0_Updatetime:12345"
+ * Parsed straight from the event buffer, pairs may come in any order
+ * The device is the payload's "Dev:" value, else the middle level of
+ * sensor/<id>/data, else DEVICE_REGISTRY_DEFAULT_ID
+ * @param topic Topic string, not terminated
+ * @param topic_len Topic length
  * @param data Data string
  * @param data_len Data length
  */
-static void parse_stm32_sensor_data(const char *data, int data_len)
+static void parse_stm32_sensor_data(const char *topic, int topic_len, const char *data, int data_len)
 {
-	char data_str[512] = {0};
+	sensor_fields_t fields;
+	sensor_data_t sample;
+	const char *id;
+	int id_len;
+	int slot;
+
+	fields.update_time = 0;
+	if (!sensor_parser_parse(data, data_len, &fields))
+	{
+		// ESP_LOGE(TAG, "Sensor data parsing failed, fields 0x%02lx", (unsigned long)fields.present);
+		return;
+	}
 
-	// Ensure data is null-terminated
-	if (data_len < sizeof(data_str) - 1)
+	if (fields.present & SENSOR_FIELD_DEVICE)
 	{
-		memcpy(data_str, data, data_len);
-		data_str[data_len] = '\0';
+		id = fields.device_id;
+		id_len = fields.device_id_len;
 	}
 	else
 	{
-		ESP_LOGW(TAG, "Sensor data too long, truncating");
-		memcpy(data_str, data, sizeof(data_str) - 1);
-		data_str[sizeof(data_str) - 1] = '\0';
+		sensor_topic_device(topic, topic_len, sizeof("data") - 1, &id, &id_len);
 	}
 
-	// ESP_LOGI(TAG, "Received sensor data: %s", data_str);
+	sample.temperature = fields.temperature;
+	sample.humidity = fields.humidity;
+	sample.smoke_level = fields.smoke_level;
+	sample.air_quality = fields.air_quality;
+	sample.light_intensity = fields.light_intensity;
+	sample.device_alarm = fields.device_alarm;
+	sample.timestamp = esp_timer_get_time() / 1000; // Local timestamp
 
-	// Parse formatted string sent by STM32
-	float temp = 0, humi = 0, smoke = 0;
-	int air_ppm = 0, light_lux = 0, alarm = 0;
-	unsigned long update_time = 0;
+	slot = device_registry_update(id, id_len, &sample, fields.update_time);
+	// alarm changes go to the UI directly, ahead of the batched display frame
+	alarm_path_report(slot, id, id_len, sample.device_alarm, mqtt_pipeline_received_us());
 
-	// Use sscanf to parse formatted string
-	int parsed = sscanf(data_str, "Temp:%f_Humidity:%f_SmokePPM:%f_AirPPM:%d_Lightlux:%d_Alarm:%d_Updatetime:%lu",
-						&temp, &humi, &smoke, &air_ppm, &light_lux, &alarm, &update_time);
+	// ESP_LOGI(TAG, "Parse successful - Temperature:%.1fC Humidity:%.1f%% Smoke:%dppm Air:%dppm Light:%dlux Alarm:%d",
+	//		 fields.temperature, fields.humidity, fields.smoke_level, fields.air_quality, fields.light_intensity, fields.device_alarm);
 
-	if (parsed >= 6)
-	{ // At least parse the first 6 parameters
-		sensor_cache.temperature = temp;
-		sensor_cache.humidity = humi;
-		sensor_cache.smoke_level = (int)smoke;
-		sensor_cache.air_quality = air_ppm;
-		sensor_cache.light_intensity = light_lux;
-		sensor_cache.device_alarm = alarm;
-		sensor_cache.timestamp = esp_timer_get_time() / 1000; // Local timestamp
+	show_device_sample(slot, &sample);
+}
 
-		// ESP_LOGI(TAG, "Parse successful - Temperature:%.1fC Humidity:%.1f%% Smoke:%.0fppm Air:%dppm Light:%dlux Alarm:%d",
-		//		 temp, humi, smoke, air_ppm, light_lux, alarm);
+/**
+ * @brief Apply a binary sample batch (sensor_batch.h)
+ * Decoded in one pass, the registry and the display take the batch's
+ * newest sample in one update each
+ * @param topic Topic string, not terminated
+ * @param topic_len Topic length
+ * @param data Batch payload
+ * @param data_len Payload length
+ */
+static void parse_sensor_batch(const char *topic, int topic_len, const char *data, int data_len)
+{
+	sensor_batch_summary_t batch;
+	sensor_data_t sample;
+	const char *id;
+	int id_len;
+	int slot;
 
-		// Notify application layer of data update
-		if (data_callback)
-		{
-			data_callback(&sensor_cache);
-		}
+	if (!sensor_batch_decode((const uint8_t *)data, data_len, &batch, NULL, NULL))
+	{
+		ESP_LOGW(TAG, "Malformed sensor batch, %d bytes", data_len);
+		return;
+	}
+
+	if (batch.device_id)
+	{
+		id = batch.device_id;
+		id_len = batch.device_id_len;
 	}
 	else
 	{
-		// ESP_LOGE(TAG, "Sensor data parsing failed, parsed %d parameters", parsed);
+		sensor_topic_device(topic, topic_len, sizeof("batch") - 1, &id, &id_len);
 	}
+
+	sample.temperature = batch.last.temperature;
+	sample.humidity = batch.last.humidity;
+	sample.smoke_level = batch.last.smoke_level;
+	sample.air_quality = batch.last.air_quality;
+	sample.light_intensity = batch.last.light_intensity;
+	sample.device_alarm = batch.last.device_alarm;
+	sample.timestamp = esp_timer_get_time() / 1000; // Local timestamp
+
+	slot = device_registry_update_run(id, id_len, &sample, batch.last.time, batch.count, batch.first_alarm,
+									  batch.alarm_rises);
+	alarm_path_report(slot, id, id_len, sample.device_alarm, mqtt_pipeline_received_us());
+	if (batch.alarm_rises > 0 && !sample.device_alarm)
+	{
+		// the alarm rose and cleared inside the batch, the last sample alone hides it
+		alarm_path_report_transient(id, id_len, mqtt_pipeline_received_us());
+	}
+	show_device_sample(slot, &sample);
+}
+
+/* Topic handlers of the manager itself, see mqtt_manager_init() */
+static void on_sensor_data(const char *topic, int topic_len, const char *data, int data_len, void *arg)
+{
+	parse_stm32_sensor_data(topic, topic_len, data, data_len);
+}
+
+static void on_sensor_batch(const char *topic, int topic_len, const char *data, int data_len, void *arg)
+{
+	parse_sensor_batch(topic, topic_len, data, data_len);
+}
+
+static void on_control_ack(const char *topic, int topic_len, const char *data, int data_len, void *arg)
+{
+	parse_control_ack(data, data_len);
+}
+
+static void on_sensor_status(const char *topic, int topic_len, const char *data, int data_len, void *arg)
+{
+	ESP_LOGI(TAG, "Received status information: %.*s", data_len < 256 ? data_len : 255, data);
+}
+
+static void on_sensor_fault(const char *topic, int topic_len, const char *data, int data_len, void *arg)
+{
+	ESP_LOGI(TAG, "Received fault information: %.*s", data_len < 256 ? data_len : 255, data);
 }
 
 /**
@@ -100,13 +294,17 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 		ESP_LOGI(TAG, "MQTT connection successful");
 		mqtt_connected = true;
 
-		// Subscribe to STM32 sensor topics
-		esp_mqtt_client_subscribe(client, TOPIC_SENSOR_DATA, 1);
-		esp_mqtt_client_subscribe(client, TOPIC_SENSOR_STATUS, 1);
-		esp_mqtt_client_subscribe(client, TOPIC_SENSOR_FAULT, 1);
-		esp_mqtt_client_subscribe(client, TOPIC_OTA_STATUS, 1);
+		// Subscribe to every topic a module registered a handler for
+		{
+			const char *filters[MQTT_ROUTER_MAX_ROUTES];
+			int count = mqtt_router_get_filters(filters, MQTT_ROUTER_MAX_ROUTES);
 
-		ESP_LOGI(TAG, "Subscribed to STM32 sensor topics");
+			for (int i = 0; i < count; i++)
+			{
+				esp_mqtt_client_subscribe(client, filters[i], 1);
+			}
+			ESP_LOGI(TAG, "Subscribed to %d topics", count);
+		}
 
 		// Notify application layer of connection status
 		if (status_callback)
@@ -135,54 +333,16 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 		break;
 
 	case MQTT_EVENT_PUBLISHED:
-		ESP_LOGI(TAG, "Publish successful, msg_id=%d", event->msg_id);
+		LOG_RING_I(TAG, "Publish successful, msg_id=%d", event->msg_id);
 		break;
 
 	case MQTT_EVENT_DATA:
-		ESP_LOGI(TAG, "Received MQTT data");
-
-		// Handle received data
-		char topic[64] = {0};
-		if (event->topic_len < sizeof(topic))
-		{
-			memcpy(topic, event->topic, event->topic_len);
-			topic[event->topic_len] = '\0';
+		ESP_LOGD(TAG, "Received MQTT data");
 
-			// Handle different types of data based on topic
-			if (strcmp(topic, TOPIC_SENSOR_DATA) == 0)
-			{
-				// Handle sensor data
-				parse_stm32_sensor_data(event->data, event->data_len);
-			}
-			else if (strcmp(topic, TOPIC_SENSOR_STATUS) == 0)
-			{
-				// Handle status information
-				char status_str[256] = {0};
-				int len = (event->data_len < sizeof(status_str) - 1) ? event->data_len : sizeof(status_str) - 1;
-				memcpy(status_str, event->data, len);
-				ESP_LOGI(TAG, "Received status information: %s", status_str);
-			}
-			else if (strcmp(topic, TOPIC_SENSOR_FAULT) == 0)
-			{
-				// Handle fault information
-				char fault_str[256] = {0};
-				int len = (event->data_len < sizeof(fault_str) - 1) ? event->data_len : sizeof(fault_str) - 1;
-				memcpy(fault_str, event->data, len);
-				ESP_LOGI(TAG, "Received fault information: %s", fault_str);
-			}
-			else if (strcmp(topic, TOPIC_OTA_STATUS) == 0)
-			{
-				char status_str[8] = {0};
-				int len = (event->data_len < sizeof(status_str) - 1) ? event->data_len : sizeof(status_str) - 1;
-				memcpy(status_str, event->data, len);
-
-				int ota_available = atoi(status_str);
-				ESP_LOGI(TAG, "Received OTA status: %d", ota_available);
-				// Notify interface to update OTA notification
-				extern void update_ota_notification(bool available);
-				update_ota_notification(ota_available == 1);
-			}
-		}
+		// Payloads larger than the client buffer arrive in several events,
+		// complete messages are queued for the pipeline worker
+		mqtt_reassembly_feed(event->topic, event->topic_len, event->data, event->data_len,
+							 event->current_data_offset, event->total_data_len);
 		break;
 
 	case MQTT_EVENT_ERROR:
@@ -210,6 +370,27 @@ esp_err_t mqtt_manager_init(mqtt_data_callback_t data_cb, mqtt_status_callback_t
 	data_callback = data_cb;
 	status_callback = status_cb;
 
+	mqtt_router_register(TOPIC_SENSOR_DATA, on_sensor_data, NULL);
+	mqtt_router_register(TOPIC_DEVICE_DATA, on_sensor_data, NULL);
+	mqtt_router_register(TOPIC_SENSOR_BATCH, on_sensor_batch, NULL);
+	mqtt_router_register(TOPIC_DEVICE_BATCH, on_sensor_batch, NULL);
+	mqtt_router_register(TOPIC_SENSOR_STATUS, on_sensor_status, NULL);
+	mqtt_router_register(TOPIC_SENSOR_FAULT, on_sensor_fault, NULL);
+	mqtt_router_register(TOPIC_CONTROL_ACK, on_control_ack, NULL);
+
+	if (device_registry_init() != ESP_OK)
+	{
+		ESP_LOGW(TAG, "No device registry, the display shows every node");
+	}
+	if (mqtt_reassembly_init() != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Fragmented messages will be dropped");
+	}
+	if (mqtt_pipeline_init() != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Messages will be handled on the MQTT task");
+	}
+
 	esp_mqtt_client_config_t mqtt_cfg = {
 		.broker.address.uri = MQTT_BROKER_URI,
 		.credentials.client_id = MQTT_CLIENT_ID,
@@ -324,6 +505,25 @@ int mqtt_manager_send_control_command(const char *command)
 	return esp_mqtt_client_publish(mqtt_client, TOPIC_SENSOR_CONTROL, command, strlen(command), 1, 0);
 }
 
+/**
+ * @brief Register a topic handler and subscribe to its filter
+ * Handlers registered before the connection is up are subscribed on connect
+ * @param filter Topic filter, '+' and '#' wildcards allowed
+ * @param handler Called on the MQTT pipeline worker for each matching message
+ * @param arg Passed to the handler
+ * @retval ESP_OK Success, other values failure
+ */
+esp_err_t mqtt_manager_subscribe(const char *filter, mqtt_topic_handler_t handler, void *arg)
+{
+	esp_err_t ret = mqtt_router_register(filter, handler, arg);
+
+	if (ret == ESP_OK && mqtt_connected && mqtt_client != NULL)
+	{
+		esp_mqtt_client_subscribe(mqtt_client, filter, 1);
+	}
+	return ret;
+}
+
 /**
  * @brief Get latest sensor data
  * @retval Sensor data pointer
@@ -331,4 +531,88 @@ int mqtt_manager_send_control_command(const char *command)
 const sensor_data_t *mqtt_manager_get_sensor_data(void)
 {
 	return &sensor_cache;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Send several actuator commands in one control frame
+ * Frame format: "<id>:<cmd>;<cmd>..." with cmd = actuator, op, optional value
+ * @param cmds Commands, executed in order
+ * @param count Number of commands
+ * @retval Frame ID echoed in the ack, -1 indicates failure
+ */
+int mqtt_manager_send_control_frame(const control_cmd_t *cmds, int count)
+{
+	char frame[128];
+	int pos;
+	uint16_t frame_id;
+
+	if (!mqtt_connected || mqtt_client == NULL || count <= 0 || count > CONTROL_MAX_BATCH)
+	{
+		ESP_LOGW(TAG, "Cannot send control frame");
+		return -1;
+	}
+
+	taskENTER_CRITICAL(&control_lock);
+	frame_id = ++control_frame_id;
+	taskEXIT_CRITICAL(&control_lock);
+
+	pos = snprintf(frame, sizeof(frame), "%u:", frame_id);
+	for (int i = 0; i < count; i++)
+	{
+		pos += snprintf(&frame[pos], sizeof(frame) - pos, "%s%c%c", i ? ";" : "", cmds[i].actuator, cmds[i].op);
+		if (cmds[i].value)
+		{
+			pos += snprintf(&frame[pos], sizeof(frame) - pos, "%u", cmds[i].value);
+		}
+	}
+
+	// Stamp before publishing, the ack can arrive before publish returns
+	taskENTER_CRITICAL(&control_lock);
+	int slot = 0;
+	for (int i = 0; i < CONTROL_PENDING_SLOTS; i++)
+	{
+		if (!control_pending[i].used)
+		{
+			slot = i;
+			break;
+		}
+		// all in use: reuse the oldest, its ack is likely lost
+		if (control_pending[i].sent_us < control_pending[slot].sent_us)
+		{
+			slot = i;
+		}
+	}
+	control_pending[slot].frame_id = frame_id;
+	control_pending[slot].used = true;
+	control_pending[slot].sent_us = esp_timer_get_time();
+	taskEXIT_CRITICAL(&control_lock);
+
+	if (esp_mqtt_client_publish(mqtt_client, TOPIC_SENSOR_CONTROL, frame, pos, 1, 0) < 0)
+	{
+		taskENTER_CRITICAL(&control_lock);
+		control_pending[slot].used = false;
+		taskEXIT_CRITICAL(&control_lock);
+		return -1;
+	}
+	return frame_id;
+}
+
+/**
+ * @brief Fetch the newest control frame ack
+ * @param ack Filled when a new ack arrived since the last call
+ * @retval true New ack returned, false nothing new
+ */
+bool mqtt_manager_get_control_ack(control_ack_t *ack)
+{
+	bool fresh;
+
+	taskENTER_CRITICAL(&control_lock);
+	fresh = control_ack_new;
+	if (fresh)
+	{
+		*ack = control_last_ack;
+		control_ack_new = false;
+	}
+	taskEXIT_CRITICAL(&control_lock);
+	return fresh;
+}
@@ -2,9 +2,12 @@
 #define __MQTT_MANAGER_H
 
 #include "esp_err.h"
+#include "mqtt_router.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+#define CONTROL_MAX_BATCH 8 /* commands per control frame, as on the controller */
+
 /* MQTT connection status enumeration */
 typedef enum
 {
@@ -26,6 +29,24 @@ typedef struct
 	uint64_t timestamp;	 /* Timestamp (milliseconds) */
 } sensor_data_t;
 
+/* One actuator command of a control frame, see the op table in the
+ * controller's task_modem.c */
+typedef struct
+{
+	char actuator;	/* 'B' buzzer, 'M' motor */
+	char op;		/* e.g. 'N' on, 'F' off/forward, 'P' beep */
+	uint16_t value; /* duration, duty ... 0 when the op takes none */
+} control_cmd_t;
+
+/* Acknowledgement of a control frame */
+typedef struct
+{
+	uint16_t frame_id; /* id returned by mqtt_manager_send_control_frame() */
+	bool ok;
+	char status[8];	 /* "OK", "E<n>" invalid command n, "Q<n>" controller queue full */
+	uint32_t rtt_ms; /* publish to ack, 0 if the frame was not pending */
+} control_ack_t;
+
 /* Callback function type definitions */
 typedef void (*mqtt_data_callback_t)(const sensor_data_t *data);
 typedef void (*mqtt_status_callback_t)(mqtt_status_t status);
@@ -74,6 +95,31 @@ int mqtt_manager_publish(const char *topic, const char *data, int data_len);
  */
 int mqtt_manager_send_control_command(const char *command);
 
+/**
+ * @brief Send several actuator commands in one control frame
+ * @param cmds Commands, executed in order
+ * @param count Number of commands, 1..CONTROL_MAX_BATCH
+ * @retval Frame ID echoed in the ack, -1 indicates failure
+ */
+int mqtt_manager_send_control_frame(const control_cmd_t *cmds, int count);
+
+/**
+ * @brief Fetch the newest control frame ack
+ * @param ack Filled when a new ack arrived since the last call
+ * @retval true New ack returned, false nothing new
+ */
+bool mqtt_manager_get_control_ack(control_ack_t *ack);
+
+/**
+ * @brief Register a topic handler and subscribe to its filter
+ * Handlers registered before the connection is up are subscribed on connect
+ * @param filter Topic filter, '+' and '#' wildcards allowed
+ * @param handler Called on the MQTT pipeline worker for each matching message
+ * @param arg Passed to the handler
+ * @retval ESP_OK Success, other values failure
+ */
+esp_err_t mqtt_manager_subscribe(const char *filter, mqtt_topic_handler_t handler, void *arg);
+
 /**
  * @brief Get latest sensor data
  * @retval Sensor data pointer
@@ -0,0 +1,231 @@
+#include "mqtt_pipeline.h"
+#include "mqtt_router.h"
+#include "mqtt_reassembly.h"
+#include "data_handler.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "MQTT_PIPELINE";
+
+/*
+ * The MQTT event handler only queues complete messages; parsing, the data
+ * handler, logging and UI notification run on this worker, pinned to the
+ * core the LVGL task does not use. The queue is a single producer, single
+ * consumer ring: the MQTT task advances head, the worker advances tail,
+ * each only reads the other's index. Small payloads are copied into the
+ * slot, large ones travel in a reassembly pool block.
+ */
+#define PIPELINE_TASK_PRIO 4 /* below the MQTT client task (5), keepalives go first */
+#define PIPELINE_STK_SIZE 4 * 1024
+#define PIPELINE_CORE 1 /* LVGL runs on core 0 */
+
+typedef struct
+{
+	char topic[MQTT_PIPELINE_TOPIC_LEN];
+	int topic_len;
+	const char *data; /* inline_data or a pool block */
+	int data_len;
+	int block;
+	int64_t received_us;
+	char inline_data[MQTT_PIPELINE_INLINE_SIZE];
+} pipeline_slot_t;
+
+static pipeline_slot_t ring[MQTT_PIPELINE_DEPTH];
+static uint32_t ring_head = 0; /* written by the MQTT task */
+static uint32_t ring_tail = 0; /* written by the worker */
+static TaskHandle_t pipeline_task_handle = NULL;
+static mqtt_pipeline_stats_t stats;
+static uint64_t queue_us_total = 0;
+static uint64_t handle_us_total = 0;
+static int64_t handling_received_us = 0; /* message being dispatched */
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void pipeline_count_drop(uint32_t *counter, int block)
+{
+	mqtt_reassembly_block_free(block);
+	taskENTER_CRITICAL(&stats_lock);
+	(*counter)++;
+	taskEXIT_CRITICAL(&stats_lock);
+}
+
+void mqtt_pipeline_submit(const char *topic, int topic_len, const char *data, int data_len, int block)
+{
+	uint32_t head = ring_head;
+	uint32_t depth;
+	pipeline_slot_t *slot;
+
+	if (pipeline_task_handle == NULL)
+	{
+		handling_received_us = esp_timer_get_time();
+		mqtt_router_dispatch(topic, topic_len, data, data_len);
+		mqtt_reassembly_block_free(block);
+		return;
+	}
+	if (topic_len >= MQTT_PIPELINE_TOPIC_LEN)
+	{
+		pipeline_count_drop(&stats.drop_topic, block);
+		return;
+	}
+	if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) >= MQTT_PIPELINE_DEPTH)
+	{
+		pipeline_count_drop(&stats.drop_full, block);
+		return;
+	}
+
+	slot = &ring[head & (MQTT_PIPELINE_DEPTH - 1)];
+	memcpy(slot->topic, topic, topic_len);
+	slot->topic[topic_len] = '\0';
+	slot->topic_len = topic_len;
+	slot->data_len = data_len;
+	slot->block = block;
+	if (block >= 0)
+	{
+		slot->data = data;
+	}
+	else if (data_len <= MQTT_PIPELINE_INLINE_SIZE)
+	{
+		memcpy(slot->inline_data, data, data_len);
+		slot->data = slot->inline_data;
+	}
+	else
+	{
+		// the event buffer is reused after we return, park the payload
+		char *copy;
+
+		slot->block = data_len <= MQTT_REASSEMBLY_BLOCK_SIZE ? mqtt_reassembly_block_alloc(&copy) : -1;
+		if (slot->block < 0)
+		{
+			pipeline_count_drop(&stats.drop_no_buffer, -1);
+			return;
+		}
+		memcpy(copy, data, data_len);
+		slot->data = copy;
+	}
+	slot->received_us = esp_timer_get_time();
+
+	__atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+
+	depth = head + 1 - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+	taskENTER_CRITICAL(&stats_lock);
+	if (depth > stats.depth_peak)
+	{
+		stats.depth_peak = depth;
+	}
+	taskEXIT_CRITICAL(&stats_lock);
+
+	xTaskNotifyGive(pipeline_task_handle);
+}
+
+/**
+ * @brief Handle up to MQTT_PIPELINE_BATCH queued messages
+ * The data handler publishes the batch's last display frame once
+ * @retval Messages handled
+ */
+static int pipeline_run_batch(void)
+{
+	uint32_t tail = ring_tail;
+	int count = 0;
+	int64_t start;
+	int64_t now;
+
+	data_handler_begin_batch();
+	while (count < MQTT_PIPELINE_BATCH && tail != __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE))
+	{
+		pipeline_slot_t *slot = &ring[tail & (MQTT_PIPELINE_DEPTH - 1)];
+		uint32_t queue_us;
+		uint32_t handle_us;
+
+		start = esp_timer_get_time();
+		queue_us = (uint32_t)(start - slot->received_us);
+		handling_received_us = slot->received_us;
+		mqtt_router_dispatch(slot->topic, slot->topic_len, slot->data, slot->data_len);
+		handle_us = (uint32_t)(esp_timer_get_time() - start);
+		mqtt_reassembly_block_free(slot->block);
+
+		// the slot belongs to the producer again
+		__atomic_store_n(&ring_tail, ++tail, __ATOMIC_RELEASE);
+		count++;
+
+		taskENTER_CRITICAL(&stats_lock);
+		stats.messages++;
+		stats.queue_us_last = queue_us;
+		stats.handle_us_last = handle_us;
+		queue_us_total += queue_us;
+		handle_us_total += handle_us;
+		if (queue_us > stats.queue_us_max)
+		{
+			stats.queue_us_max = queue_us;
+		}
+		if (handle_us > stats.handle_us_max)
+		{
+			stats.handle_us_max = handle_us;
+		}
+		taskEXIT_CRITICAL(&stats_lock);
+	}
+
+	start = esp_timer_get_time();
+	data_handler_end_batch();
+	now = esp_timer_get_time();
+
+	taskENTER_CRITICAL(&stats_lock);
+	stats.batches++;
+	stats.apply_us_last = (uint32_t)(now - start);
+	if (stats.apply_us_last > stats.apply_us_max)
+	{
+		stats.apply_us_max = stats.apply_us_last;
+	}
+	taskEXIT_CRITICAL(&stats_lock);
+	return count;
+}
+
+static void pipeline_task(void *pvParameters)
+{
+	while (1)
+	{
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while (pipeline_run_batch() == MQTT_PIPELINE_BATCH)
+		{
+			// a full batch, more may be waiting
+		}
+	}
+}
+
+esp_err_t mqtt_pipeline_init(void)
+{
+	BaseType_t ret;
+
+	if (pipeline_task_handle != NULL)
+	{
+		return ESP_OK;
+	}
+	ret = xTaskCreatePinnedToCore(pipeline_task, "mqtt_pipeline", PIPELINE_STK_SIZE, NULL,
+								  PIPELINE_TASK_PRIO, &pipeline_task_handle, PIPELINE_CORE);
+	if (ret != pdPASS)
+	{
+		ESP_LOGE(TAG, "Failed to create pipeline task");
+		pipeline_task_handle = NULL;
+		return ESP_FAIL;
+	}
+	ESP_LOGI(TAG, "Pipeline worker on core %d, %d slots", PIPELINE_CORE, MQTT_PIPELINE_DEPTH);
+	return ESP_OK;
+}
+
+int64_t mqtt_pipeline_received_us(void)
+{
+	return handling_received_us;
+}
+
+void mqtt_pipeline_get_stats(mqtt_pipeline_stats_t *out)
+{
+	uint32_t depth = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+
+	taskENTER_CRITICAL(&stats_lock);
+	*out = stats;
+	out->queue_us_avg = stats.messages ? (uint32_t)(queue_us_total / stats.messages) : 0;
+	out->handle_us_avg = stats.messages ? (uint32_t)(handle_us_total / stats.messages) : 0;
+	taskEXIT_CRITICAL(&stats_lock);
+	out->depth = depth;
+}
@@ -0,0 +1,65 @@
+#ifndef __MQTT_PIPELINE_H
+#define __MQTT_PIPELINE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_PIPELINE_DEPTH 32		  /* queued messages, a power of two */
+#define MQTT_PIPELINE_BATCH 8		  /* messages applied to the data handler together */
+#define MQTT_PIPELINE_INLINE_SIZE 160 /* payloads up to this are copied into the queue */
+#define MQTT_PIPELINE_TOPIC_LEN 128	  /* longest topic, with the '\0' */
+
+/* Queue counters and per-stage latency */
+typedef struct
+{
+	uint32_t depth;			 /* messages waiting now */
+	uint32_t depth_peak;
+	uint32_t messages;		 /* messages handled */
+	uint32_t batches;
+	uint32_t drop_full;		 /* queue full */
+	uint32_t drop_no_buffer; /* large payload and no pool block free */
+	uint32_t drop_topic;	 /* topic longer than MQTT_PIPELINE_TOPIC_LEN - 1 */
+	uint32_t queue_us_last;	 /* receipt to dequeue */
+	uint32_t queue_us_max;
+	uint32_t queue_us_avg;
+	uint32_t handle_us_last; /* topic handlers of one message */
+	uint32_t handle_us_max;
+	uint32_t handle_us_avg;
+	uint32_t apply_us_last;	 /* batch applied to the data handler */
+	uint32_t apply_us_max;
+} mqtt_pipeline_stats_t;
+
+/* Function declarations */
+
+/**
+ * @brief Start the worker task
+ * Until it runs, submitted messages are dispatched on the caller's task
+ * @retval ESP_OK Success, ESP_FAIL task not created
+ */
+esp_err_t mqtt_pipeline_init(void);
+
+/**
+ * @brief Queue a complete message for the worker, MQTT task only
+ * @param topic Topic, copied
+ * @param topic_len Topic length
+ * @param data Payload, copied unless it is in a pool block
+ * @param data_len Payload length
+ * @param block Reassembly block holding data, freed once handled, -1 if none
+ */
+void mqtt_pipeline_submit(const char *topic, int topic_len, const char *data, int data_len, int block);
+
+/**
+ * @brief When the message being handled arrived from the MQTT client
+ * Valid inside a topic handler only, for latencies measured from receipt
+ * @retval esp_timer_get_time() at receipt (us)
+ */
+int64_t mqtt_pipeline_received_us(void);
+
+/**
+ * @brief Get queue counters and stage latencies
+ * @param stats Output
+ */
+void mqtt_pipeline_get_stats(mqtt_pipeline_stats_t *stats);
+
+#endif /* __MQTT_PIPELINE_H */
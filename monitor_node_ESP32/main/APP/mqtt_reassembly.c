@@ -0,0 +1,208 @@
+#include "mqtt_reassembly.h"
+#include "mqtt_pipeline.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "MQTT_REASM";
+
+/*
+ * The MQTT client splits a message larger than its receive buffer into
+ * several MQTT_EVENT_DATA events, back to back on its task. Only the first
+ * one carries the topic. Whole messages bypass this module's buffers, a
+ * fragmented one is collected into a pool block and handed to the
+ * pipeline once complete; the block is freed after its handlers ran. The
+ * payload area is allocated once at init, no malloc per message.
+ */
+typedef struct
+{
+	char topic[MQTT_REASSEMBLY_TOPIC_LEN];
+	int topic_len;
+	int len;   /* bytes collected */
+	int total; /* message length */
+	char *data;
+} reasm_block_t;
+
+static reasm_block_t blocks[MQTT_REASSEMBLY_BLOCKS];
+static char *pool = NULL;
+static uint32_t free_mask = 0; /* bit n set: block n free */
+static int current = -1;	   /* block being filled */
+static bool skipping = false;  /* rest of a dropped message */
+static mqtt_reassembly_stats_t stats;
+static portMUX_TYPE reasm_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t mqtt_reassembly_init(void)
+{
+	size_t size = (size_t)MQTT_REASSEMBLY_BLOCKS * MQTT_REASSEMBLY_BLOCK_SIZE;
+
+	if (pool != NULL)
+	{
+		return ESP_OK;
+	}
+
+	pool = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	stats.in_psram = pool != NULL;
+	if (pool == NULL)
+	{
+		pool = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+	}
+	if (pool == NULL)
+	{
+		ESP_LOGE(TAG, "Cannot allocate %u byte reassembly pool", (unsigned)size);
+		return ESP_ERR_NO_MEM;
+	}
+
+	for (int i = 0; i < MQTT_REASSEMBLY_BLOCKS; i++)
+	{
+		blocks[i].data = pool + (size_t)i * MQTT_REASSEMBLY_BLOCK_SIZE;
+	}
+	taskENTER_CRITICAL(&reasm_lock);
+	free_mask = (1u << MQTT_REASSEMBLY_BLOCKS) - 1;
+	stats.blocks_total = MQTT_REASSEMBLY_BLOCKS;
+	taskEXIT_CRITICAL(&reasm_lock);
+
+	ESP_LOGI(TAG, "Reassembly pool %d x %d bytes in %s", MQTT_REASSEMBLY_BLOCKS, MQTT_REASSEMBLY_BLOCK_SIZE,
+			 stats.in_psram ? "PSRAM" : "internal RAM");
+	return ESP_OK;
+}
+
+int mqtt_reassembly_block_alloc(char **data)
+{
+	int index = -1;
+
+	taskENTER_CRITICAL(&reasm_lock);
+	if (free_mask)
+	{
+		index = __builtin_ctz(free_mask);
+		free_mask &= ~(1u << index);
+		stats.blocks_in_use++;
+		if (stats.blocks_in_use > stats.blocks_peak)
+		{
+			stats.blocks_peak = stats.blocks_in_use;
+		}
+	}
+	taskEXIT_CRITICAL(&reasm_lock);
+	if (index >= 0)
+	{
+		*data = blocks[index].data;
+	}
+	return index;
+}
+
+void mqtt_reassembly_block_free(int index)
+{
+	if (index < 0 || index >= MQTT_REASSEMBLY_BLOCKS)
+	{
+		return;
+	}
+	taskENTER_CRITICAL(&reasm_lock);
+	free_mask |= 1u << index;
+	stats.blocks_in_use--;
+	taskEXIT_CRITICAL(&reasm_lock);
+}
+
+/**
+ * @brief Count a dropped message, its remaining fragments are ignored
+ */
+static void reasm_drop(uint32_t *counter, bool more_follow)
+{
+	if (current >= 0)
+	{
+		mqtt_reassembly_block_free(current);
+		current = -1;
+	}
+	taskENTER_CRITICAL(&reasm_lock);
+	(*counter)++;
+	taskEXIT_CRITICAL(&reasm_lock);
+	skipping = more_follow;
+}
+
+static void reasm_count_message(bool reassembled)
+{
+	taskENTER_CRITICAL(&reasm_lock);
+	stats.messages++;
+	if (reassembled)
+	{
+		stats.reassembled++;
+	}
+	taskEXIT_CRITICAL(&reasm_lock);
+}
+
+void mqtt_reassembly_feed(const char *topic, int topic_len, const char *data, int data_len, int offset, int total_len)
+{
+	reasm_block_t *b;
+	char *block_data;
+
+	if (offset == 0)
+	{
+		// a new message while one is open: the open one lost its tail
+		if (current >= 0)
+		{
+			ESP_LOGW(TAG, "Message on %.*s incomplete, dropped", blocks[current].topic_len, blocks[current].topic);
+			reasm_drop(&stats.drop_incomplete, false);
+		}
+		skipping = false;
+
+		if (data_len >= total_len)
+		{
+			reasm_count_message(false);
+			mqtt_pipeline_submit(topic, topic_len, data, data_len, -1);
+			return;
+		}
+		if (total_len > MQTT_REASSEMBLY_BLOCK_SIZE || topic_len >= MQTT_REASSEMBLY_TOPIC_LEN)
+		{
+			ESP_LOGW(TAG, "%d byte message on %.*s too large, dropped", total_len, topic_len, topic);
+			reasm_drop(&stats.drop_too_large, true);
+			return;
+		}
+		current = mqtt_reassembly_block_alloc(&block_data);
+		if (current < 0)
+		{
+			ESP_LOGW(TAG, "No reassembly buffer free, message on %.*s dropped", topic_len, topic);
+			reasm_drop(&stats.drop_no_buffer, true);
+			return;
+		}
+		b = &blocks[current];
+		memcpy(b->topic, topic, topic_len);
+		b->topic[topic_len] = '\0';
+		b->topic_len = topic_len;
+		b->len = 0;
+		b->total = total_len;
+	}
+	else if (skipping)
+	{
+		return;
+	}
+	else if (current < 0 || offset != blocks[current].len || total_len != blocks[current].total)
+	{
+		reasm_drop(&stats.drop_incomplete, true);
+		return;
+	}
+	b = &blocks[current];
+
+	if (data_len > b->total - b->len)
+	{
+		reasm_drop(&stats.drop_incomplete, true);
+		return;
+	}
+	memcpy(b->data + b->len, data, data_len);
+	b->len += data_len;
+	if (b->len < b->total)
+	{
+		return;
+	}
+
+	// complete, the pipeline frees the block once the handlers ran
+	current = -1;
+	reasm_count_message(true);
+	mqtt_pipeline_submit(b->topic, b->topic_len, b->data, b->len, (int)(b - blocks));
+}
+
+void mqtt_reassembly_get_stats(mqtt_reassembly_stats_t *out)
+{
+	taskENTER_CRITICAL(&reasm_lock);
+	*out = stats;
+	taskEXIT_CRITICAL(&reasm_lock);
+}
@@ -0,0 +1,67 @@
+#ifndef __MQTT_REASSEMBLY_H
+#define __MQTT_REASSEMBLY_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_REASSEMBLY_BLOCKS 4		   /* messages assembled at once */
+#define MQTT_REASSEMBLY_BLOCK_SIZE 16384 /* largest payload accepted */
+#define MQTT_REASSEMBLY_TOPIC_LEN 128	   /* longest topic kept, with the '\0' */
+
+/* Pool and drop counters */
+typedef struct
+{
+	uint32_t blocks_total;	   /* blocks in the pool, 0 if the pool could not be allocated */
+	uint32_t blocks_in_use;
+	uint32_t blocks_peak;
+	bool in_psram;			   /* pool lives in external RAM */
+	uint32_t messages;		   /* messages handed to dispatch */
+	uint32_t reassembled;	   /* of those, built from several fragments */
+	uint32_t drop_too_large;   /* payload above MQTT_REASSEMBLY_BLOCK_SIZE or topic too long */
+	uint32_t drop_no_buffer;   /* every block in use */
+	uint32_t drop_incomplete;  /* fragment missing or out of order */
+} mqtt_reassembly_stats_t;
+
+/* Function declarations */
+
+/**
+ * @brief Allocate the block pool, in PSRAM when the board has it
+ * @retval ESP_OK Success, ESP_ERR_NO_MEM pool not allocated
+ */
+esp_err_t mqtt_reassembly_init(void);
+
+/**
+ * @brief Feed one MQTT_EVENT_DATA fragment
+ * A whole message goes to mqtt_pipeline_submit() from the event buffer,
+ * fragments are collected and the message submitted with its block when
+ * the last one arrives
+ * @param topic Topic, only the first fragment carries it
+ * @param topic_len Topic length, 0 on later fragments
+ * @param data Fragment payload
+ * @param data_len Fragment length
+ * @param offset Offset of the fragment in the message
+ * @param total_len Length of the whole message
+ */
+void mqtt_reassembly_feed(const char *topic, int topic_len, const char *data, int data_len, int offset, int total_len);
+
+/**
+ * @brief Take a block from the pool
+ * @param data Set to the block's MQTT_REASSEMBLY_BLOCK_SIZE bytes
+ * @retval Block index, -1 if every block is in use
+ */
+int mqtt_reassembly_block_alloc(char **data);
+
+/**
+ * @brief Return a block to the pool
+ * @param index Block index, negative values are ignored
+ */
+void mqtt_reassembly_block_free(int index);
+
+/**
+ * @brief Get pool occupancy and drop counters
+ * @param stats Output
+ */
+void mqtt_reassembly_get_stats(mqtt_reassembly_stats_t *stats);
+
+#endif /* __MQTT_REASSEMBLY_H */
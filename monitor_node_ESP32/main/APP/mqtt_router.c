@@ -0,0 +1,344 @@
+#include "mqtt_router.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "MQTT_ROUTER";
+
+/*
+ * Filters are stored as a trie with one node per topic level. '+' is kept
+ * as an ordinary child and tried next to the exact child while matching,
+ * a trailing '#' hangs its handlers on the node of the level before it.
+ * Nodes are filled before they are linked in, so dispatch walks the trie
+ * without a lock while modules register.
+ */
+#define ROUTER_NONE (-1)
+#define ROUTER_ROOT 0
+
+typedef struct
+{
+	const char *level; /* points into the filter of the route that added it */
+	uint8_t level_len;
+	int8_t child;	   /* first child */
+	int8_t sibling;	   /* next child of the same parent */
+	int8_t route;	   /* routes of the filter ending here */
+	int8_t hash_route; /* routes of "<this level>/#" */
+} router_node_t;
+
+typedef struct
+{
+	char filter[MQTT_ROUTER_FILTER_LEN];
+	mqtt_topic_handler_t handler;
+	void *arg;
+	int8_t next; /* next route on the same node */
+	uint32_t messages;
+	uint32_t window_count;
+	uint32_t rate;
+	int64_t window_start_us;
+	uint32_t handler_us_last;
+	uint32_t handler_us_max;
+	uint64_t handler_us_total;
+} router_route_t;
+
+typedef struct
+{
+	const char *topic;
+	int topic_len;
+	const char *data;
+	int data_len;
+	int called;
+} router_msg_t;
+
+static router_node_t nodes[MQTT_ROUTER_MAX_NODES] = {
+	[ROUTER_ROOT] = {NULL, 0, ROUTER_NONE, ROUTER_NONE, ROUTER_NONE, ROUTER_NONE},
+};
+static int node_count = 1;
+static router_route_t routes[MQTT_ROUTER_MAX_ROUTES];
+static int route_count = 0;
+static uint32_t unmatched = 0;
+static portMUX_TYPE router_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Check '+' and '#' stand alone and '#' comes last
+ */
+static bool router_filter_valid(const char *filter, int len)
+{
+	if (len == 0 || len >= MQTT_ROUTER_FILTER_LEN)
+	{
+		return false;
+	}
+	for (int i = 0; i < len; i++)
+	{
+		if (filter[i] != '+' && filter[i] != '#')
+		{
+			continue;
+		}
+		if ((i > 0 && filter[i - 1] != '/') || (i + 1 < len && filter[i + 1] != '/'))
+		{
+			return false;
+		}
+		if (filter[i] == '#' && i + 1 != len)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Child of parent for one filter level, added when missing
+ * @retval Node index, ROUTER_NONE when the node pool is full
+ */
+static int router_child(int parent, const char *level, int level_len)
+{
+	int i;
+
+	for (i = nodes[parent].child; i != ROUTER_NONE; i = nodes[i].sibling)
+	{
+		if (nodes[i].level_len == level_len && memcmp(nodes[i].level, level, level_len) == 0)
+		{
+			return i;
+		}
+	}
+	if (node_count >= MQTT_ROUTER_MAX_NODES)
+	{
+		return ROUTER_NONE;
+	}
+
+	i = node_count++;
+	nodes[i].level = level;
+	nodes[i].level_len = (uint8_t)level_len;
+	nodes[i].child = ROUTER_NONE;
+	nodes[i].route = ROUTER_NONE;
+	nodes[i].hash_route = ROUTER_NONE;
+	nodes[i].sibling = nodes[parent].child;
+	nodes[parent].child = (int8_t)i;
+	return i;
+}
+
+/**
+ * @brief Append a route to the end of a node's route list
+ */
+static void router_append(int8_t *head, int route)
+{
+	while (*head != ROUTER_NONE)
+	{
+		head = &routes[*head].next;
+	}
+	*head = (int8_t)route;
+}
+
+esp_err_t mqtt_router_register(const char *filter, mqtt_topic_handler_t handler, void *arg)
+{
+	router_route_t *r;
+	const char *p;
+	const char *end;
+	int node = ROUTER_ROOT;
+	int index;
+	esp_err_t ret = ESP_OK;
+
+	if (filter == NULL || handler == NULL || !router_filter_valid(filter, strlen(filter)))
+	{
+		ESP_LOGE(TAG, "Invalid topic filter: %s", filter ? filter : "(null)");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	taskENTER_CRITICAL(&router_lock);
+	if (route_count >= MQTT_ROUTER_MAX_ROUTES)
+	{
+		taskEXIT_CRITICAL(&router_lock);
+		ESP_LOGE(TAG, "Route table full, %s not registered", filter);
+		return ESP_ERR_NO_MEM;
+	}
+	index = route_count;
+	r = &routes[index];
+	memset(r, 0, sizeof(*r));
+	strcpy(r->filter, filter);
+	r->handler = handler;
+	r->arg = arg;
+	r->next = ROUTER_NONE;
+
+	// levels point into the route's own copy of the filter
+	p = r->filter;
+	end = p + strlen(p);
+	while (true)
+	{
+		const char *slash = memchr(p, '/', end - p);
+		const char *level_end = slash ? slash : end;
+
+		if (level_end - p == 1 && *p == '#')
+		{
+			router_append(&nodes[node].hash_route, index);
+			break;
+		}
+		node = router_child(node, p, level_end - p);
+		if (node == ROUTER_NONE)
+		{
+			ret = ESP_ERR_NO_MEM;
+			break;
+		}
+		if (slash == NULL)
+		{
+			router_append(&nodes[node].route, index);
+			break;
+		}
+		p = slash + 1;
+	}
+	if (ret == ESP_OK)
+	{
+		route_count++;
+	}
+	taskEXIT_CRITICAL(&router_lock);
+
+	if (ret != ESP_OK)
+	{
+		ESP_LOGE(TAG, "Topic trie full, %s not registered", filter);
+	}
+	return ret;
+}
+
+/**
+ * @brief Run the handlers of one route list and account their time
+ */
+static void router_call(int route, router_msg_t *msg)
+{
+	for (; route != ROUTER_NONE; route = routes[route].next)
+	{
+		router_route_t *r = &routes[route];
+		int64_t start = esp_timer_get_time();
+		uint32_t elapsed;
+
+		r->handler(msg->topic, msg->topic_len, msg->data, msg->data_len, r->arg);
+		elapsed = (uint32_t)(esp_timer_get_time() - start);
+		msg->called++;
+
+		taskENTER_CRITICAL(&router_lock);
+		r->messages++;
+		r->handler_us_last = elapsed;
+		r->handler_us_total += elapsed;
+		if (elapsed > r->handler_us_max)
+		{
+			r->handler_us_max = elapsed;
+		}
+		if (start - r->window_start_us >= 1000000)
+		{
+			// a gap longer than one window means nothing arrived in the last
+			r->rate = (start - r->window_start_us < 2000000) ? r->window_count : 0;
+			r->window_count = 0;
+			r->window_start_us = start;
+		}
+		r->window_count++;
+		taskEXIT_CRITICAL(&router_lock);
+	}
+}
+
+/**
+ * @brief Match the remaining topic levels [p, end) below node
+ * @param p Start of the next level, NULL when every level is consumed
+ */
+static void router_match(int node, const char *p, const char *end, router_msg_t *msg)
+{
+	const router_node_t *n = &nodes[node];
+	const char *level_end;
+	const char *rest;
+	// wildcards at the first level do not match "$SYS/..." style topics
+	bool wild = !(node == ROUTER_ROOT && p != NULL && p < end && *p == '$');
+
+	if (p == NULL)
+	{
+		// "a/#" also matches "a" itself
+		router_call(n->route, msg);
+		router_call(n->hash_route, msg);
+		return;
+	}
+	if (wild)
+	{
+		router_call(n->hash_route, msg);
+	}
+
+	level_end = memchr(p, '/', end - p);
+	rest = level_end ? level_end + 1 : NULL;
+	if (level_end == NULL)
+	{
+		level_end = end;
+	}
+
+	for (int i = n->child; i != ROUTER_NONE; i = nodes[i].sibling)
+	{
+		const router_node_t *c = &nodes[i];
+
+		if ((c->level_len == level_end - p && memcmp(c->level, p, c->level_len) == 0) ||
+			(wild && c->level_len == 1 && c->level[0] == '+'))
+		{
+			router_match(i, rest, end, msg);
+		}
+	}
+}
+
+int mqtt_router_dispatch(const char *topic, int topic_len, const char *data, int data_len)
+{
+	router_msg_t msg = {topic, topic_len, data, data_len, 0};
+
+	if (topic == NULL || topic_len <= 0)
+	{
+		return 0;
+	}
+
+	router_match(ROUTER_ROOT, topic, topic + topic_len, &msg);
+	if (msg.called == 0)
+	{
+		unmatched++;
+		ESP_LOGD(TAG, "No handler for %.*s", topic_len, topic);
+	}
+	return msg.called;
+}
+
+int mqtt_router_get_filters(const char **filters, int max)
+{
+	int count = 0;
+
+	taskENTER_CRITICAL(&router_lock);
+	// the first route on a node stands for all that share its filter
+	for (int i = 0; i < node_count; i++)
+	{
+		if (nodes[i].route != ROUTER_NONE && count < max)
+		{
+			filters[count++] = routes[nodes[i].route].filter;
+		}
+		if (nodes[i].hash_route != ROUTER_NONE && count < max)
+		{
+			filters[count++] = routes[nodes[i].hash_route].filter;
+		}
+	}
+	taskEXIT_CRITICAL(&router_lock);
+	return count;
+}
+
+int mqtt_router_get_stats(mqtt_route_stats_t *stats, int max)
+{
+	int64_t now = esp_timer_get_time();
+	int count = 0;
+
+	taskENTER_CRITICAL(&router_lock);
+	for (int i = 0; i < route_count && count < max; i++)
+	{
+		const router_route_t *r = &routes[i];
+		mqtt_route_stats_t *s = &stats[count++];
+
+		s->filter = r->filter;
+		s->messages = r->messages;
+		s->rate = (now - r->window_start_us < 2000000) ? r->rate : 0;
+		s->handler_us_last = r->handler_us_last;
+		s->handler_us_max = r->handler_us_max;
+		s->handler_us_avg = r->messages ? (uint32_t)(r->handler_us_total / r->messages) : 0;
+	}
+	taskEXIT_CRITICAL(&router_lock);
+	return count;
+}
+
+uint32_t mqtt_router_get_unmatched(void)
+{
+	return unmatched;
+}
@@ -0,0 +1,77 @@
+#ifndef __MQTT_ROUTER_H
+#define __MQTT_ROUTER_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_ROUTER_MAX_ROUTES 16 /* registered handlers */
+#define MQTT_ROUTER_MAX_NODES 48  /* topic levels over all filters */
+#define MQTT_ROUTER_FILTER_LEN 64 /* longest filter, with the '\0' */
+
+/**
+ * @brief Topic handler, called on the MQTT pipeline worker
+ * @param topic Topic of the message, not '\0' terminated
+ * @param topic_len Topic length
+ * @param data Payload
+ * @param data_len Payload length
+ * @param arg Argument given at registration
+ */
+typedef void (*mqtt_topic_handler_t)(const char *topic, int topic_len, const char *data, int data_len, void *arg);
+
+/* Per-route counters */
+typedef struct
+{
+	const char *filter;		  /* filter the handler was registered with */
+	uint32_t messages;		  /* messages delivered */
+	uint32_t rate;			  /* messages in the last full second */
+	uint32_t handler_us_last; /* handler time of the last message */
+	uint32_t handler_us_max;
+	uint32_t handler_us_avg;
+} mqtt_route_stats_t;
+
+/* Function declarations */
+
+/**
+ * @brief Register a handler for a topic filter
+ * Filters may use '+' for one level and a trailing '#' for any remaining
+ * levels, several handlers may share one filter
+ * @param filter Topic filter, copied
+ * @param handler Handler function
+ * @param arg Passed to the handler
+ * @retval ESP_OK Success, ESP_ERR_INVALID_ARG bad filter, ESP_ERR_NO_MEM table full
+ */
+esp_err_t mqtt_router_register(const char *filter, mqtt_topic_handler_t handler, void *arg);
+
+/**
+ * @brief Call every handler whose filter matches the topic
+ * @param topic Topic, need not be '\0' terminated
+ * @param topic_len Topic length
+ * @param data Payload
+ * @param data_len Payload length
+ * @retval Number of handlers called
+ */
+int mqtt_router_dispatch(const char *topic, int topic_len, const char *data, int data_len);
+
+/**
+ * @brief List the distinct registered filters, to subscribe to them
+ * @param filters Filled with filter pointers
+ * @param max Size of filters
+ * @retval Number of filters returned
+ */
+int mqtt_router_get_filters(const char **filters, int max);
+
+/**
+ * @brief Copy the per-route counters
+ * @param stats Filled in registration order
+ * @param max Size of stats
+ * @retval Number of routes returned
+ */
+int mqtt_router_get_stats(mqtt_route_stats_t *stats, int max);
+
+/**
+ * @brief Messages no handler matched
+ */
+uint32_t mqtt_router_get_unmatched(void);
+
+#endif /* __MQTT_ROUTER_H */
@@ -4,7 +4,9 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "wifi_manager.h"
+#include "mqtt_manager.h"
 #include <string.h>
+#include <stdlib.h>
 
 static const char *TAG = "OTA_MANAGER";
 static const char server_cert_pem[] =
@@ -31,11 +33,13 @@ static const char server_cert_pem[] =
 #define OTA_FIRMWARE_URL "https://192.168.137.1:9443/firmware_new.bin"
 #define OTA_RECV_TIMEOUT 5000
 #define OTA_BUFFER_SIZE 1024
+#define TOPIC_OTA_STATUS "ota/status"
 
 /* OTA State Management */
 static ota_status_t current_ota_status = OTA_STATUS_IDLE;
 static ota_progress_callback_t progress_callback = NULL;
 static ota_status_callback_t status_callback = NULL;
+static ota_available_callback_t available_callback = NULL;
 
 /* OTA handle */
 static esp_ota_handle_t ota_handle = 0;
@@ -340,6 +344,40 @@ void ota_manager_register_status_callback(ota_status_callback_t callback)
 	status_callback = callback;
 }
 
+/**
+ * @brief Register firmware availability callback
+ */
+void ota_manager_register_available_callback(ota_available_callback_t callback)
+{
+	available_callback = callback;
+}
+
+/**
+ * @brief ota/status handler, "1" when the server has a new firmware
+ */
+static void ota_on_status(const char *topic, int topic_len, const char *data, int data_len, void *arg)
+{
+	char status_str[8] = {0};
+	int len = (data_len < sizeof(status_str) - 1) ? data_len : sizeof(status_str) - 1;
+	memcpy(status_str, data, len);
+
+	int ota_available = atoi(status_str);
+	ESP_LOGI(TAG, "Received OTA status: %d", ota_available);
+	// Notify interface to update OTA notification
+	if (available_callback)
+	{
+		available_callback(ota_available == 1);
+	}
+}
+
+/**
+ * @brief Initialize the OTA module
+ */
+esp_err_t ota_manager_init(void)
+{
+	return mqtt_manager_subscribe(TOPIC_OTA_STATUS, ota_on_status, NULL);
+}
+
 /**
  * @brief Get current firmware version info
  */
@@ -31,9 +31,16 @@ typedef struct
 /* Callback function type definitions */
 typedef void (*ota_progress_callback_t)(int progress_percent, int received_bytes, int total_bytes);
 typedef void (*ota_status_callback_t)(ota_status_t status);
+typedef void (*ota_available_callback_t)(bool available);
 
 /* Function declarations */
 
+/**
+ * @brief Initialize the OTA module, registers the ota/status topic handler
+ * @retval ESP_OK on success, other values on failure
+ */
+esp_err_t ota_manager_init(void);
+
 /**
  * @brief Start OTA upgrade
  * @param firmware_url Firmware URL (if NULL, use default URL)
@@ -64,6 +71,13 @@ void ota_manager_register_progress_callback(ota_progress_callback_t callback);
  */
 void ota_manager_register_status_callback(ota_status_callback_t callback);
 
+/**
+ * @brief Register the callback told when the server announces a firmware
+ * @param callback Called with the availability from ota/status, on the MQTT
+ *                 pipeline worker: it must not touch LVGL objects
+ */
+void ota_manager_register_available_callback(ota_available_callback_t callback);
+
 /**
  * @brief Get current firmware version information
  * @param version_info Pointer to version information structure
@@ -0,0 +1,222 @@
+#include "sensor_batch.h"
+#include <stddef.h>
+#include <string.h>
+
+#define SENSOR_BATCH_HEADER 10 /* without the device id */
+#define SENSOR_BATCH_VALUES 5  /* temperature, humidity, smoke, air, light */
+
+/**
+ * @brief Read one LEB128 varint of at most 5 bytes
+ * @retval Position after it, NULL if truncated or too long
+ */
+static const uint8_t *read_varint(const uint8_t *p, const uint8_t *end, uint32_t *value)
+{
+	uint32_t v = 0;
+
+	// one byte is the common case, small deltas
+	if (p < end && *p < 0x80)
+	{
+		*value = *p;
+		return p + 1;
+	}
+	for (int shift = 0; shift < 35 && p < end; shift += 7)
+	{
+		uint8_t b = *p++;
+
+		v |= (uint32_t)(b & 0x7F) << shift;
+		if (b < 0x80)
+		{
+			*value = v;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static void fill_sample(sensor_batch_sample_t *s, uint32_t time, const int32_t *values, int alarm)
+{
+	s->time = time;
+	s->temperature = values[0] * 0.1f;
+	s->humidity = values[1] * 0.1f;
+	s->smoke_level = values[2];
+	s->air_quality = values[3];
+	s->light_intensity = values[4];
+	s->device_alarm = alarm;
+}
+
+bool sensor_batch_decode(const uint8_t *data, int len, sensor_batch_summary_t *out, sensor_batch_sample_cb_t cb, void *arg)
+{
+	const uint8_t *p = data;
+	const uint8_t *end = data + len;
+	int32_t values[SENSOR_BATCH_VALUES] = {0};
+	uint32_t time;
+	uint32_t v;
+	uint32_t rises = 0;
+	int id_len;
+	int count;
+	int alarm = 0;
+	int first_alarm = 0;
+
+	if (len < SENSOR_BATCH_HEADER || p[0] != SENSOR_BATCH_MAGIC0 || p[1] != SENSOR_BATCH_MAGIC1 ||
+		p[2] != SENSOR_BATCH_VERSION)
+	{
+		return false;
+	}
+	id_len = p[3];
+	if (id_len > SENSOR_BATCH_MAX_ID || len < SENSOR_BATCH_HEADER + id_len)
+	{
+		return false;
+	}
+	p += 4 + id_len;
+	time = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+	count = p[4] | p[5] << 8;
+	p += 6;
+	if (count == 0 || count > SENSOR_BATCH_MAX_SAMPLES)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		int prev_alarm = alarm;
+
+		if (p >= end)
+		{
+			return false;
+		}
+		alarm = *p++ & SENSOR_BATCH_ALARM;
+		if ((p = read_varint(p, end, &v)) == NULL)
+		{
+			return false;
+		}
+		time += v;
+		for (int f = 0; f < SENSOR_BATCH_VALUES; f++)
+		{
+			if ((p = read_varint(p, end, &v)) == NULL)
+			{
+				return false;
+			}
+			values[f] += unzigzag(v);
+		}
+
+		if (i == 0)
+		{
+			first_alarm = alarm;
+		}
+		else if (alarm && !prev_alarm)
+		{
+			rises++;
+		}
+		if (cb)
+		{
+			sensor_batch_sample_t s;
+			fill_sample(&s, time, values, alarm);
+			cb(&s, arg);
+		}
+	}
+	if (p != end)
+	{
+		return false;
+	}
+
+	out->device_id = id_len ? (const char *)data + 4 : NULL;
+	out->device_id_len = id_len;
+	out->count = (uint16_t)count;
+	out->first_alarm = first_alarm;
+	out->alarm_rises = rises;
+	fill_sample(&out->last, time, values, alarm);
+	return true;
+}
+
+/**
+ * @brief Append a varint
+ * @retval Bytes written, 0 if it does not fit
+ */
+static int write_varint(uint8_t *p, const uint8_t *end, uint32_t v)
+{
+	int n = 0;
+
+	do
+	{
+		if (p + n >= end)
+		{
+			return 0;
+		}
+		p[n++] = (uint8_t)((v & 0x7F) | (v > 0x7F ? 0x80 : 0));
+		v >>= 7;
+	} while (v);
+	return n;
+}
+
+static int32_t to_tenths(float x)
+{
+	return (int32_t)(x * 10.0f + (x >= 0 ? 0.5f : -0.5f));
+}
+
+int sensor_batch_encode(const char *device_id, const sensor_batch_sample_t *samples, int count, uint8_t *out, int out_size)
+{
+	uint8_t *p = out;
+	const uint8_t *end = out + out_size;
+	int id_len = device_id ? (int)strlen(device_id) : 0;
+	int32_t prev[SENSOR_BATCH_VALUES] = {0};
+	uint32_t time;
+
+	if (count <= 0 || count > SENSOR_BATCH_MAX_SAMPLES || id_len > SENSOR_BATCH_MAX_ID ||
+		out_size < SENSOR_BATCH_HEADER + id_len)
+	{
+		return -1;
+	}
+	time = samples[0].time;
+	*p++ = SENSOR_BATCH_MAGIC0;
+	*p++ = SENSOR_BATCH_MAGIC1;
+	*p++ = SENSOR_BATCH_VERSION;
+	*p++ = (uint8_t)id_len;
+	memcpy(p, device_id, id_len);
+	p += id_len;
+	*p++ = (uint8_t)time;
+	*p++ = (uint8_t)(time >> 8);
+	*p++ = (uint8_t)(time >> 16);
+	*p++ = (uint8_t)(time >> 24);
+	*p++ = (uint8_t)count;
+	*p++ = (uint8_t)(count >> 8);
+
+	for (int i = 0; i < count; i++)
+	{
+		const sensor_batch_sample_t *s = &samples[i];
+		int32_t values[SENSOR_BATCH_VALUES] = {
+			to_tenths(s->temperature), to_tenths(s->humidity), s->smoke_level, s->air_quality, s->light_intensity};
+		int n;
+
+		if (s->time < time || p >= end)
+		{
+			return -1;
+		}
+		*p++ = s->device_alarm ? SENSOR_BATCH_ALARM : 0;
+		if ((n = write_varint(p, end, s->time - time)) == 0)
+		{
+			return -1;
+		}
+		p += n;
+		time = s->time;
+		for (int f = 0; f < SENSOR_BATCH_VALUES; f++)
+		{
+			if ((n = write_varint(p, end, zigzag(values[f] - prev[f]))) == 0)
+			{
+				return -1;
+			}
+			p += n;
+			prev[f] = values[f];
+		}
+	}
+	return (int)(p - out);
+}
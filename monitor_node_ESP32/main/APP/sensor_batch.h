@@ -0,0 +1,83 @@
+#ifndef __SENSOR_BATCH_H
+#define __SENSOR_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Binary sample batch, published on sensor/batch or sensor/<id>/batch by
+ * nodes that buffer samples (outages) or batch them to save airtime.
+ *
+ *   offset  size  field
+ *   0       2     magic "SB"
+ *   2       1     version, SENSOR_BATCH_VERSION
+ *   3       1     device id length n, 0 = take the id from the topic
+ *   4       n     device id
+ *   4+n     4     base time, node uptime (s) little endian
+ *   8+n     2     sample count, little endian
+ *   10+n    ...   samples
+ *
+ * Each sample is a flags byte (bit 0 alarm) followed by varints: time
+ * since the previous sample (s, unsigned), then zigzag deltas from the
+ * previous sample of temperature (0.1 C), humidity (0.1 %), smoke, air
+ * and light. The first sample's deltas are from the base time and zero.
+ * Varints are LEB128, 7 bits per byte, low bits first.
+ */
+#define SENSOR_BATCH_MAGIC0 'S'
+#define SENSOR_BATCH_MAGIC1 'B'
+#define SENSOR_BATCH_VERSION 1
+#define SENSOR_BATCH_MAX_ID 23
+#define SENSOR_BATCH_MAX_SAMPLES 4096
+#define SENSOR_BATCH_ALARM 0x01
+
+/* One decoded sample */
+typedef struct
+{
+	uint32_t time;		 /* node uptime (s) */
+	float temperature;	 /* C */
+	float humidity;		 /* % */
+	int smoke_level;	 /* ppm */
+	int air_quality;	 /* ppm */
+	int light_intensity; /* lux */
+	int device_alarm;	 /* 0/1 */
+} sensor_batch_sample_t;
+
+/* What a batch adds up to, enough to apply it in one step */
+typedef struct
+{
+	const char *device_id; /* inside the payload, not terminated, NULL if none */
+	int device_id_len;
+	uint16_t count;
+	sensor_batch_sample_t last; /* newest sample */
+	int first_alarm;			/* alarm of the oldest sample */
+	uint32_t alarm_rises;		/* alarm 0 -> 1 transitions inside the batch */
+} sensor_batch_summary_t;
+
+/* Called for every sample in order, for consumers keeping history */
+typedef void (*sensor_batch_sample_cb_t)(const sensor_batch_sample_t *sample, void *arg);
+
+/**
+ * @brief Decode a batch in one pass
+ * @param data Payload
+ * @param len Payload length
+ * @param out Summary, valid only when true is returned
+ * @param cb Per-sample callback, may be NULL. Samples before a format error
+ *           have already been delivered when false is returned
+ * @param arg Passed to cb
+ * @retval true Well formed batch with at least one sample
+ */
+bool sensor_batch_decode(const uint8_t *data, int len, sensor_batch_summary_t *out, sensor_batch_sample_cb_t cb, void *arg);
+
+/**
+ * @brief Encode samples as a batch, for tests and tools
+ * Temperature and humidity are rounded to 0.1
+ * @param device_id Device id, NULL or "" for none
+ * @param samples Samples, oldest first, times not decreasing
+ * @param count Number of samples, 1..SENSOR_BATCH_MAX_SAMPLES
+ * @param out Output buffer
+ * @param out_size Size of out
+ * @retval Bytes written, -1 if out is too small or the input invalid
+ */
+int sensor_batch_encode(const char *device_id, const sensor_batch_sample_t *samples, int count, uint8_t *out, int out_size);
+
+#endif
@@ -0,0 +1,389 @@
+#include "sensor_parser.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Fraction digits kept, further digits are skipped */
+#define SENSOR_MAX_FRACTION 4
+
+static const float fraction_scale[SENSOR_MAX_FRACTION + 1] = {1.0f, 0.1f, 0.01f, 0.001f, 0.0001f};
+static const uint32_t fraction_div[SENSOR_MAX_FRACTION + 1] = {1, 10, 100, 1000, 10000};
+
+typedef struct
+{
+	uint32_t mantissa; /* all kept digits, e.g. 265 for 26.5 */
+	uint8_t fraction;  /* digits after the point in mantissa */
+	bool negative;
+} sensor_number_t;
+
+/**
+ * @brief Read "[-]digits[.digits]" up to the next '_' or the end
+ * @retval Position after the value, NULL if malformed
+ */
+static const char *parse_number(const char *p, const char *end, sensor_number_t *num)
+{
+	const char *digits;
+	const char *limit;
+
+	num->mantissa = 0;
+	num->fraction = 0;
+	num->negative = false;
+
+	if (p < end && *p == '-')
+	{
+		num->negative = true;
+		p++;
+	}
+	// nine digits cannot overflow, only a tenth needs the check
+	digits = p;
+	limit = (end - p > 9) ? p + 9 : end;
+	while (p < limit && (unsigned)(*p - '0') <= 9)
+	{
+		num->mantissa = num->mantissa * 10 + (uint32_t)(*p++ - '0');
+	}
+	if (p == digits)
+	{
+		return NULL;
+	}
+	if (p < end && (unsigned)(*p - '0') <= 9)
+	{
+		uint32_t digit = (uint32_t)(*p++ - '0');
+		if (num->mantissa > 429496729u || (num->mantissa == 429496729u && digit > 5) ||
+			(p < end && (unsigned)(*p - '0') <= 9))
+		{
+			return NULL;
+		}
+		num->mantissa = num->mantissa * 10 + digit;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && (unsigned)(*p - '0') <= 9)
+		{
+			if (num->fraction < SENSOR_MAX_FRACTION && num->mantissa <= 42949671u)
+			{
+				num->mantissa = num->mantissa * 10 + (uint32_t)(*p - '0');
+				num->fraction++;
+			}
+			p++;
+		}
+	}
+	if (p < end && *p != '_')
+	{
+		return NULL;
+	}
+	return p;
+}
+
+static float number_to_float(const sensor_number_t *num)
+{
+	float v = (float)num->mantissa * fraction_scale[num->fraction];
+	return num->negative ? -v : v;
+}
+
+/* Integer part, the fraction is dropped like the (int) cast it replaces */
+static int number_to_int(const sensor_number_t *num)
+{
+	int v = (int)(num->fraction ? num->mantissa / fraction_div[num->fraction] : num->mantissa);
+	return num->negative ? -v : v;
+}
+
+typedef struct
+{
+	const char *key; /* with the ':' */
+	uint8_t len;
+} sensor_key_t;
+
+/* Same order as the SENSOR_FIELD_* bits */
+enum
+{
+	KEY_TEMP = 0,
+	KEY_HUMIDITY,
+	KEY_SMOKE,
+	KEY_AIR,
+	KEY_LIGHT,
+	KEY_ALARM,
+	KEY_UPDATE,
+	KEY_DEVICE
+};
+
+static const sensor_key_t sensor_keys[] = {
+	{"Temp:", 5},
+	{"Humidity:", 9},
+	{"SmokePPM:", 9},
+	{"AirPPM:", 7},
+	{"Lightlux:", 9},
+	{"Alarm:", 6},
+	{"Updatetime:", 11},
+	{"Dev:", 4},
+};
+
+/**
+ * @brief Match the key at p, the first letter picks the only candidate
+ * @retval Key entry, NULL for an unknown or malformed key
+ */
+static const sensor_key_t *match_key(const char *p, const char *end)
+{
+	const sensor_key_t *k;
+	uint32_t head;
+	uint32_t expect;
+
+	switch (*p)
+	{
+	case 'T':
+		k = &sensor_keys[KEY_TEMP];
+		break;
+	case 'H':
+		k = &sensor_keys[KEY_HUMIDITY];
+		break;
+	case 'S':
+		k = &sensor_keys[KEY_SMOKE];
+		break;
+	case 'A':
+		k = (end - p > 1 && p[1] == 'l') ? &sensor_keys[KEY_ALARM] : &sensor_keys[KEY_AIR];
+		break;
+	case 'L':
+		k = &sensor_keys[KEY_LIGHT];
+		break;
+	case 'U':
+		k = &sensor_keys[KEY_UPDATE];
+		break;
+	case 'D':
+		k = &sensor_keys[KEY_DEVICE];
+		break;
+	default:
+		return NULL;
+	}
+	if (end - p < k->len)
+	{
+		return NULL;
+	}
+	// the first four letters and the ':' tell the keys apart
+	memcpy(&head, p, sizeof(head));
+	memcpy(&expect, k->key, sizeof(expect));
+	if (head != expect || p[k->len - 1] != ':')
+	{
+		return NULL;
+	}
+	return k;
+}
+
+/**
+ * @brief Up to nine digits at p, too few to overflow
+ * @retval Position after the digits
+ */
+static inline const char *scan_digits(const char *p, const char *end, uint32_t *value)
+{
+	const char *limit = (end - p > 9) ? p + 9 : end;
+	uint32_t v = 0;
+
+	while (p < limit && (unsigned)(*p - '0') <= 9)
+	{
+		v = v * 10 + (uint32_t)(*p++ - '0');
+	}
+	*value = v;
+	return p;
+}
+
+/**
+ * @brief Take "key<digits>" at p, the plain form the STM32 sends
+ * @retval Position after the pair, NULL for another key or any other value
+ */
+static inline const char *take_plain(const char *p, const char *end, const char *key, int len, uint32_t *value)
+{
+	const char *q;
+
+	if (end - p < len || memcmp(p, key, len) != 0)
+	{
+		return NULL;
+	}
+	p += len;
+	q = scan_digits(p, end, value);
+	if (q == p || (q < end && *q != '_'))
+	{
+		return NULL;
+	}
+	return q < end ? q + 1 : q;
+}
+
+/**
+ * @brief Take "key[-]<digits>.<digits>" at p, at most eight digits in all
+ * @retval Position after the pair, NULL for another key or any other value
+ */
+static inline const char *take_decimal(const char *p, const char *end, const char *key, int len, float *value)
+{
+	const char *q;
+	const char *r;
+	uint32_t whole;
+	uint32_t fraction;
+	bool negative;
+	float v;
+
+	if (end - p < len || memcmp(p, key, len) != 0)
+	{
+		return NULL;
+	}
+	p += len;
+	negative = p < end && *p == '-';
+	p += negative;
+	q = scan_digits(p, end, &whole);
+	if (q == p || q >= end || *q != '.')
+	{
+		return NULL;
+	}
+	r = scan_digits(q + 1, end, &fraction);
+	// the same digits parse_number() would keep, so the same float results
+	if (r == q + 1 || r - q - 1 > SENSOR_MAX_FRACTION || r - p - 1 > 8 || (r < end && *r != '_'))
+	{
+		return NULL;
+	}
+	v = (float)(whole * fraction_div[r - q - 1] + fraction) * fraction_scale[r - q - 1];
+	*value = negative ? -v : v;
+	return r < end ? r + 1 : r;
+}
+
+/**
+ * @brief Position after the next '_', or the end
+ */
+static const char *skip_pair(const char *p, const char *end)
+{
+	while (p < end && *p != '_')
+	{
+		p++;
+	}
+	return p < end ? p + 1 : end;
+}
+
+bool sensor_parser_parse(const char *data, int len, sensor_fields_t *out)
+{
+	const char *p = data;
+	const char *end = data + len;
+	sensor_number_t num;
+	uint32_t present = 0;
+	uint32_t value;
+	int field;
+
+	// the STM32 sends its keys in this order with plain values, they are taken
+	// without a key lookup until one differs and the loop below carries on
+	do
+	{
+		const char *next;
+
+		if ((next = take_decimal(p, end, "Temp:", 5, &out->temperature)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		present |= SENSOR_FIELD_TEMP;
+		if ((next = take_decimal(p, end, "Humidity:", 9, &out->humidity)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		present |= SENSOR_FIELD_HUMIDITY;
+		if ((next = take_plain(p, end, "SmokePPM:", 9, &value)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		out->smoke_level = (int)value;
+		present |= SENSOR_FIELD_SMOKE;
+		if ((next = take_plain(p, end, "AirPPM:", 7, &value)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		out->air_quality = (int)value;
+		present |= SENSOR_FIELD_AIR;
+		if ((next = take_plain(p, end, "Lightlux:", 9, &value)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		out->light_intensity = (int)value;
+		present |= SENSOR_FIELD_LIGHT;
+		if ((next = take_plain(p, end, "Alarm:", 6, &value)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		out->device_alarm = (int)value;
+		present |= SENSOR_FIELD_ALARM;
+		if ((next = take_plain(p, end, "Updatetime:", 11, &value)) == NULL)
+		{
+			break;
+		}
+		p = next;
+		out->update_time = value;
+		present |= SENSOR_FIELD_UPDATE;
+	} while (0);
+	while (p < end)
+	{
+		const sensor_key_t *key = match_key(p, end);
+
+		if (key == NULL)
+		{
+			// unknown key or no value, skip the pair
+			p = skip_pair(p, end);
+			continue;
+		}
+
+		field = (int)(key - sensor_keys);
+		if (field == KEY_DEVICE)
+		{
+			// text up to the next '_', left in the payload
+			out->device_id = p + key->len;
+			for (p = out->device_id; p < end && *p != '_'; p++)
+			{
+			}
+			out->device_id_len = (int)(p - out->device_id);
+			if (out->device_id_len > 0)
+			{
+				present |= SENSOR_FIELD_DEVICE;
+			}
+			if (p < end)
+			{
+				p++;
+			}
+			continue;
+		}
+
+		p = parse_number(p + key->len, end, &num);
+		if (p == NULL)
+		{
+			out->present = present;
+			return false;
+		}
+		if (p < end)
+		{
+			p++;
+		}
+
+		switch (field)
+		{
+		case KEY_TEMP:
+			out->temperature = number_to_float(&num);
+			break;
+		case KEY_HUMIDITY:
+			out->humidity = number_to_float(&num);
+			break;
+		case KEY_SMOKE:
+			out->smoke_level = number_to_int(&num);
+			break;
+		case KEY_AIR:
+			out->air_quality = number_to_int(&num);
+			break;
+		case KEY_LIGHT:
+			out->light_intensity = number_to_int(&num);
+			break;
+		case KEY_ALARM:
+			out->device_alarm = number_to_int(&num);
+			break;
+		case KEY_UPDATE:
+			out->update_time = num.negative ? 0 : (num.fraction ? num.mantissa / fraction_div[num.fraction] : num.mantissa);
+			break;
+		}
+		present |= 1u << field;
+	}
+	out->present = present;
+	return (present & SENSOR_FIELDS_REQUIRED) == SENSOR_FIELDS_REQUIRED;
+}
@@ -0,0 +1,49 @@
+#ifndef __SENSOR_PARSER_H
+#define __SENSOR_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Bits of sensor_fields_t.present */
+#define SENSOR_FIELD_TEMP (1u << 0)
+#define SENSOR_FIELD_HUMIDITY (1u << 1)
+#define SENSOR_FIELD_SMOKE (1u << 2)
+#define SENSOR_FIELD_AIR (1u << 3)
+#define SENSOR_FIELD_LIGHT (1u << 4)
+#define SENSOR_FIELD_ALARM (1u << 5)
+#define SENSOR_FIELD_UPDATE (1u << 6)
+#define SENSOR_FIELD_DEVICE (1u << 7)
+
+/* Fields the STM32 always sends, a message missing one is rejected */
+#define SENSOR_FIELDS_REQUIRED (SENSOR_FIELD_TEMP | SENSOR_FIELD_HUMIDITY | SENSOR_FIELD_SMOKE | \
+								SENSOR_FIELD_AIR | SENSOR_FIELD_LIGHT | SENSOR_FIELD_ALARM)
+
+/* Values of one sensor/data message */
+typedef struct
+{
+	float temperature;	  /* Temperature (°C) */
+	float humidity;		  /* Humidity (%) */
+	int smoke_level;	  /* Smoke concentration (ppm), fraction dropped */
+	int air_quality;	  /* Air quality (ppm) */
+	int light_intensity;  /* Light intensity (lux) */
+	int device_alarm;	  /* Device alarm status (0/1) */
+	uint32_t update_time; /* STM32 uptime (s) */
+	const char *device_id; /* "Dev:" value inside the payload, not terminated */
+	int device_id_len;
+	uint32_t present;	  /* SENSOR_FIELD_* found in the message */
+} sensor_fields_t;
+
+/**
+ * @brief Parse a sensor/data payload in place
+ * Format: "Key:value" pairs joined by '_' in any order, e.g.
+ * "Temp:26.5_Humidity:65.2_SmokePPM:80_AirPPM:300_Lightlux:950_Alarm:0_Updatetime:12345".
+ * A node may name itself with "Dev:<id>". Unknown keys are skipped. The
+ * payload is read in place, not copied and need not be NUL terminated.
+ * @param data Payload, e.g. event->data
+ * @param len Payload length
+ * @param out Parsed values, fields not present are left untouched
+ * @retval true All SENSOR_FIELDS_REQUIRED present and well formed
+ */
+bool sensor_parser_parse(const char *data, int len, sensor_fields_t *out);
+
+#endif
@@ -8,6 +8,7 @@
 #include "data_handler.h"
 #include "ota_manager.h"
 #include "esp_log.h"
+#include "log_ring.h"
 #include "esp_ota_ops.h"
 
 static const char *TAG = "MAIN";
@@ -24,13 +25,10 @@ static bool g_mqtt_connected = false;
  */
 void mqtt_data_received(const sensor_data_t *data)
 {
-	ESP_LOGI(TAG, "  Received sensor data:");
-	ESP_LOGI(TAG, "  Temperature: %.1fC", data->temperature);
-	ESP_LOGI(TAG, "  Humidity: %.1f%%", data->humidity);
-	ESP_LOGI(TAG, "  Air quality: %d ppm", data->air_quality);
-	ESP_LOGI(TAG, "  Smoke: %d ppm", data->smoke_level);
-	ESP_LOGI(TAG, "  Light: %d lux", data->light_intensity);
-	ESP_LOGI(TAG, "  Alarm: %d", data->device_alarm);
+	// one deferred line, this runs for every sample on the MQTT pipeline worker
+	LOG_RING_I(TAG, "Received sensor data: T %.1fC H %.1f%% Air %d ppm Smoke %d ppm Light %d lux Alarm %d",
+			   data->temperature, data->humidity, data->air_quality, data->smoke_level,
+			   data->light_intensity, data->device_alarm);
 	// Pass MQTT data to data handler module
 	data_handler_process_mqtt_data(data);
 }
@@ -148,6 +146,7 @@ bool get_mqtt_status(void)
 void app_main(void)
 {
 	esp_err_t ret; // Store function return value
+	log_ring_init(); // first, before other tasks log
 	ota_manager_print_partition_status();
 	ESP_LOGI(TAG, "=== IoT System Startup ===");
 
@@ -179,6 +178,11 @@ void app_main(void)
 	}
 
 	/* 4. OTA module initialization */
+	ret = ota_manager_init();
+	if (ret != ESP_OK)
+	{
+		ESP_LOGE(TAG, "OTA module initialization failed: %s", esp_err_to_name(ret));
+	}
 	ota_manager_register_status_callback(ota_status_callback);
 	ESP_LOGI(TAG, "OTA module initialization completed");
 
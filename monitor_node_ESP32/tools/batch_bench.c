@@ -0,0 +1,175 @@
+/*
+ * Host benchmark of binary sample batches (main/APP/sensor_batch.c)
+ * against the per-message text path (main/APP/sensor_parser.c).
+ *
+ * usage (from this directory):
+ *   cc -O2 -I../main/APP -o batch_bench batch_bench.c ../main/APP/sensor_batch.c ../main/APP/sensor_parser.c -lm
+ *   ./batch_bench [samples per batch]
+ *
+ * The same samples are encoded once as a batch and once as one text
+ * message each. The batch must decode back to them, then both forms are
+ * timed for throughput and compared on bytes per sample.
+ */
+#include "sensor_batch.h"
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BENCH_PASSES 9
+#define BENCH_MIN_NS 20000000.0 /* per pass */
+
+static volatile int sink;
+static sensor_batch_sample_t *samples;
+static int sample_count;
+static int checked;
+static int check_failed;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* A day of one-minute samples drifting slowly, with an alarm now and then */
+static void make_samples(int count)
+{
+	samples = calloc(count, sizeof(*samples));
+	for (int i = 0; i < count; i++)
+	{
+		sensor_batch_sample_t *s = &samples[i];
+		s->time = 86400 + i * 60;
+		s->temperature = 22.0f + (i % 50) * 0.1f - ((i / 50) % 2) * 2.5f;
+		s->humidity = 55.0f + (i % 30) * 0.2f;
+		s->smoke_level = 40 + (i % 7);
+		s->air_quality = 300 + (i % 40) * 3;
+		s->light_intensity = (i % 1440) < 720 ? 800 + i % 100 : 5;
+		s->device_alarm = (i % 97) > 90;
+	}
+}
+
+static void check_sample(const sensor_batch_sample_t *s, void *arg)
+{
+	const sensor_batch_sample_t *e = &samples[checked++];
+
+	(void)arg;
+
+	if (s->time != e->time || fabsf(s->temperature - e->temperature) > 0.051f ||
+		fabsf(s->humidity - e->humidity) > 0.051f || s->smoke_level != e->smoke_level ||
+		s->air_quality != e->air_quality || s->light_intensity != e->light_intensity ||
+		s->device_alarm != e->device_alarm)
+	{
+		check_failed = 1;
+	}
+}
+
+static int format_text(const sensor_batch_sample_t *s, char *buf, int size)
+{
+	return snprintf(buf, size, "Temp:%.1f_Humidity:%.1f_SmokePPM:%d_AirPPM:%d_Lightlux:%d_Alarm:%d_Updatetime:%lu",
+					s->temperature, s->humidity, s->smoke_level, s->air_quality, s->light_intensity,
+					s->device_alarm, (unsigned long)s->time);
+}
+
+/* Best ns per sample over the passes */
+static double time_text(char **messages, const int *lens)
+{
+	double best = 1e30;
+
+	for (int pass = 0; pass < BENCH_PASSES; pass++)
+	{
+		long rounds = 0;
+		double t0 = now_ns();
+		double elapsed;
+
+		do
+		{
+			for (int i = 0; i < sample_count; i++)
+			{
+				sensor_fields_t f;
+				sink += sensor_parser_parse(messages[i], lens[i], &f);
+				sink += f.air_quality;
+			}
+			rounds++;
+		} while ((elapsed = now_ns() - t0) < BENCH_MIN_NS);
+		if (elapsed / (rounds * sample_count) < best)
+		{
+			best = elapsed / (rounds * sample_count);
+		}
+	}
+	return best;
+}
+
+static double time_batch(const uint8_t *batch, int len)
+{
+	double best = 1e30;
+
+	for (int pass = 0; pass < BENCH_PASSES; pass++)
+	{
+		long rounds = 0;
+		double t0 = now_ns();
+		double elapsed;
+
+		do
+		{
+			sensor_batch_summary_t sum;
+			sink += sensor_batch_decode(batch, len, &sum, NULL, NULL);
+			sink += sum.last.air_quality;
+			rounds++;
+		} while ((elapsed = now_ns() - t0) < BENCH_MIN_NS);
+		if (elapsed / (rounds * sample_count) < best)
+		{
+			best = elapsed / (rounds * sample_count);
+		}
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	sensor_batch_summary_t sum;
+	uint8_t *batch;
+	int batch_len;
+	char **messages;
+	int *lens;
+	long text_bytes = 0;
+
+	sample_count = argc > 1 ? atoi(argv[1]) : 256;
+	if (sample_count < 1 || sample_count > SENSOR_BATCH_MAX_SAMPLES)
+	{
+		printf("samples per batch must be 1..%d\n", SENSOR_BATCH_MAX_SAMPLES);
+		return 2;
+	}
+	make_samples(sample_count);
+
+	batch = malloc(sample_count * 32 + 64);
+	batch_len = sensor_batch_encode("node-17", samples, sample_count, batch, sample_count * 32 + 64);
+	if (batch_len < 0 || !sensor_batch_decode(batch, batch_len, &sum, check_sample, NULL) || check_failed ||
+		checked != sample_count || sum.count != sample_count || sum.device_id_len != 7)
+	{
+		printf("batch does not round trip\n");
+		return 1;
+	}
+
+	messages = calloc(sample_count, sizeof(*messages));
+	lens = calloc(sample_count, sizeof(*lens));
+	for (int i = 0; i < sample_count; i++)
+	{
+		messages[i] = malloc(128);
+		lens[i] = format_text(&samples[i], messages[i], 128);
+		text_bytes += lens[i];
+	}
+
+	double text_ns = time_text(messages, lens);
+	double batch_ns = time_batch(batch, batch_len);
+
+	printf("%d samples\n", sample_count);
+	printf("text     %7.1f ns/sample %8.2f M samples/s %6.1f bytes/sample\n", text_ns, 1e3 / text_ns,
+		   (double)text_bytes / sample_count);
+	printf("batch    %7.1f ns/sample %8.2f M samples/s %6.1f bytes/sample\n", batch_ns, 1e3 / batch_ns,
+		   (double)batch_len / sample_count);
+	printf("speedup  %.1fx, %.1fx fewer bytes\n", text_ns / batch_ns, (double)text_bytes / batch_len);
+	return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Host micro-benchmark of the sensor/data parser (main/APP/sensor_parser.c)
+ * against the memcpy + sscanf path it replaced in mqtt_manager.c.
+ *
+ * usage (from this directory):
+ *   cc -O2 -I../main/APP -o parse_bench parse_bench.c ../main/APP/sensor_parser.c -lm
+ *   ./parse_bench [iterations]
+ *
+ * Both parsers first run over the sample messages and must agree, then each
+ * is timed on the same messages. The target is 10x fewer cycles per message;
+ * the exit status is 1 when it is missed or the results differ.
+ */
+#include "sensor_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static uint64_t cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLES 0
+static uint64_t cycles(void) { return 0; }
+#endif
+
+#define TARGET_SPEEDUP 10.0
+
+static const char *messages[] = {
+	"Temp:26.5_Humidity:65.2_SmokePPM:80_AirPPM:300_Lightlux:950_Alarm:0_Updatetime:12345",
+	"Temp:-3.0_Humidity:99.9_SmokePPM:1234_AirPPM:4000_Lightlux:0_Alarm:1_Updatetime:4294967",
+	"Temp:31.2_Humidity:40.0_SmokePPM:0_AirPPM:15_Lightlux:65535_Alarm:0_Updatetime:7",
+	"Temp:22.8_Humidity:51.3_SmokePPM:245_AirPPM:812_Lightlux:120_Alarm:1_Updatetime:86400",
+};
+#define MESSAGE_COUNT (int)(sizeof(messages) / sizeof(messages[0]))
+
+static volatile int sink;
+
+/* The replaced path, as it was in parse_stm32_sensor_data() */
+static int parse_sscanf(const char *data, int data_len, sensor_fields_t *out)
+{
+	char data_str[512] = {0};
+
+	if (data_len < (int)sizeof(data_str) - 1)
+	{
+		memcpy(data_str, data, data_len);
+		data_str[data_len] = '\0';
+	}
+	else
+	{
+		memcpy(data_str, data, sizeof(data_str) - 1);
+		data_str[sizeof(data_str) - 1] = '\0';
+	}
+
+	float temp = 0, humi = 0, smoke = 0;
+	int air_ppm = 0, light_lux = 0, alarm = 0;
+	unsigned long update_time = 0;
+
+	int parsed = sscanf(data_str, "Temp:%f_Humidity:%f_SmokePPM:%f_AirPPM:%d_Lightlux:%d_Alarm:%d_Updatetime:%lu",
+						&temp, &humi, &smoke, &air_ppm, &light_lux, &alarm, &update_time);
+	if (parsed < 6)
+	{
+		return 0;
+	}
+	out->temperature = temp;
+	out->humidity = humi;
+	out->smoke_level = (int)smoke;
+	out->air_quality = air_ppm;
+	out->light_intensity = light_lux;
+	out->device_alarm = alarm;
+	out->update_time = (uint32_t)update_time;
+	return 1;
+}
+
+static int parse_fast(const char *data, int data_len, sensor_fields_t *out)
+{
+	return sensor_parser_parse(data, data_len, out);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define BENCH_PASSES 9
+
+typedef int (*parse_fn)(const char *, int, sensor_fields_t *);
+
+static void time_pass(parse_fn parse, long count, const int *lens, double *ns_best, double *cyc_best)
+{
+	sensor_fields_t f;
+	double t0 = now_ns();
+	uint64_t c0 = cycles();
+
+	for (long i = 0; i < count; i++)
+	{
+		int m = (int)(i % MESSAGE_COUNT);
+		sink += parse(messages[m], lens[m], &f);
+		sink += f.air_quality;
+	}
+
+	double cyc = (double)(cycles() - c0) / count;
+	double ns = (now_ns() - t0) / count;
+	if (ns < *ns_best)
+	{
+		*ns_best = ns;
+		*cyc_best = cyc;
+	}
+}
+
+/* Passes alternate between the parsers and the best of each is kept, so a
+ * noisy host slows both alike instead of skewing the ratio */
+static void run(long iterations, const int *lens, double *ns, double *cyc)
+{
+	long per_pass = iterations / BENCH_PASSES;
+
+	ns[0] = ns[1] = cyc[0] = cyc[1] = 1e30;
+	for (int pass = 0; pass < BENCH_PASSES; pass++)
+	{
+		time_pass(parse_sscanf, per_pass, lens, &ns[0], &cyc[0]);
+		time_pass(parse_fast, per_pass, lens, &ns[1], &cyc[1]);
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		printf("%-8s %8.1f ns/msg", i ? "tokenize" : "sscanf", ns[i]);
+		if (HAVE_CYCLES)
+		{
+			printf("  %8.1f cycles/msg", cyc[i]);
+		}
+		printf("\n");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+	int lens[MESSAGE_COUNT];
+	int ok = 1;
+
+	for (int m = 0; m < MESSAGE_COUNT; m++)
+	{
+		sensor_fields_t a = {0}, b = {0};
+
+		lens[m] = (int)strlen(messages[m]);
+		if (!parse_sscanf(messages[m], lens[m], &a) || !parse_fast(messages[m], lens[m], &b) ||
+			fabsf(a.temperature - b.temperature) > 1e-4f || fabsf(a.humidity - b.humidity) > 1e-4f ||
+			a.smoke_level != b.smoke_level || a.air_quality != b.air_quality ||
+			a.light_intensity != b.light_intensity || a.device_alarm != b.device_alarm ||
+			a.update_time != b.update_time)
+		{
+			printf("mismatch on \"%s\"\n", messages[m]);
+			ok = 0;
+		}
+	}
+
+	/* reordered and extended messages only the new parser accepts */
+	{
+		static const char reordered[] = "Alarm:1_Lightlux:5_Extra:x_AirPPM:7_Humidity:50.0_SmokePPM:3_Temp:20.5";
+		sensor_fields_t f = {0};
+		if (!parse_fast(reordered, (int)strlen(reordered), &f) || f.device_alarm != 1 || f.air_quality != 7 ||
+			f.temperature != 20.5f)
+		{
+			printf("reordered message not parsed\n");
+			ok = 0;
+		}
+	}
+
+	double ns[2], cyc[2];
+	run(iterations, lens, ns, cyc);
+
+	double speedup = HAVE_CYCLES ? cyc[0] / cyc[1] : ns[0] / ns[1];
+	printf("speedup  %.1fx (target %.0fx) %s\n", speedup, TARGET_SPEEDUP, speedup >= TARGET_SPEEDUP ? "ok" : "MISSED");
+	return ok && speedup >= TARGET_SPEEDUP ? 0 : 1;
+}